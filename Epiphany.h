@@ -34,17 +34,27 @@ namespace EpiphanyCC {
     COND_BLT = 0xC,
     COND_BLTE = 0xD,
     COND_NONE = 0xE,
-    COND_L = 0xF
+    COND_L = 0xF,
+    // Not a real condition, marks hardware loop end in branch analysis
+    COND_LOOP = 0x10
   };
 }
 
 namespace llvm {
   class EpiphanyTargetMachine;
   class FunctionPass;
+  class ModulePass;
 
   FunctionPass *createEpiphanyFpuConfigPass();
   FunctionPass *createEpiphanyLoadStoreOptimizationPass();
-  FunctionPass *createEpiphanyVregLoadStoreOptimizationPass();
+  FunctionPass *createEpiphanyPacketizerPass();
+  FunctionPass *createEpiphanyHardwareLoopsPass();
+  FunctionPass *createEpiphanyFixupHwLoopsPass();
+  FunctionPass *createEpiphanyBranchSelectorPass();
+  FunctionPass *createEpiphanySizeReductionPass();
+  FunctionPass *createEpiphanyOutlinerPass();
+  ModulePass *createEpiphanyFpuModeConventionPass(const EpiphanyTargetMachine &TM);
+  ModulePass *createEpiphanyBankPlacementPass();
 
 } // end namespace llvm;
 
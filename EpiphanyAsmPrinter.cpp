@@ -64,6 +64,9 @@ void EpiphanyAsmPrinter::EmitInstruction(const MachineInstr *MI) {
   //  Print out both ordinary instruction and boudle instruction
   MachineBasicBlock::const_instr_iterator I = MI->getIterator();
   MachineBasicBlock::const_instr_iterator E = MI->getParent()->instr_end();
+  // Bundle header is not a real instruction, emit only its contents
+  if (I->isBundle())
+    ++I;
   do {
   
     if (I->isPseudo())
@@ -0,0 +1,170 @@
+//===---------------------EpiphanyBankPlacement.cpp------------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass places large arrays into the local memory banks.
+//
+//  Each of the four local memory banks serves one access per cycle. By
+//  default everything goes to the start of the local memory, so the code,
+//  small data and all arrays share bank 0, and every load or store there
+//  competes with the instruction fetch. The stack is at the top of bank 3.
+//
+//  Arrays not smaller than the threshold get a section of one of the free
+//  banks (1 and 2), the one with more space left is chosen, so two arrays
+//  used together in a loop usually end up in different banks. Objects with
+//  an explicit bank section (.data_bankN, .text_bankN) are left as is and
+//  are accounted for, functions can be moved into another bank with the
+//  "epiphany-bank" attribute. Sections are materialized by
+//  EpiphanyTargetObjectFile, the linker script maps them to the banks.
+//
+//  Each placed object used by the code is reported with an optimization
+//  remark (-pass-remarks=epiphany-bank-placement), common symbols which
+//  can't be placed are reported as missed.
+//
+
+#include "EpiphanyBankPlacement.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "epiphany-bank-placement"
+
+STATISTIC(NumObjectsPlaced, "Number of arrays placed into local memory banks");
+
+static cl::opt<unsigned> BankThreshold(
+  "epiphany-bank-threshold",
+  cl::desc("Minimal size of the array placed into a separate local memory bank"),
+  cl::Hidden,
+  cl::init(1024));
+
+// Banks neither the code nor the stack is in
+static const unsigned DataBanks[] = { 1, 2 };
+
+char EpiphanyBankPlacement::ID = 0;
+
+INITIALIZE_PASS(EpiphanyBankPlacement, "epiphany-bank-placement", "Epiphany Local Memory Bank Placement", false, false)
+
+/// \brief Returns true if the global can be moved into a bank by size
+bool EpiphanyBankPlacement::isCandidate(const GlobalVariable &GV, const DataLayout &DL) {
+  if (GV.isDeclaration() || GV.hasSection() || GV.isThreadLocal() || GV.hasComdat() ||
+      GV.getName().startswith("llvm.")) {
+    return false;
+  }
+
+  // Arrays, and structures holding them
+  Type *Ty = GV.getValueType();
+  if (!Ty->isAggregateType() || !Ty->isSized()) {
+    return false;
+  }
+  return DL.getTypeAllocSize(Ty) >= BankThreshold;
+}
+
+/// \brief Find an instruction using the global, directly or through constant
+/// expressions. Globals not used by any code are not hot and not reported.
+const Instruction *EpiphanyBankPlacement::findUse(const GlobalValue &GV) {
+  SmallVector<const User *, 8> Worklist(GV.user_begin(), GV.user_end());
+  while (!Worklist.empty()) {
+    const User *U = Worklist.pop_back_val();
+    if (const auto *I = dyn_cast<Instruction>(U)) {
+      return I;
+    }
+    if (isa<ConstantExpr>(U)) {
+      Worklist.append(U->user_begin(), U->user_end());
+    }
+  }
+  return nullptr;
+}
+
+bool EpiphanyBankPlacement::runOnModule(Module &M) {
+  if (skipModule(M))
+    return false;
+
+  DEBUG(dbgs() << "\nRunning Epiphany local memory bank placement pass\n");
+  LLVMContext &Ctx = M.getContext();
+  const DataLayout &DL = M.getDataLayout();
+
+  // Space taken by the objects placed by the user
+  uint64_t Used[EpiphanyBank::NumBanks] = {};
+  for (auto &GV : M.globals()) {
+    int Bank = EpiphanyTargetObjectFile::getSectionBank(GV.getSection());
+    if (Bank < 0 || GV.isDeclaration() || !GV.getValueType()->isSized()) {
+      continue;
+    }
+    uint64_t Size = DL.getTypeAllocSize(GV.getValueType());
+    Used[Bank] += Size;
+    if (const Instruction *I = findUse(GV)) {
+      emitOptimizationRemark(Ctx, DEBUG_TYPE, *I->getFunction(), I->getDebugLoc(),
+          Twine(GV.getName()) + " (" + Twine(Size) + " bytes) is in bank " + Twine(Bank));
+    }
+  }
+
+  bool Changed = false;
+  for (auto &GV : M.globals()) {
+    if (!isCandidate(GV, DL)) {
+      continue;
+    }
+    uint64_t Size = DL.getTypeAllocSize(GV.getValueType());
+    const Instruction *I = findUse(GV);
+
+    // Common symbols are emitted without a section
+    if (GV.hasCommonLinkage()) {
+      if (I) {
+        emitOptimizationRemarkMissed(Ctx, DEBUG_TYPE, *I->getFunction(), I->getDebugLoc(),
+            Twine(GV.getName()) + " (" + Twine(Size) + " bytes) is a common symbol and "
+            "stays in the default bank, compile with -fno-common to place it");
+      }
+      continue;
+    }
+
+    int Bank = -1;
+    for (unsigned B : DataBanks) {
+      if (Used[B] + Size <= EpiphanyBank::BankSize && (Bank < 0 || Used[B] < Used[Bank])) {
+        Bank = B;
+      }
+    }
+    if (Bank < 0) {
+      if (I) {
+        emitOptimizationRemarkMissed(Ctx, DEBUG_TYPE, *I->getFunction(), I->getDebugLoc(),
+            Twine(GV.getName()) + " (" + Twine(Size) + " bytes) does not fit into a free bank");
+      }
+      continue;
+    }
+
+    DEBUG(dbgs() << "Placing " << GV.getName() << " (" << Size << " bytes) into bank " << Bank << "\n");
+    GV.setSection((Twine(EpiphanyBank::DataPrefix) + Twine(Bank)).str());
+    Used[Bank] += Size;
+    ++NumObjectsPlaced;
+    Changed = true;
+    if (I) {
+      emitOptimizationRemark(Ctx, DEBUG_TYPE, *I->getFunction(), I->getDebugLoc(),
+          Twine(GV.getName()) + " (" + Twine(Size) + " bytes) placed into bank " + Twine(Bank));
+    }
+  }
+
+  // Code moved out of the default bank
+  for (auto &F : M) {
+    if (F.isDeclaration()) {
+      continue;
+    }
+    int Bank = EpiphanyTargetObjectFile::getFunctionBank(F);
+    if (Bank < 0) {
+      Bank = EpiphanyTargetObjectFile::getSectionBank(F.getSection());
+    }
+    if (Bank >= 0) {
+      emitOptimizationRemark(Ctx, DEBUG_TYPE, F, DebugLoc(),
+          "code of " + Twine(F.getName()) + " is in bank " + Twine(Bank));
+    }
+  }
+
+  return Changed;
+}
+
+//===----------------------------------------------------------------------===//
+//                         Public Constructor Functions
+//===----------------------------------------------------------------------===//
+ModulePass *llvm::createEpiphanyBankPlacementPass() {
+  return new EpiphanyBankPlacement();
+}
@@ -0,0 +1,52 @@
+//===---------------------EpiphanyBankPlacement.h--------------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYBANKPLACEMENT_H
+#define _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYBANKPLACEMENT_H
+
+#include "Epiphany.h"
+#include "EpiphanyConfig.h"
+#include "EpiphanyTargetObjectFile.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+
+namespace llvm {
+  void initializeEpiphanyBankPlacementPass(PassRegistry&);
+
+  /// Spreads large arrays over the local memory banks not used by the code
+  /// and the stack, and reports where the hot objects were placed.
+  class EpiphanyBankPlacement : public ModulePass {
+    private:
+      static bool isCandidate(const GlobalVariable &GV, const DataLayout &DL);
+      static const Instruction *findUse(const GlobalValue &GV);
+
+    public:
+      static char ID;
+      EpiphanyBankPlacement() : ModulePass(ID) {
+        initializeEpiphanyBankPlacementPass(*PassRegistry::getPassRegistry());
+      }
+
+      StringRef getPassName() const override {
+        return "Epiphany local memory bank placement";
+      }
+
+      bool runOnModule(Module &M) override;
+  };
+
+} // namespace llvm
+
+#endif
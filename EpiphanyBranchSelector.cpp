@@ -0,0 +1,139 @@
+//===---------------------EpiphanyBranchSelector.cpp-----------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass chooses between the 16-bit and the 32-bit branch forms.
+//
+//  Codegen works with BNONE32/BCC, which reach +-16MB. Most of the branches
+//  are local, and the 16-bit form with an 8-bit displacement reaches +-256
+//  bytes, saving two bytes of the 32KB local memory each. All branches are
+//  made short first, then the ones with the target out of reach are widened
+//  back. Widening only grows the code, so repeating it until nothing changes
+//  always terminates.
+//
+//  Block alignment padding is not known before the final layout, so the
+//  worst case is assumed, which can only overestimate the distances. Whatever
+//  the estimate still gets wrong (inline asm) is caught by the assembler,
+//  which relaxes short branches the same way.
+//
+
+#include "EpiphanyBranchSelector.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "epiphany_branch_select"
+
+STATISTIC(NumShortBranches, "Number of branches emitted in the 16-bit form");
+STATISTIC(NumWidenedBranches, "Number of branches widened back to the 32-bit form");
+
+char EpiphanyBranchSelector::ID = 0;
+
+INITIALIZE_PASS(EpiphanyBranchSelector, "epiphany-branch-select", "Epiphany Branch Selector", false, false)
+
+unsigned EpiphanyBranchSelector::getShortOpcode(unsigned Opcode) {
+  switch (Opcode) {
+    default:
+      return Opcode;
+    case Epiphany::BNONE32:
+      return Epiphany::BNONE16;
+    case Epiphany::BCC:
+      return Epiphany::BCC16;
+  }
+}
+
+unsigned EpiphanyBranchSelector::getLongOpcode(unsigned Opcode) {
+  switch (Opcode) {
+    default:
+      return Opcode;
+    case Epiphany::BNONE16:
+      return Epiphany::BNONE32;
+    case Epiphany::BCC16:
+      return Epiphany::BCC;
+  }
+}
+
+/// \brief Estimates block offsets, assuming the worst case alignment padding
+void EpiphanyBranchSelector::computeBlockOffsets(MachineFunction &MF) {
+  BlockOffsets.assign(MF.getNumBlockIDs(), 0);
+  unsigned Offset = 0;
+  for (auto &MBB : MF) {
+    // Instructions are at least halfword-aligned
+    unsigned Align = MBB.getAlignment();
+    if (Align > 1) {
+      Offset += (1u << Align) - 2;
+    }
+    BlockOffsets[MBB.getNumber()] = Offset;
+    for (auto &MI : MBB) {
+      Offset += TII->getInstSizeInBytes(MI);
+    }
+  }
+}
+
+/// \brief Widens short branches with the target out of reach, returns true
+/// if anything was changed
+bool EpiphanyBranchSelector::widenBranches(MachineFunction &MF) {
+  computeBlockOffsets(MF);
+
+  bool Changed = false;
+  for (auto &MBB : MF) {
+    unsigned Offset = BlockOffsets[MBB.getNumber()];
+    for (auto &MI : MBB) {
+      unsigned Opcode = MI.getOpcode();
+      if (getLongOpcode(Opcode) != Opcode) {
+        MachineBasicBlock *Dest = TII->getBranchDestBlock(MI);
+        int64_t BrOffset = (int64_t)BlockOffsets[Dest->getNumber()] - Offset;
+        if (!TII->isBranchOffsetInRange(Opcode, BrOffset)) {
+          DEBUG(dbgs() << "Widening branch to BB#" << Dest->getNumber() << ", offset " << BrOffset << "\n");
+          MI.setDesc(TII->get(getLongOpcode(Opcode)));
+          ++NumWidenedBranches;
+          --NumShortBranches;
+          Changed = true;
+        }
+      }
+      // Offsets of the next blocks are stale after widening, the next
+      // iteration rechecks everything
+      Offset += TII->getInstSizeInBytes(MI);
+    }
+  }
+
+  return Changed;
+}
+
+bool EpiphanyBranchSelector::runOnMachineFunction(MachineFunction &MF) {
+  DEBUG(dbgs() << "\nRunning Epiphany branch selector on " << MF.getName() << "\n");
+  TII = MF.getSubtarget<EpiphanySubtarget>().getInstrInfo();
+  MF.RenumberBlocks();
+
+  // Start with everything short
+  bool Changed = false;
+  for (auto &MBB : MF) {
+    for (auto I = MBB.getFirstTerminator(), E = MBB.end(); I != E; ++I) {
+      unsigned Opcode = I->getOpcode();
+      if (getShortOpcode(Opcode) != Opcode) {
+        I->setDesc(TII->get(getShortOpcode(Opcode)));
+        ++NumShortBranches;
+        Changed = true;
+      }
+    }
+  }
+  if (!Changed) {
+    return false;
+  }
+
+  while (widenBranches(MF))
+    ;
+
+  BlockOffsets.clear();
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+//                         Public Constructor Functions
+//===----------------------------------------------------------------------===//
+FunctionPass *llvm::createEpiphanyBranchSelectorPass() {
+  return new EpiphanyBranchSelector();
+}
@@ -0,0 +1,61 @@
+//===---------------------EpiphanyBranchSelector.h-------------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYBRANCHSELECTOR_H
+#define _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYBRANCHSELECTOR_H
+
+#include "Epiphany.h"
+#include "EpiphanyConfig.h"
+#include "EpiphanyInstrInfo.h"
+#include "EpiphanySubtarget.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Target/TargetInstrInfo.h"
+
+namespace llvm {
+  void initializeEpiphanyBranchSelectorPass(PassRegistry&);
+
+  /// Turns branches into the 16-bit form, then widens the ones whose
+  /// target is out of reach back to the 32-bit form until nothing changes.
+  /// Should run after everything that can change the code size.
+  class EpiphanyBranchSelector : public MachineFunctionPass {
+    private:
+      const EpiphanyInstrInfo *TII;
+
+      // Estimated offset of each block from the function start
+      SmallVector<unsigned, 16> BlockOffsets;
+
+      static unsigned getShortOpcode(unsigned Opcode);
+      static unsigned getLongOpcode(unsigned Opcode);
+      void computeBlockOffsets(MachineFunction &MF);
+      bool widenBranches(MachineFunction &MF);
+
+    public:
+      static char ID;
+      EpiphanyBranchSelector() : MachineFunctionPass(ID) {
+        initializeEpiphanyBranchSelectorPass(*PassRegistry::getPassRegistry());
+      }
+
+      StringRef getPassName() const override {
+        return "Epiphany branch selector";
+      }
+
+      MachineFunctionProperties getRequiredProperties() const override {
+        return MachineFunctionProperties().set(
+            MachineFunctionProperties::Property::NoVRegs);
+      }
+
+      bool runOnMachineFunction(MachineFunction &MF) override;
+  };
+
+} // namespace llvm
+
+#endif
@@ -8,248 +8,285 @@
 //
 // This pass adds correct FPU/IALU2 flags to CONFIG register.
 //
-//  Run through all instruction of the first block and its successors, find
-//  first FPU instruction in each branch, set config flag on the top-level MBB and restore it
-//  at the end.
-//  For now we do not handle cases where both FPU and IALU2 instructions can be present
+//  CONFIG values for each arithmetic mode used in the function are computed
+//  once at the function entry and kept in vregs, so each mode switch is a
+//  single movts. As the switch only writes a precomputed value, there is no
+//  read-modify-write sequence to protect with GID/GIE outside of the entry.
+//
+//  Switch placement is a forward dataflow over the CFG: each block gets the
+//  mode of its predecessors on entry (or "mixed" if they disagree), and a
+//  switch is inserted only before the first instruction needing some other
+//  mode. Loops which need a single mode get the switch in the preheader, so
+//  loop bodies are free of switches unless they mix FPU and IALU2
+//  instructions. The caller's CONFIG value is restored before each return.
+//
+//  FPU and IALU2 instructions get their implicit CONFIG use here rather than
+//  in the instruction definitions. The pass runs before the register
+//  allocation but after MachineLICM and MachineCSE, which refuse to touch
+//  instructions reading a non-constant physical register.
+//
+//  With fp-truncate feature the FPU mode also selects truncate rounding,
+//  which makes FPU results available one stage earlier (E3 instead of E4).
+//
+//  Functions with "epiphany-fpu-mode" attribute (see
+//  EpiphanyFpuModeConvention.cpp) get CONFIG already set by the caller, so
+//  calls to them require the corresponding mode, and if they need no other
+//  mode the pass leaves them untouched.
 //
 
 #include "EpiphanyFpuConfigPass.h"
+#include "llvm/ADT/PostOrderIterator.h"
 
 using namespace llvm;
 
 #define DEBUG_TYPE "epiphany_fpu_config"
 
+STATISTIC(NumModeSwitches, "Number of CONFIG mode switches inserted");
+STATISTIC(NumLoopsHoisted, "Number of loops with the mode switch hoisted to the preheader");
 
 char EpiphanyFpuConfigPass::ID = 0;
 
 INITIALIZE_PASS_BEGIN(EpiphanyFpuConfigPass, "epiphany_fpu_config", "Epiphany FPU/IALU2 Config", false, false)
+INITIALIZE_PASS_DEPENDENCY(MachineLoopInfo)
 INITIALIZE_PASS_END(EpiphanyFpuConfigPass, "epiphany_fpu_config", "Epiphany FPU/IALU2 Config", false, false)
 
-void EpiphanyFpuConfigPass::insertConfigInst(MachineBasicBlock *MBB, MachineBasicBlock::iterator MBBI, 
-    MachineRegisterInfo &MRI, const EpiphanySubtarget &ST, unsigned frameIdx) {
+/// \brief Get the mode the function expects on entry due to the mode convention
+EpiphanyFpuConfigPass::FpuMode EpiphanyFpuConfigPass::getFunctionMode(const Function &F) {
+  StringRef Mode = F.getFnAttribute(EpiphanyFpuMode::AttrName).getValueAsString();
+  if (Mode == EpiphanyFpuMode::FPU) {
+    return MODE_FPU;
+  }
+  if (Mode == EpiphanyFpuMode::IALU2) {
+    return MODE_IALU;
+  }
+  return MODE_NONE;
+}
+
+/// \brief Get the arithmetic mode required by the instruction
+EpiphanyFpuConfigPass::FpuMode EpiphanyFpuConfigPass::getInstrMode(const MachineInstr &MI) const {
+  switch (EpiphanyII::getUnit(MI.getDesc().TSFlags)) {
+    case EpiphanyII::UnitFPU:
+      return MODE_FPU;
+    case EpiphanyII::UnitIALU2:
+      return MODE_IALU;
+    default:
+      break;
+  }
+  if (!MI.isCall()) {
+    return MODE_NONE;
+  }
 
-  const TargetRegisterClass *RC = &Epiphany::GPR32RegClass;
+  // Callee may expect the mode to be already set, get it from either the
+  // direct call or the address materialization
+  const MachineOperand &MO = MI.getOperand(0);
+  const GlobalValue *GV = nullptr;
+  if (MO.isGlobal()) {
+    GV = MO.getGlobal();
+  } else if (MO.isReg() && TargetRegisterInfo::isVirtualRegister(MO.getReg())) {
+    MachineInstr *Def = MRI->getVRegDef(MO.getReg());
+    if (Def && Def->getOpcode() == Epiphany::MOVTi32ri && Def->getOperand(2).isGlobal()) {
+      GV = Def->getOperand(2).getGlobal();
+    }
+  }
+  auto *Callee = dyn_cast_or_null<Function>(GV);
+  return Callee ? getFunctionMode(*Callee) : MODE_NONE;
+}
+
+/// \brief Combine modes coming from two different paths
+EpiphanyFpuConfigPass::FpuMode EpiphanyFpuConfigPass::meet(FpuMode A, FpuMode B) {
+  if (A == MODE_NONE) {
+    return B;
+  }
+  if (B == MODE_NONE || A == B) {
+    return A;
+  }
+  return MODE_MIXED;
+}
+
+/// \brief Get the mode required by all instructions of the loop
+///
+/// \return MODE_NONE if nothing requires any mode, MODE_MIXED if both are used
+EpiphanyFpuConfigPass::FpuMode EpiphanyFpuConfigPass::getLoopMode(MachineLoop *L) {
+  FpuMode Mode = MODE_NONE;
+  for (auto *MBB : L->blocks()) {
+    for (auto &MI : *MBB) {
+      Mode = meet(Mode, getInstrMode(MI));
+    }
+  }
+  return Mode;
+}
+
+/// \brief Force the mode in the preheader of the outermost loops needing a single mode
+void EpiphanyFpuConfigPass::hoistLoopModes(MachineLoop *L) {
+  FpuMode Mode = getLoopMode(L);
+  if (Mode == MODE_NONE) {
+    return;
+  }
+  MachineBasicBlock *Preheader = L->getLoopPreheader();
+  if (Mode != MODE_MIXED && Preheader) {
+    DEBUG(dbgs() << "Hoisting mode switch for loop BB#" << L->getHeader()->getNumber()
+        << " to BB#" << Preheader->getNumber() << "\n");
+    BlockInfos[Preheader->getNumber()].Forced = Mode;
+    ++NumLoopsHoisted;
+    return;
+  }
+  // Mixed loop, try the inner ones
+  for (auto *Child : *L) {
+    hoistLoopModes(Child);
+  }
+}
 
+/// \brief Propagate modes through the CFG until nothing changes
+void EpiphanyFpuConfigPass::computeDataflow(MachineFunction &MF) {
+  ReversePostOrderTraversal<MachineFunction *> RPOT(&MF);
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (auto *MBB : RPOT) {
+      BlockInfo &BI = BlockInfos[MBB->getNumber()];
+      // Entry state is set up by the caller
+      FpuMode In = MBB->pred_empty() ? BI.In : MODE_NONE;
+      for (auto *Pred : MBB->predecessors()) {
+        In = meet(In, BlockInfos[Pred->getNumber()].Out);
+      }
+      FpuMode Out = BI.Exit != MODE_NONE ? BI.Exit : In;
+      if (In != BI.In || Out != BI.Out) {
+        BI.In = In;
+        BI.Out = Out;
+        Changed = true;
+      }
+    }
+  }
+}
+
+void EpiphanyFpuConfigPass::insertSwitch(MachineBasicBlock *MBB, MachineBasicBlock::iterator InsertPos, FpuMode Mode) {
   DebugLoc DL = DebugLoc();
-  unsigned Reg = MRI.createVirtualRegister(RC);
-  TII->loadRegFromStackSlot(*MBB, MBBI, Reg, frameIdx, RC, ST.getRegisterInfo());
-  BuildMI(*MBB, MBBI, DL, TII->get(Epiphany::GID)).addReg(Epiphany::CONFIG, RegState::ImplicitDefine);
-  BuildMI(*MBB, MBBI, DL, TII->get(Epiphany::MOVTS32_core), Epiphany::CONFIG).addReg(Reg, RegState::Kill);
-  BuildMI(*MBB, MBBI, DL, TII->get(Epiphany::GIE)).addReg(Epiphany::CONFIG, RegState::ImplicitDefine);
+  BuildMI(*MBB, InsertPos, DL, TII->get(Epiphany::MOVTS32_core), Epiphany::CONFIG).addReg(ModeRegs[Mode]);
+  ++NumModeSwitches;
 }
 
 bool EpiphanyFpuConfigPass::runOnMachineFunction(MachineFunction &MF) {
   DEBUG(dbgs() << "\nRunning Epiphany FPU/IALU2 config pass\n");
   auto &ST = MF.getSubtarget<EpiphanySubtarget>();
   TII = ST.getInstrInfo();
-  MachineFrameInfo &MFI = MF.getFrameInfo();
-  MachineRegisterInfo &MRI = MF.getRegInfo();
+  MRI = &MF.getRegInfo();
+  MLI = &getAnalysis<MachineLoopInfo>();
   const TargetRegisterClass *RC = &Epiphany::GPR32RegClass;
-  unsigned blockCount = MF.size();
-
-  // FPU opcodes
-  unsigned opcodesFPU[] = {Epiphany::FADDrr_r16, Epiphany::FADDrr_r32, Epiphany::FSUBrr_r16, Epiphany::FSUBrr_r32,
-    Epiphany::FMULrr_r16, Epiphany::FMULrr_r32, Epiphany::FMADDrr_r16, Epiphany::FMADDrr_r32,
-    Epiphany::FMSUBrr_r16, Epiphany::FMSUBrr_r32};
-  // IALU2 opcodes
-  unsigned opcodesIALU2[] = {Epiphany::IADDrr_r16, Epiphany::IADDrr_r32, Epiphany::ISUBrr_r16, Epiphany::ISUBrr_r32,
-    Epiphany::IMULrr_r16, Epiphany::IMULrr_r32, Epiphany::IMADDrr_r16, Epiphany::IMADDrr_r32,
-    Epiphany::IMSUBrr_r16, Epiphany::IMSUBrr_r32};
 
-  // Prepare binary flag and regs
+  // Step 1: Find which modes are used and the mode each block leaves,
+  // arithmetic instructions start reading CONFIG from now on
   bool hasFPU = false;
   bool hasIALU2 = false;
-
-  // Step 1: Loop over all of the basic blocks to find the first FPU instruction
-  for (auto &it : MF) {
-    MachineBasicBlock *MBB = &it;
-    // Loop over all instructions search for FPU instructions
-    for(MachineBasicBlock::iterator MBBI = MBB->begin(), MBBE = MBB->end(); MBBI != MBBE; ++MBBI) {
-      MachineInstr *MI = &*MBBI;
-      // Check if the opcode used is one of the FPU opcodes
-      bool isFPU = std::find(std::begin(opcodesFPU), std::end(opcodesFPU), MI->getOpcode()) != std::end(opcodesFPU);
-      if (isFPU) {
-        hasFPU = true;
+  BlockInfos.assign(MF.getNumBlockIDs(), BlockInfo());
+  for (auto &MBB : MF) {
+    for (auto &MI : MBB) {
+      FpuMode Mode = getInstrMode(MI);
+      if (Mode == MODE_NONE) {
+        continue;
       }
-      // Check if the opcode used is one of the IALU2 opcodes
-      bool isIALU2 = std::find(std::begin(opcodesIALU2), std::end(opcodesIALU2), MI->getOpcode()) != std::end(opcodesIALU2);
-      if (isIALU2) {
-        hasIALU2 = true;
+      if (!MI.isCall()) {
+        MI.addOperand(MF, MachineOperand::CreateReg(Epiphany::CONFIG, false, true));
       }
+      hasFPU |= (Mode == MODE_FPU);
+      hasIALU2 |= (Mode == MODE_IALU);
+      BlockInfos[MBB.getNumber()].Exit = Mode;
     }
-    // Break if we already know that we have both
-    if (hasFPU && hasIALU2) {
-      break;
-    }
+  }
+  if (!hasFPU && !hasIALU2) {
+    return false;
   }
 
-  // Step 2: Insert config
-  if (hasFPU || hasIALU2) {
-    // Create and insert new basic block for the config reg switch
-    MachineBasicBlock *Front = &MF.front();
-    MachineBasicBlock *MBB = MF.CreateMachineBasicBlock();
-    MachineBasicBlock::iterator insertPos = MBB->begin();
-    DebugLoc DL = DebugLoc();
-    MF.insert(MF.begin(), MBB);
-    MBB->addSuccessor(Front);
-    // Add function live-ins so that they'll be defined in every path
-    for (auto LB = MRI.livein_begin(), LE = MRI.livein_end(); LB != LE; ++LB) {
-      MBB->addLiveIn(LB->first);
-    }
-    // Create config regs for both cases
-    unsigned FpuConfigReg   = MRI.createVirtualRegister(RC);
-    unsigned IaluConfigReg  = MRI.createVirtualRegister(RC);
-    unsigned OriginalConfigReg = MRI.createVirtualRegister(RC);
-    // Disable interrupts
-    BuildMI(*MBB, insertPos, DL, TII->get(Epiphany::GID)).addReg(Epiphany::CONFIG, RegState::ImplicitDefine);
-    // Gather reg values
-    BuildMI(*MBB, insertPos, DL, TII->get(Epiphany::MOVFS32_core), OriginalConfigReg).addReg(Epiphany::CONFIG, RegState::Kill);
-    originalFrameIdx = MFI.CreateStackObject(RC->getSize(), /* Alignment = */ RC->getSize(), /* isSS = */ false);
-    TII->storeRegToStackSlot(*MBB, insertPos, OriginalConfigReg, /* killReg = */ false, originalFrameIdx, RC, ST.getRegisterInfo());
-    // Calculate FPU config reg value
-    if (hasFPU) {
-      // Create mask with bits 19:17 set to 0
-      unsigned lowTmpReg = MRI.createVirtualRegister(RC);
-      BuildMI(*MBB, insertPos, DL, TII->get(Epiphany::MOVi32ri), lowTmpReg).addImm(0xffff);
-      unsigned tmpReg = MRI.createVirtualRegister(RC);
-      BuildMI(*MBB, insertPos, DL, TII->get(Epiphany::MOVTi32ri), tmpReg).addReg(lowTmpReg).addImm(0xfff1);
-      // Apply mask to OriginalConfigReg
-      BuildMI(*MBB, insertPos, DL, TII->get(Epiphany::ANDrr_r32), FpuConfigReg).addReg(OriginalConfigReg, RegState::Kill).addReg(tmpReg, RegState::Kill);
-      // Store fpu config reg to stack
-      fpuFrameIdx = MFI.CreateStackObject(RC->getSize(), /* Alignment = */ RC->getSize(), /* isSS = */ false);
-      TII->storeRegToStackSlot(*MBB, insertPos, FpuConfigReg, /* killReg = */ false, fpuFrameIdx, RC, ST.getRegisterInfo());
-    }
-    // Calculate IALU2 conf reg value
-    if (hasIALU2) {
-      // Set bits 16-32 to 0b0000000001001000 = 0x48 (all other bits are reserved/not recommended
-      // TODO: bit 22 may have 2 values, though value 1 is recommended
-      // TODO: bit 26 may have 2 values, though the second one is avail only on Epiphany-IV
-      BuildMI(*MBB, insertPos, DL, TII->get(Epiphany::MOVTi32ri), IaluConfigReg).addReg(OriginalConfigReg, RegState::Kill).addImm(0x48);
-      // Store ialu config reg to stack
-      ialuFrameIdx = MFI.CreateStackObject(RC->getSize(), /* Alignment = */ RC->getSize(), /* isSS = */ false);
-      TII->storeRegToStackSlot(*MBB, insertPos, IaluConfigReg, /* killReg = */ false, ialuFrameIdx, RC, ST.getRegisterInfo());
-    }
-    // If we only have one mode - push reg back to config right now
-    if (hasFPU && !hasIALU2) {
-      BuildMI(*MBB, insertPos, DL, TII->get(Epiphany::MOVTS32_core), Epiphany::CONFIG).addReg(FpuConfigReg, RegState::Kill);
-    } else if (hasIALU2 && !hasFPU) {
-      BuildMI(*MBB, insertPos, DL, TII->get(Epiphany::MOVTS32_core), Epiphany::CONFIG).addReg(IaluConfigReg, RegState::Kill);
-    }
-    // Restore interrupts
-    BuildMI(*MBB, insertPos, DL, TII->get(Epiphany::GIE)).addReg(Epiphany::CONFIG, RegState::ImplicitKill);
+  // Callers already switched to the only mode we need, nothing to do
+  FpuMode ConventionMode = getFunctionMode(*MF.getFunction());
+  if (ConventionMode != MODE_NONE &&
+      ((ConventionMode == MODE_FPU && !hasIALU2) || (ConventionMode == MODE_IALU && !hasFPU))) {
+    DEBUG(dbgs() << "Mode is set by the caller, skipping\n");
+    return true;
   }
 
-  // Step 3 - if we have both FPU and IALU2 instructions, run through the whole routine and insert config
-  // FIXME: config based on on successors and first use
-  std::vector<PredState> lastState(blockCount, PRED_START);
-  if (hasFPU && hasIALU2) {
-    for (auto &it : MF) {
-      MachineBasicBlock *MBB = &it;
-      int blockNumber = MBB->getNumber();
-      // Loop over all instructions search for FPU instructions
-      for(MachineBasicBlock::iterator MBBI = MBB->begin(), MBBE = MBB->end(); MBBI != MBBE; ++MBBI) {
-        MachineInstr *MI = &*MBBI;
-        // Check if the opcode used is one of the FPU opcodes
-        bool isFPU = std::find(std::begin(opcodesFPU), std::end(opcodesFPU), MI->getOpcode()) != std::end(opcodesFPU);
-        if (isFPU) {
-          if (lastState[blockNumber] != PRED_FPU) {
-            insertConfigInst(MBB, MBBI, MRI, ST, fpuFrameIdx);
-            lastState[blockNumber] = PRED_FPU;
-          }
-          continue;
-        }
-        // Check if the opcode used is one of the IALU2 opcodes
-        bool isIALU2 = std::find(std::begin(opcodesIALU2), std::end(opcodesIALU2), MI->getOpcode()) != std::end(opcodesIALU2);
-        if (isIALU2) {
-          if (lastState[blockNumber] != PRED_IALU) {
-            insertConfigInst(MBB, MBBI, MRI, ST, ialuFrameIdx);
-            lastState[blockNumber] = PRED_IALU;
-          }
-          continue;
-        }
-      }
-      // Propagate current flag state to all successors, setting state to MIXED if they 
-      // already have some other state except start
-      for (auto MBBI = MBB->succ_begin(), MBBE = MBB->succ_end(); MBBI != MBBE; ++MBBI) {
-        MachineBasicBlock *successor = *MBBI;
-        int succNumber = successor->getNumber();
-        if (lastState[succNumber] == PRED_START) {
-          lastState[succNumber] = lastState[blockNumber];
-        } else if (lastState[succNumber] != lastState[blockNumber]) {
-          lastState[succNumber] = PRED_MIXED;
-        }
-      }
+  // Step 2: Calculate config values on function entry
+  MachineBasicBlock *Entry = &MF.front();
+  MachineBasicBlock::iterator insertPos = Entry->begin();
+  DebugLoc DL = DebugLoc();
+  FpuMode EntryMode = MODE_ORIG;
+  // Disable interrupts
+  BuildMI(*Entry, insertPos, DL, TII->get(Epiphany::GID));
+  // Gather reg values
+  unsigned OriginalConfigReg = MRI->createVirtualRegister(RC);
+  BuildMI(*Entry, insertPos, DL, TII->get(Epiphany::MOVFS32_core), OriginalConfigReg).addReg(Epiphany::CONFIG);
+  ModeRegs[MODE_ORIG] = OriginalConfigReg;
+  // Calculate FPU config reg value
+  if (hasFPU) {
+    // Create mask with bits 19:17 set to 0
+    unsigned lowTmpReg = MRI->createVirtualRegister(RC);
+    BuildMI(*Entry, insertPos, DL, TII->get(Epiphany::MOVi32ri), lowTmpReg).addImm(0xffff);
+    unsigned tmpReg = MRI->createVirtualRegister(RC);
+    BuildMI(*Entry, insertPos, DL, TII->get(Epiphany::MOVTi32ri), tmpReg).addReg(lowTmpReg, RegState::Kill).addImm(0xfff1);
+    // Apply mask to OriginalConfigReg
+    unsigned FpuConfigReg = MRI->createVirtualRegister(RC);
+    BuildMI(*Entry, insertPos, DL, TII->get(Epiphany::ANDrr_r32), FpuConfigReg).addReg(OriginalConfigReg).addReg(tmpReg, RegState::Kill);
+    // Set RMODE (bit 0) for truncate rounding
+    if (ST.hasTruncateFP()) {
+      unsigned rmodeReg = MRI->createVirtualRegister(RC);
+      BuildMI(*Entry, insertPos, DL, TII->get(Epiphany::MOVi32ri), rmodeReg).addImm(1);
+      unsigned TruncConfigReg = MRI->createVirtualRegister(RC);
+      BuildMI(*Entry, insertPos, DL, TII->get(Epiphany::ORRrr_r32), TruncConfigReg).addReg(FpuConfigReg, RegState::Kill).addReg(rmodeReg, RegState::Kill);
+      FpuConfigReg = TruncConfigReg;
     }
+    ModeRegs[MODE_FPU] = FpuConfigReg;
+  }
+  // Calculate IALU2 conf reg value
+  if (hasIALU2) {
+    // Set bits 16-32 to 0b0000000001001000 = 0x48 (all other bits are reserved/not recommended
+    // TODO: bit 22 may have 2 values, though value 1 is recommended
+    // TODO: bit 26 may have 2 values, though the second one is avail only on Epiphany-IV
+    unsigned IaluConfigReg = MRI->createVirtualRegister(RC);
+    BuildMI(*Entry, insertPos, DL, TII->get(Epiphany::MOVTi32ri), IaluConfigReg).addReg(OriginalConfigReg).addImm(0x48);
+    ModeRegs[MODE_IALU] = IaluConfigReg;
+  }
+  // If we only have one mode - push reg back to config right now
+  if (hasFPU != hasIALU2) {
+    EntryMode = hasFPU ? MODE_FPU : MODE_IALU;
+    insertSwitch(Entry, insertPos, EntryMode);
   }
+  // Restore interrupts
+  BuildMI(*Entry, insertPos, DL, TII->get(Epiphany::GIE));
+  BlockInfos[Entry->getNumber()].In = EntryMode;
 
-  // Step 4 - resolving loops and predeccessors
-  // Run on every block until we hit the first IALU/FPU inst and check ALL predeccessors
+  // Step 3: Move switches out of the loops
   if (hasFPU && hasIALU2) {
-    for (auto &it : MF) {
-      MachineBasicBlock *MBB = &it;
-      int blockNumber = MBB->getNumber();
-      // Loop over all instructions search for FPU instructions
-      for(MachineBasicBlock::iterator MBBI = MBB->begin(), MBBE = MBB->end(); MBBI != MBBE; ++MBBI) {
-        MachineInstr *MI = &*MBBI;
-        // Already have smth, falling out
-        if (MI->getOpcode() == Epiphany::GID) {
-          break;
-        }
-        // Check if the opcode used is one of the FPU opcodes
-        bool isFPU = std::find(std::begin(opcodesFPU), std::end(opcodesFPU), MI->getOpcode()) != std::end(opcodesFPU);
-        bool isIALU2 = std::find(std::begin(opcodesIALU2), std::end(opcodesIALU2), MI->getOpcode()) != std::end(opcodesIALU2);
-        if (isFPU || isIALU2) {
-          // Check all predeccessors
-          for (auto PBBI = MBB->pred_begin(), PBBE = MBB->pred_end(); PBBI != PBBE; ++PBBI) {
-            MachineBasicBlock *pred = *PBBI;
-            int predNumber = pred->getNumber();
-            // Remember than now we can be, for example, in mixed state
-            if (lastState[predNumber] != lastState[blockNumber]) {
-              if (isFPU) {
-                insertConfigInst(MBB, MBBI, MRI, ST, fpuFrameIdx);
-              }
-              if (isIALU2) {
-                insertConfigInst(MBB, MBBI, MRI, ST, ialuFrameIdx);
-              }
-              // Fix applied, nothing to do here
-              break;
-            }
-          }
-          // Break out as the first instruction was already processed
-          break;
-        }
-      }
+    for (auto *L : *MLI) {
+      hoistLoopModes(L);
+    }
+  }
+  for (auto &BI : BlockInfos) {
+    if (BI.Forced != MODE_NONE) {
+      BI.Exit = BI.Forced;
     }
   }
 
-  // Step 5 - find the last FPU/IALU2 instruction of the last block and restore the config flags
-  if (hasFPU || hasIALU2) {
-    MachineBasicBlock *MBB = &MF.back();
-    MachineBasicBlock::iterator MBBI = MBB->end();
-    MBBI--;
-    for (MachineBasicBlock::iterator MBBE = MBB->begin(); MBBI != MBBE; --MBBI) {
-      MachineInstr *MI = &*MBBI;
-      if (MI->isTerminator()) {
-        break;
+  // Step 4: Find the mode on entry of each block
+  computeDataflow(MF);
+
+  // Step 5: Insert switches where the current mode differs from the required one
+  for (auto &MBB : MF) {
+    BlockInfo &BI = BlockInfos[MBB.getNumber()];
+    FpuMode Cur = BI.In;
+    for (auto MBBI = MBB.begin(), MBBE = MBB.end(); MBBI != MBBE; ++MBBI) {
+      FpuMode Mode = getInstrMode(*MBBI);
+      if (Mode != MODE_NONE && Mode != Cur) {
+        insertSwitch(&MBB, MBBI, Mode);
+        Cur = Mode;
       }
-      // Check if the opcode used is one of the FPU opcodesFPU
-      //bool isFPU = std::find(std::begin(opcodesFPU), std::end(opcodesFPU), MI->getOpcode()) != std::end(opcodesFPU);
-      // If FPU inst found - insert config flag
-      //if (isFPU) {
-      //break;
-      //}
     }
-    DebugLoc DL = DebugLoc();
-    unsigned OriginalConfigReg = MRI.createVirtualRegister(RC);
-    // Reload old config value 
-    TII->loadRegFromStackSlot(*MBB, MBBI, OriginalConfigReg, originalFrameIdx, RC, ST.getRegisterInfo());
-    // Disable interrupts
-    BuildMI(*MBB, MBBI, DL, TII->get(Epiphany::GID));
-    // Upload config value to the core
-    BuildMI(*MBB, MBBI, DL, TII->get(Epiphany::MOVTS32_core), Epiphany::CONFIG).addReg(OriginalConfigReg, RegState::Kill);
-    // Restore interrupts
-    BuildMI(*MBB, MBBI, DL, TII->get(Epiphany::GIE)).addReg(Epiphany::CONFIG, RegState::ImplicitKill);
+    if (BI.Forced != MODE_NONE && BI.Forced != Cur) {
+      insertSwitch(&MBB, MBB.getFirstTerminator(), BI.Forced);
+      Cur = BI.Forced;
+    }
+    // Restore the caller's config
+    if (MBB.isReturnBlock() && Cur != MODE_ORIG && Cur != MODE_NONE) {
+      insertSwitch(&MBB, MBB.getFirstTerminator(), MODE_ORIG);
+    }
   }
 
   return true;
@@ -11,9 +11,11 @@
 
 #include "Epiphany.h"
 #include "EpiphanyConfig.h"
+#include "EpiphanyFpuModeConvention.h"
 #include "EpiphanyMachineFunction.h"
 #include "EpiphanySubtarget.h"
 #include "EpiphanyTargetMachine.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/CodeGen/MachineDominators.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
@@ -34,14 +36,36 @@ namespace llvm {
 
     private:
       const EpiphanyInstrInfo *TII;
+      MachineRegisterInfo *MRI;
+      MachineLoopInfo *MLI;
 
-      unsigned originalFrameIdx;
-      unsigned fpuFrameIdx;
-      unsigned ialuFrameIdx;
+      // Arithmetic mode, MODE_NONE means no requirement (or not known yet),
+      // MODE_MIXED - different modes are coming from predecessors
+      enum FpuMode {
+        MODE_NONE, MODE_ORIG, MODE_FPU, MODE_IALU, MODE_MIXED
+      };
 
-      enum PredState {
-        PRED_START, PRED_FPU, PRED_IALU, PRED_MIXED
+      struct BlockInfo {
+        // Mode the block leaves by itself, MODE_NONE if transparent
+        FpuMode Exit = MODE_NONE;
+        // Mode forced at the end of the block, used for loop preheaders
+        FpuMode Forced = MODE_NONE;
+        // Dataflow state on entry and exit
+        FpuMode In = MODE_NONE;
+        FpuMode Out = MODE_NONE;
       };
+      std::vector<BlockInfo> BlockInfos;
+
+      // Precomputed CONFIG values, kept in vregs for the whole function
+      unsigned ModeRegs[MODE_MIXED];
+
+      static FpuMode getFunctionMode(const Function &F);
+      FpuMode getInstrMode(const MachineInstr &MI) const;
+      static FpuMode meet(FpuMode A, FpuMode B);
+      FpuMode getLoopMode(MachineLoop *L);
+      void hoistLoopModes(MachineLoop *L);
+      void computeDataflow(MachineFunction &MF);
+      void insertSwitch(MachineBasicBlock *MBB, MachineBasicBlock::iterator InsertPos, FpuMode Mode);
 
     public:
       static char ID;
@@ -49,13 +73,18 @@ namespace llvm {
         initializeEpiphanyFpuConfigPassPass(*PassRegistry::getPassRegistry());
       }
 
-      StringRef getPassName() const {
+      void getAnalysisUsage(AnalysisUsage &AU) const override {
+        AU.setPreservesCFG();
+        AU.addRequired<MachineLoopInfo>();
+        AU.addPreserved<MachineLoopInfo>();
+        MachineFunctionPass::getAnalysisUsage(AU);
+      }
+
+      StringRef getPassName() const override {
         return "Epiphany FPU/IALU2 config flag optimization pass";
       }
 
-      void insertConfigInst(MachineBasicBlock *MBB, MachineBasicBlock::iterator insertPos, 
-          MachineRegisterInfo &MRI, const EpiphanySubtarget &ST, unsigned frameIdx);
-      bool runOnMachineFunction(MachineFunction &MF);
+      bool runOnMachineFunction(MachineFunction &MF) override;
   };
 
 } // namespace llvm
@@ -0,0 +1,216 @@
+//===---------------------EpiphanyFpuModeConvention.cpp--------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass sets the FPU/IALU2 mode convention attribute on internal
+// functions.
+//
+//  Normally each function using FPU or IALU2 instructions saves CONFIG on
+//  entry, computes the mode values and restores CONFIG on return. For small
+//  leaf functions called from hot loops this is more expensive than the body.
+//
+//  If all uses of an internal function are direct calls, and all of the
+//  callers use the same single arithmetic mode as the function itself, the
+//  function gets "epiphany-fpu-mode" attribute. The FPU config pass then
+//  switches to that mode in the caller before the call (usually it is
+//  already there, or the switch is hoisted out of the loop), and skips the
+//  save/restore in the callee.
+//
+//  The attribute can also be set by the frontend, it is honored the same way.
+//
+//  Modes are predicted from the IR, so operations lowered into FPU or IALU2
+//  sequences have to be listed here along with the plain arithmetic: integer
+//  division by a constant becomes an IMUL-based high-half multiply, inline
+//  division (inline-div feature) uses both units, and f32 division and square
+//  root become Newton-Raphson sequences with unsafe FP math. A wrong guess
+//  only costs performance, EpiphanyFpuConfigPass still sees the real code.
+//
+
+#include "EpiphanyFpuModeConvention.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "epiphany_fpu_mode"
+
+STATISTIC(NumFunctionsMarked, "Number of functions using the caller's FPU/IALU2 mode");
+
+char EpiphanyFpuModeConvention::ID = 0;
+
+INITIALIZE_PASS(EpiphanyFpuModeConvention, "epiphany-fpu-mode", "Epiphany FPU/IALU2 Mode Convention", false, false)
+
+/// \brief Returns true if f32 division and square root are lowered into estimates
+bool EpiphanyFpuModeConvention::hasUnsafeFPMath(const Function &F) const {
+  if (F.getFnAttribute("unsafe-fp-math").getValueAsString() == "true") {
+    return true;
+  }
+  return TM && TM->Options.UnsafeFPMath;
+}
+
+/// \brief Get the mode of i32 division, see EpiphanyTargetLowering::LowerDivRem
+EpiphanyFpuModeConvention::IRMode EpiphanyFpuModeConvention::getDivMode(const Instruction &I) const {
+  if (!I.getType()->getScalarType()->isIntegerTy(32)) {
+    return IR_NONE;
+  }
+
+  // Constant divisors are turned into the high-half multiply, except for the
+  // powers of two done with shifts
+  const Value *Divisor = I.getOperand(1);
+  if (auto *CV = dyn_cast<Constant>(Divisor)) {
+    if (CV->getType()->isVectorTy()) {
+      CV = CV->getSplatValue();
+    }
+    if (auto *CI = dyn_cast_or_null<ConstantInt>(CV)) {
+      const APInt &C = CI->getValue();
+      bool IsSigned = I.getOpcode() == Instruction::SDiv || I.getOpcode() == Instruction::SRem;
+      if (C.isPowerOf2() || (IsSigned && C.isNegative() && C.abs().isPowerOf2()) ||
+          C == 0 || C.isAllOnesValue()) {
+        return IR_NONE;
+      }
+      return IR_IALU2;
+    }
+  }
+
+  // Inline sequence uses FLOAT/FMUL and IMUL, otherwise it is a libcall
+  const Function &F = *I.getFunction();
+  if (TM && TM->getSubtargetImpl(F)->hasInlineDiv() && !F.optForSize()) {
+    return IR_MIXED;
+  }
+  return IR_NONE;
+}
+
+/// \brief Get the arithmetic mode the instruction is expected to be lowered into
+EpiphanyFpuModeConvention::IRMode EpiphanyFpuModeConvention::getInstMode(const Instruction &I) const {
+  switch (I.getOpcode()) {
+    default:
+      break;
+    // Libcalls unless unsafe FP math is allowed
+    case Instruction::FDiv:
+      return I.getType()->getScalarType()->isFloatTy() &&
+        hasUnsafeFPMath(*I.getFunction()) ? IR_FPU : IR_NONE;
+    case Instruction::SDiv:
+    case Instruction::UDiv:
+    case Instruction::SRem:
+    case Instruction::URem:
+      return getDivMode(I);
+    // f64 is done with libcalls
+    case Instruction::FAdd:
+    case Instruction::FSub:
+    case Instruction::FMul:
+    case Instruction::FCmp:
+      return I.getOperand(0)->getType()->getScalarType()->isFloatTy() ? IR_FPU : IR_NONE;
+    // FLOAT/FIX are done by the FPU as well
+    case Instruction::SIToFP:
+    case Instruction::UIToFP:
+      return I.getType()->getScalarType()->isFloatTy() &&
+        I.getOperand(0)->getType()->getScalarType()->isIntegerTy(32) ? IR_FPU : IR_NONE;
+    case Instruction::FPToSI:
+    case Instruction::FPToUI:
+      return I.getOperand(0)->getType()->getScalarType()->isFloatTy() &&
+        I.getType()->getScalarType()->isIntegerTy(32) ? IR_FPU : IR_NONE;
+    // i64 multiplication is expanded into i32 ones
+    case Instruction::Mul:
+      return I.getType()->getScalarType()->isIntegerTy() ? IR_IALU2 : IR_NONE;
+  }
+
+  if (auto *II = dyn_cast<IntrinsicInst>(&I)) {
+    switch (II->getIntrinsicID()) {
+      default:
+        return IR_NONE;
+      case Intrinsic::fma:
+      case Intrinsic::fmuladd:
+      case Intrinsic::fabs:
+        return II->getType()->getScalarType()->isFloatTy() ? IR_FPU : IR_NONE;
+      case Intrinsic::sqrt:
+        return II->getType()->getScalarType()->isFloatTy() &&
+          hasUnsafeFPMath(*I.getFunction()) ? IR_FPU : IR_NONE;
+      // High half of the product is needed for the overflow check
+      case Intrinsic::smul_with_overflow:
+      case Intrinsic::umul_with_overflow:
+        return IR_IALU2;
+    }
+  }
+
+  // Nobody knows what's inside
+  if (auto *CI = dyn_cast<CallInst>(&I)) {
+    if (CI->isInlineAsm()) {
+      return IR_MIXED;
+    }
+  }
+
+  return IR_NONE;
+}
+
+/// \brief Get the arithmetic mode used by the whole function
+EpiphanyFpuModeConvention::IRMode EpiphanyFpuModeConvention::getFunctionMode(const Function &F) const {
+  IRMode Mode = IR_NONE;
+  for (auto &BB : F) {
+    for (auto &I : BB) {
+      IRMode InstMode = getInstMode(I);
+      if (InstMode == IR_NONE || InstMode == Mode) {
+        continue;
+      }
+      if (Mode != IR_NONE || InstMode == IR_MIXED) {
+        return IR_MIXED;
+      }
+      Mode = InstMode;
+    }
+  }
+  return Mode;
+}
+
+bool EpiphanyFpuModeConvention::runOnModule(Module &M) {
+  if (skipModule(M))
+    return false;
+
+  DEBUG(dbgs() << "\nRunning Epiphany FPU/IALU2 mode convention pass\n");
+  DenseMap<const Function *, IRMode> Modes;
+  for (auto &F : M) {
+    if (!F.isDeclaration()) {
+      Modes[&F] = getFunctionMode(F);
+    }
+  }
+
+  bool Changed = false;
+  for (auto &F : M) {
+    // Callers should be known
+    if (F.isDeclaration() || !F.hasLocalLinkage() || F.use_empty() ||
+        F.hasFnAttribute(EpiphanyFpuMode::AttrName)) {
+      continue;
+    }
+    IRMode Mode = Modes[&F];
+    if (Mode != IR_FPU && Mode != IR_IALU2) {
+      continue;
+    }
+
+    bool CallersMatch = true;
+    for (const User *U : F.users()) {
+      ImmutableCallSite CS(U);
+      // Address is taken, it can be called from anywhere
+      if (!CS || CS.getCalledValue() != &F || Modes.lookup(CS.getCaller()) != Mode) {
+        CallersMatch = false;
+        break;
+      }
+    }
+    if (!CallersMatch) {
+      continue;
+    }
+
+    DEBUG(dbgs() << "Function " << F.getName() << " uses the caller's mode\n");
+    F.addFnAttr(EpiphanyFpuMode::AttrName, Mode == IR_FPU ? EpiphanyFpuMode::FPU : EpiphanyFpuMode::IALU2);
+    ++NumFunctionsMarked;
+    Changed = true;
+  }
+
+  return Changed;
+}
+
+//===----------------------------------------------------------------------===//
+//                         Public Constructor Functions
+//===----------------------------------------------------------------------===//
+ModulePass *llvm::createEpiphanyFpuModeConventionPass(const EpiphanyTargetMachine &TM) {
+  return new EpiphanyFpuModeConvention(&TM);
+}
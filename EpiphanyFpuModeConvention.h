@@ -0,0 +1,67 @@
+//===---------------------EpiphanyFpuModeConvention.h----------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYFPUMODECONVENTION_H
+#define _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYFPUMODECONVENTION_H
+
+#include "Epiphany.h"
+#include "EpiphanyConfig.h"
+#include "EpiphanyTargetMachine.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+
+namespace llvm {
+  void initializeEpiphanyFpuModeConventionPass(PassRegistry&);
+
+  namespace EpiphanyFpuMode {
+    // Function attribute: caller guarantees that CONFIG is in the given
+    // arithmetic mode on entry, and gets it back unchanged on return
+    static const char *const AttrName = "epiphany-fpu-mode";
+    static const char *const FPU      = "fpu";
+    static const char *const IALU2    = "ialu2";
+  }
+
+  /// Marks internal functions whose callers all run in the same FPU/IALU2 mode
+  /// as the function itself, so it can skip CONFIG save/restore.
+  class EpiphanyFpuModeConvention : public ModulePass {
+    private:
+      enum IRMode {
+        IR_NONE, IR_FPU, IR_IALU2, IR_MIXED
+      };
+
+      // Null when created by opt, lowering options are taken as the defaults
+      const EpiphanyTargetMachine *TM;
+
+      bool hasUnsafeFPMath(const Function &F) const;
+      IRMode getDivMode(const Instruction &I) const;
+      IRMode getInstMode(const Instruction &I) const;
+      IRMode getFunctionMode(const Function &F) const;
+
+    public:
+      static char ID;
+      explicit EpiphanyFpuModeConvention(const EpiphanyTargetMachine *TM = nullptr)
+        : ModulePass(ID), TM(TM) {
+        initializeEpiphanyFpuModeConventionPass(*PassRegistry::getPassRegistry());
+      }
+
+      StringRef getPassName() const override {
+        return "Epiphany FPU/IALU2 mode convention";
+      }
+
+      bool runOnModule(Module &M) override;
+  };
+
+} // namespace llvm
+
+#endif
@@ -0,0 +1,643 @@
+//===---------------------EpiphanyHardwareLoops.cpp------------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass turns counted innermost loops into zero-overhead hardware loops.
+//
+//  Loop start and end addresses go to LS and LE, the iteration count goes to
+//  LC. When the instruction at LE is executed and LC is not zero, the core
+//  decrements LC and jumps to LS, so the compare and the backedge branch
+//  can be removed.
+//
+//  Architectural constraints:
+//  * Loop start should be 8-byte aligned
+//  * Last instruction of the loop should be 32-bit
+//  * Nothing inside the loop can clobber LC/LS/LE, so loops with calls,
+//    inline asm or special register moves are skipped. Interrupt handlers
+//    can't save these regs, as the backend has no interrupt prologue, so
+//    functions marked with the "interrupt" attribute are skipped too. The
+//    handlers built elsewhere (e.g. with e-gcc) have to preserve them.
+//
+//  The work is split in two parts. EpiphanyHardwareLoops runs on SSA before
+//  the register allocation, finds the induction variable, computes the trip
+//  count in the preheader and replaces the loop branches with the LOOPEND
+//  pseudo. EpiphanyFixupHwLoops runs right before emission, when the loop
+//  body is final, places the loop start and end labels and takes care of the
+//  alignment and the size of the last instruction.
+//
+//  Only single-block loops are handled for now. The trip count can be
+//  computed at runtime for the loops stepping by 1 or -1 until IV != Bound,
+//  other conditions are accepted only if both initial value and bound are
+//  constant. A runtime count of zero would make the loop run 2^32 times, so
+//  such loops are only converted behind a guard proving that the initial
+//  value differs from the bound, as left by the loop rotation.
+//
+
+#include "EpiphanyHardwareLoops.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "epiphany_hwloops"
+
+STATISTIC(NumHWLoops, "Number of loops converted to hardware loops");
+
+char EpiphanyHardwareLoops::ID = 0;
+char EpiphanyFixupHwLoops::ID = 0;
+
+INITIALIZE_PASS_BEGIN(EpiphanyHardwareLoops, "epiphany-hwloops", "Epiphany Hardware Loops", false, false)
+INITIALIZE_PASS_DEPENDENCY(MachineLoopInfo)
+INITIALIZE_PASS_END(EpiphanyHardwareLoops, "epiphany-hwloops", "Epiphany Hardware Loops", false, false)
+
+INITIALIZE_PASS(EpiphanyFixupHwLoops, "epiphany-fixup-hwloops", "Epiphany Hardware Loops Fixup", false, false)
+
+/// \brief Get the constant value of the operand, if any
+///
+/// \param MO Immediate or register operand
+/// \param MRI Machine register info
+/// \param Val Returned value
+///
+/// \return true if operand is an immediate or a vreg defined by a move immediate
+static bool getConstValue(const MachineOperand &MO, const MachineRegisterInfo *MRI, int64_t &Val) {
+  if (MO.isImm()) {
+    Val = MO.getImm();
+    return true;
+  }
+  if (!MO.isReg() || !TargetRegisterInfo::isVirtualRegister(MO.getReg())) {
+    return false;
+  }
+  MachineInstr *Def = MRI->getVRegDef(MO.getReg());
+  if (!Def || (Def->getOpcode() != Epiphany::MOVi32ri && Def->getOpcode() != Epiphany::MOVi16ri)
+      || !Def->getOperand(1).isImm()) {
+    return false;
+  }
+  Val = Def->getOperand(1).getImm();
+  return true;
+}
+
+/// \brief Follow the chain of virtual register copies up to its source
+static unsigned lookThroughCopies(unsigned Reg, const MachineRegisterInfo *MRI) {
+  while (TargetRegisterInfo::isVirtualRegister(Reg)) {
+    MachineInstr *Def = MRI->getVRegDef(Reg);
+    if (!Def || !Def->isCopy() || Def->getOperand(1).getSubReg() ||
+        !TargetRegisterInfo::isVirtualRegister(Def->getOperand(1).getReg())) {
+      break;
+    }
+    Reg = Def->getOperand(1).getReg();
+  }
+  return Reg;
+}
+
+/// \brief Check if two operands are known to hold the same value
+static bool isSameValue(const MachineOperand &A, const MachineOperand &B,
+    const MachineRegisterInfo *MRI) {
+  int64_t AVal, BVal;
+  if (getConstValue(A, MRI, AVal) && getConstValue(B, MRI, BVal)) {
+    return (uint32_t)AVal == (uint32_t)BVal;
+  }
+  return A.isReg() && B.isReg() &&
+    lookThroughCopies(A.getReg(), MRI) == lookThroughCopies(B.getReg(), MRI);
+}
+
+/// \brief Compute the number of iterations of a do-while loop
+///
+/// \param First IV value compared on the first iteration
+/// \param Bound Value IV is compared with
+/// \param Step IV step, 1 or -1
+/// \param Cond Loop continue condition
+///
+/// \return Number of iterations, 0 if it can't be computed
+static int64_t computeConstTripCount(int32_t First, int32_t Bound, int64_t Step, EpiphanyCC::CondCodes Cond) {
+  // Make conditions strict
+  switch (Cond) {
+    default:
+      return 0;
+    case EpiphanyCC::COND_LTE:
+    case EpiphanyCC::COND_LTEU:
+      if (Bound == INT32_MAX || (uint32_t)Bound == UINT32_MAX)
+        return 0;
+      Bound++;
+      break;
+    case EpiphanyCC::COND_GTE:
+    case EpiphanyCC::COND_GTEU:
+      if (Bound == INT32_MIN || (uint32_t)Bound == 0)
+        return 0;
+      Bound--;
+      break;
+    case EpiphanyCC::COND_NE:
+    case EpiphanyCC::COND_LT:
+    case EpiphanyCC::COND_LTU:
+    case EpiphanyCC::COND_GT:
+    case EpiphanyCC::COND_GTU:
+      break;
+  }
+
+  bool Continue;
+  switch (Cond) {
+    default:
+      // Should not happen, NE checks the direction below
+      Continue = First != Bound;
+      break;
+    case EpiphanyCC::COND_LT:
+    case EpiphanyCC::COND_LTE:
+      Continue = First < Bound;
+      break;
+    case EpiphanyCC::COND_LTU:
+    case EpiphanyCC::COND_LTEU:
+      Continue = (uint32_t)First < (uint32_t)Bound;
+      break;
+    case EpiphanyCC::COND_GT:
+    case EpiphanyCC::COND_GTE:
+      Continue = First > Bound;
+      break;
+    case EpiphanyCC::COND_GTU:
+    case EpiphanyCC::COND_GTEU:
+      Continue = (uint32_t)First > (uint32_t)Bound;
+      break;
+  }
+
+  // Body is always executed at least once
+  if (!Continue)
+    return 1;
+
+  int64_t Distance = Step > 0 ? (int64_t)Bound - First : (int64_t)First - Bound;
+  // Wrong direction, IV will wrap around
+  if (Distance <= 0)
+    return 0;
+  if (Cond == EpiphanyCC::COND_LTU || Cond == EpiphanyCC::COND_LTEU ||
+      Cond == EpiphanyCC::COND_GTU || Cond == EpiphanyCC::COND_GTEU) {
+    Distance = Step > 0 ? (int64_t)(uint32_t)Bound - (uint32_t)First
+                        : (int64_t)(uint32_t)First - (uint32_t)Bound;
+  }
+  int64_t Count = Distance + 1;
+  return isUInt<32>(Count) ? Count : 0;
+}
+
+/// \brief Check if the loop structure allows the hardware loop
+bool EpiphanyHardwareLoops::isHardwareLoopCandidate(MachineLoop *L) {
+  // Innermost single-block loops only
+  if (L->begin() != L->end() || L->getNumBlocks() != 1) {
+    return false;
+  }
+  MachineBasicBlock *Header = L->getHeader();
+  if (!L->getLoopPreheader() || !L->getExitBlock() || L->getLoopLatch() != Header) {
+    return false;
+  }
+
+  for (auto &MI : *Header) {
+    // Calls and asm can clobber LC, special reg moves and interrupt control
+    // are not allowed inside the loop
+    if (MI.isCall() || MI.isInlineAsm() || MI.hasUnmodeledSideEffects()) {
+      DEBUG(dbgs() << "Can't create hardware loop due to: "; MI.dump());
+      return false;
+    }
+    if (!MI.isTerminator() && (MI.readsRegister(Epiphany::LC) || MI.modifiesRegister(Epiphany::LC)
+          || MI.modifiesRegister(Epiphany::LS) || MI.modifiesRegister(Epiphany::LE))) {
+      DEBUG(dbgs() << "Loop regs are used by: "; MI.dump());
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// \brief Find the induction variable, its step and the loop bound
+bool EpiphanyHardwareLoops::analyzeLoop(MachineLoop *L, CountedLoop &CL) {
+  MachineBasicBlock *Header = L->getHeader();
+  MachineBasicBlock *Preheader = L->getLoopPreheader();
+
+  // Loop branches: conditional one and optional unconditional
+  MachineInstr *CondBr = nullptr;
+  MachineInstr *UncondBr = nullptr;
+  for (auto I = Header->getFirstTerminator(), E = Header->end(); I != E; ++I) {
+    if (I->isDebugValue()) {
+      continue;
+    }
+    if (I->getOpcode() == Epiphany::BCC && !CondBr && !UncondBr) {
+      CondBr = &*I;
+    } else if (I->getOpcode() == Epiphany::BNONE32 && !UncondBr) {
+      UncondBr = &*I;
+    } else {
+      return false;
+    }
+  }
+  if (!CondBr) {
+    return false;
+  }
+
+  CL.Cond = static_cast<EpiphanyCC::CondCodes>(CondBr->getOperand(1).getImm());
+  if (CondBr->getOperand(0).getMBB() != Header) {
+    // Loop continues on the false path
+    if (!UncondBr || UncondBr->getOperand(0).getMBB() != Header) {
+      return false;
+    }
+    SmallVector<MachineOperand, 1> Cond;
+    Cond.push_back(MachineOperand::CreateImm(CL.Cond));
+    if (TII->reverseBranchCondition(Cond)) {
+      return false;
+    }
+    CL.Cond = static_cast<EpiphanyCC::CondCodes>(Cond[0].getImm());
+  }
+
+  // Find the compare feeding the branch, nobody else should read the flags
+  for (auto I = Header->getFirstTerminator(); I != Header->begin();) {
+    --I;
+    if (I->definesRegister(Epiphany::STATUS)) {
+      CL.Compare = &*I;
+      break;
+    }
+    if (I->readsRegister(Epiphany::STATUS)) {
+      return false;
+    }
+  }
+  if (!CL.Compare) {
+    return false;
+  }
+  unsigned CmpOpc = CL.Compare->getOpcode();
+  if (CmpOpc != Epiphany::CMPri_r16 && CmpOpc != Epiphany::CMPri_r32 &&
+      CmpOpc != Epiphany::CMPrr_r16 && CmpOpc != Epiphany::CMPrr_r32) {
+    return false;
+  }
+  if (!MRI->use_nodbg_empty(CL.Compare->getOperand(0).getReg())) {
+    return false;
+  }
+
+  // Find which of the compare operands is the IV
+  for (unsigned OpIdx = 1; OpIdx <= 2; ++OpIdx) {
+    MachineOperand &MO = CL.Compare->getOperand(OpIdx);
+    if (!MO.isReg()) {
+      continue;
+    }
+    MachineInstr *Def = MRI->getVRegDef(MO.getReg());
+    if (!Def || Def->getParent() != Header) {
+      continue;
+    }
+
+    MachineInstr *Phi = nullptr;
+    MachineInstr *Inc = nullptr;
+    if (Def->isPHI()) {
+      Phi = Def;
+    } else {
+      Inc = Def;
+      unsigned IncOpc = Inc->getOpcode();
+      if (IncOpc != Epiphany::ADDri_r16 && IncOpc != Epiphany::ADDri_r32 &&
+          IncOpc != Epiphany::SUBri_r16 && IncOpc != Epiphany::SUBri_r32) {
+        continue;
+      }
+      Phi = MRI->getVRegDef(Inc->getOperand(1).getReg());
+      if (!Phi || !Phi->isPHI() || Phi->getParent() != Header) {
+        continue;
+      }
+    }
+
+    // PHI should merge initial value and the incremented one
+    if (Phi->getNumOperands() != 5) {
+      continue;
+    }
+    MachineOperand *InitMO = nullptr;
+    unsigned NextReg = 0;
+    for (unsigned i = 1; i < Phi->getNumOperands(); i += 2) {
+      if (Phi->getOperand(i + 1).getMBB() == Preheader) {
+        InitMO = &Phi->getOperand(i);
+      } else if (Phi->getOperand(i + 1).getMBB() == Header) {
+        NextReg = Phi->getOperand(i).getReg();
+      }
+    }
+    if (!InitMO || !NextReg) {
+      continue;
+    }
+    MachineInstr *NextDef = MRI->getVRegDef(NextReg);
+    if (Inc && NextDef != Inc) {
+      continue;
+    }
+    Inc = NextDef;
+    unsigned IncOpc = Inc->getOpcode();
+    if ((IncOpc != Epiphany::ADDri_r16 && IncOpc != Epiphany::ADDri_r32 &&
+          IncOpc != Epiphany::SUBri_r16 && IncOpc != Epiphany::SUBri_r32) ||
+        Inc->getOperand(1).getReg() != Phi->getOperand(0).getReg() ||
+        !Inc->getOperand(2).isImm()) {
+      continue;
+    }
+    int64_t Step = Inc->getOperand(2).getImm();
+    if (IncOpc == Epiphany::SUBri_r16 || IncOpc == Epiphany::SUBri_r32) {
+      Step = -Step;
+    }
+    if (Step != 1 && Step != -1) {
+      continue;
+    }
+
+    // Bound should be loop-invariant
+    MachineOperand &BoundMO = CL.Compare->getOperand(OpIdx == 1 ? 2 : 1);
+    if (BoundMO.isReg()) {
+      MachineInstr *BoundDef = MRI->getVRegDef(BoundMO.getReg());
+      if (!BoundDef || BoundDef->getParent() == Header) {
+        continue;
+      }
+    }
+    // Swapped compare, only symmetrical condition is supported
+    if (OpIdx == 2 && CL.Cond != EpiphanyCC::COND_NE) {
+      continue;
+    }
+
+    CL.Phi = Phi;
+    CL.Increment = Inc;
+    CL.Init = InitMO;
+    CL.Bound = &BoundMO;
+    CL.Step = Step;
+    CL.CompareAfterIncrement = (Def == Inc);
+    break;
+  }
+  if (!CL.Phi) {
+    return false;
+  }
+
+  // Check if the trip count can be computed
+  int64_t InitVal, BoundVal;
+  if (getConstValue(*CL.Init, MRI, InitVal) && getConstValue(*CL.Bound, MRI, BoundVal)) {
+    int64_t First = CL.CompareAfterIncrement ? InitVal + CL.Step : InitVal;
+    CL.TripCount = computeConstTripCount(First, BoundVal, CL.Step, CL.Cond);
+    return CL.TripCount != 0;
+  }
+
+  return CL.Cond == EpiphanyCC::COND_NE && isGuardedAgainstZeroTrip(L, CL);
+}
+
+/// \brief Check if the loop is entered only when the runtime count is not zero
+///
+/// The count is Bound - Init when IV is compared after the increment, so it
+/// is enough to find a branch into the preheader taken only if they differ.
+bool EpiphanyHardwareLoops::isGuardedAgainstZeroTrip(MachineLoop *L, CountedLoop &CL) {
+  if (!CL.CompareAfterIncrement) {
+    return false;
+  }
+  MachineBasicBlock *Preheader = L->getLoopPreheader();
+  MachineBasicBlock *Guard = Preheader->getSinglePredecessor();
+  if (!Guard) {
+    return false;
+  }
+
+  // Condition holding on the way into the preheader
+  MachineBasicBlock *TBB = nullptr, *FBB = nullptr;
+  SmallVector<MachineOperand, 1> Cond;
+  if (TII->analyzeBranch(*Guard, TBB, FBB, Cond, false) || Cond.size() != 1) {
+    return false;
+  }
+  if (TBB != Preheader) {
+    if (FBB ? FBB != Preheader : !Guard->isLayoutSuccessor(Preheader)) {
+      return false;
+    }
+    if (TII->reverseBranchCondition(Cond)) {
+      return false;
+    }
+  }
+  switch (Cond[0].getImm()) {
+    default:
+      return false;
+    case EpiphanyCC::COND_NE:
+    case EpiphanyCC::COND_LT:
+    case EpiphanyCC::COND_LTU:
+    case EpiphanyCC::COND_GT:
+    case EpiphanyCC::COND_GTU:
+      break;
+  }
+
+  // All these conditions rule out equality whatever the operand order is
+  MachineInstr *Compare = nullptr;
+  for (auto I = Guard->getFirstTerminator(); I != Guard->begin();) {
+    --I;
+    if (I->definesRegister(Epiphany::STATUS)) {
+      Compare = &*I;
+      break;
+    }
+  }
+  if (!Compare) {
+    return false;
+  }
+  unsigned CmpOpc = Compare->getOpcode();
+  if (CmpOpc != Epiphany::CMPri_r16 && CmpOpc != Epiphany::CMPri_r32 &&
+      CmpOpc != Epiphany::CMPrr_r16 && CmpOpc != Epiphany::CMPrr_r32) {
+    return false;
+  }
+  const MachineOperand &LHS = Compare->getOperand(1);
+  const MachineOperand &RHS = Compare->getOperand(2);
+  return (isSameValue(LHS, *CL.Init, MRI) && isSameValue(RHS, *CL.Bound, MRI)) ||
+         (isSameValue(LHS, *CL.Bound, MRI) && isSameValue(RHS, *CL.Init, MRI));
+}
+
+/// \brief Put the immediate into the new vreg
+unsigned EpiphanyHardwareLoops::materializeImm(MachineBasicBlock *MBB,
+    MachineBasicBlock::iterator InsertPos, int64_t Imm) {
+  const TargetRegisterClass *RC = &Epiphany::GPR32RegClass;
+  DebugLoc DL = DebugLoc();
+  unsigned Reg = MRI->createVirtualRegister(RC);
+  if (isUInt<16>(Imm)) {
+    BuildMI(*MBB, InsertPos, DL, TII->get(Epiphany::MOVi32ri), Reg).addImm(Imm);
+    return Reg;
+  }
+  unsigned LowReg = MRI->createVirtualRegister(RC);
+  BuildMI(*MBB, InsertPos, DL, TII->get(Epiphany::MOVi32ri), LowReg).addImm(Imm & 0xffff);
+  BuildMI(*MBB, InsertPos, DL, TII->get(Epiphany::MOVTi32ri), Reg).addReg(LowReg, RegState::Kill)
+    .addImm((Imm >> 16) & 0xffff);
+  return Reg;
+}
+
+/// \brief Emit the trip count computation
+///
+/// Count = (Bound - Init) * Step, plus one if IV is compared before the increment
+unsigned EpiphanyHardwareLoops::getTripCount(MachineBasicBlock *Preheader,
+    MachineBasicBlock::iterator InsertPos, CountedLoop &CL) {
+  if (CL.TripCount) {
+    return materializeImm(Preheader, InsertPos, CL.TripCount);
+  }
+
+  const TargetRegisterClass *RC = &Epiphany::GPR32RegClass;
+  DebugLoc DL = DebugLoc();
+  MachineOperand *From = CL.Step > 0 ? CL.Init  : CL.Bound;
+  MachineOperand *To   = CL.Step > 0 ? CL.Bound : CL.Init;
+  int64_t Adjust = CL.CompareAfterIncrement ? 0 : 1;
+
+  // Fold the adjustment into the constant if we have one
+  int64_t Val;
+  unsigned ToReg, FromReg;
+  if (getConstValue(*To, MRI, Val)) {
+    ToReg = materializeImm(Preheader, InsertPos, (uint32_t)(Val + Adjust));
+    Adjust = 0;
+  } else {
+    ToReg = To->getReg();
+  }
+  if (getConstValue(*From, MRI, Val)) {
+    FromReg = materializeImm(Preheader, InsertPos, (uint32_t)(Val - Adjust));
+    Adjust = 0;
+  } else {
+    FromReg = From->getReg();
+  }
+
+  unsigned CountReg = MRI->createVirtualRegister(RC);
+  BuildMI(*Preheader, InsertPos, DL, TII->get(Epiphany::SUBrr_r32), CountReg).addReg(ToReg).addReg(FromReg);
+  if (Adjust) {
+    unsigned AdjReg = MRI->createVirtualRegister(RC);
+    BuildMI(*Preheader, InsertPos, DL, TII->get(Epiphany::ADDri_r32), AdjReg).addReg(CountReg, RegState::Kill).addImm(Adjust);
+    CountReg = AdjReg;
+  }
+
+  return CountReg;
+}
+
+bool EpiphanyHardwareLoops::convertToHardwareLoop(MachineLoop *L) {
+  CountedLoop CL;
+  if (!isHardwareLoopCandidate(L) || !analyzeLoop(L, CL)) {
+    return false;
+  }
+
+  MachineBasicBlock *Header = L->getHeader();
+  MachineBasicBlock *Preheader = L->getLoopPreheader();
+  MachineBasicBlock *Exit = L->getExitBlock();
+  MachineFunction &MF = *Header->getParent();
+  const TargetRegisterClass *RC = &Epiphany::GPR32RegClass;
+  DEBUG(dbgs() << "Creating hardware loop for BB#" << Header->getNumber() << "\n");
+
+  // Loop setup goes to the end of the preheader
+  MachineBasicBlock::iterator InsertPos = Preheader->getFirstTerminator();
+  DebugLoc DL = DebugLoc();
+  MCSymbol *StartSym = MF.getContext().createTempSymbol();
+  MCSymbol *EndSym = MF.getContext().createTempSymbol();
+
+  // Loop counter
+  unsigned CountReg = getTripCount(Preheader, InsertPos, CL);
+  BuildMI(*Preheader, InsertPos, DL, TII->get(Epiphany::MOVTS32_core), Epiphany::LC).addReg(CountReg, RegState::Kill);
+  // Loop start, referenced by a label rather than the block itself, as the
+  // body can be replaced later (e.g. by the software pipeliner)
+  unsigned StartLowReg = MRI->createVirtualRegister(RC);
+  unsigned StartReg = MRI->createVirtualRegister(RC);
+  BuildMI(*Preheader, InsertPos, DL, TII->get(Epiphany::MOVi32ri), StartLowReg).addSym(StartSym, EpiphanyII::MO_LOW);
+  BuildMI(*Preheader, InsertPos, DL, TII->get(Epiphany::MOVTi32ri), StartReg).addReg(StartLowReg, RegState::Kill)
+    .addSym(StartSym, EpiphanyII::MO_HIGH);
+  BuildMI(*Preheader, InsertPos, DL, TII->get(Epiphany::MOVTS32_core), Epiphany::LS).addReg(StartReg, RegState::Kill);
+  // Loop end, both labels are placed by the fixup pass
+  unsigned EndLowReg = MRI->createVirtualRegister(RC);
+  unsigned EndReg = MRI->createVirtualRegister(RC);
+  BuildMI(*Preheader, InsertPos, DL, TII->get(Epiphany::MOVi32ri), EndLowReg).addSym(EndSym, EpiphanyII::MO_LOW);
+  BuildMI(*Preheader, InsertPos, DL, TII->get(Epiphany::MOVTi32ri), EndReg).addReg(EndLowReg, RegState::Kill)
+    .addSym(EndSym, EpiphanyII::MO_HIGH);
+  BuildMI(*Preheader, InsertPos, DL, TII->get(Epiphany::MOVTS32_core), Epiphany::LE).addReg(EndReg, RegState::Kill);
+
+  // Replace loop branches, exit is always done with an explicit branch
+  DebugLoc BrDL = Header->findBranchDebugLoc();
+  Header->erase(Header->getFirstTerminator(), Header->end());
+  BuildMI(*Header, Header->end(), BrDL, TII->get(Epiphany::LOOPEND)).addMBB(Header).addSym(StartSym).addSym(EndSym);
+  BuildMI(*Header, Header->end(), BrDL, TII->get(Epiphany::BNONE32)).addMBB(Exit);
+
+  // Compare is not needed anymore, same for the IV if it was used only for counting
+  CL.Compare->eraseFromParent();
+  unsigned IVReg = CL.Phi->getOperand(0).getReg();
+  unsigned NextReg = CL.Increment->getOperand(0).getReg();
+  if (MRI->hasOneNonDBGUse(NextReg) && MRI->hasOneNonDBGUse(IVReg)) {
+    CL.Increment->eraseFromParent();
+    CL.Phi->eraseFromParent();
+  }
+
+  ++NumHWLoops;
+  return true;
+}
+
+bool EpiphanyHardwareLoops::runOnMachineFunction(MachineFunction &MF) {
+  if (skipFunction(*MF.getFunction()))
+    return false;
+
+  // Nothing would save LC/LS/LE for the interrupted code
+  if (MF.getFunction()->hasFnAttribute("interrupt")) {
+    return false;
+  }
+
+  DEBUG(dbgs() << "\nRunning Epiphany hardware loops pass on " << MF.getName() << "\n");
+  TII = MF.getSubtarget<EpiphanySubtarget>().getInstrInfo();
+  MRI = &MF.getRegInfo();
+  MLI = &getAnalysis<MachineLoopInfo>();
+
+  // Only innermost loops are converted, so going through the leafs is enough
+  SmallVector<MachineLoop *, 8> Worklist(MLI->begin(), MLI->end());
+  bool Changed = false;
+  while (!Worklist.empty()) {
+    MachineLoop *L = Worklist.pop_back_val();
+    if (L->begin() != L->end()) {
+      Worklist.append(L->begin(), L->end());
+      continue;
+    }
+    Changed |= convertToHardwareLoop(L);
+  }
+
+  return Changed;
+}
+
+bool EpiphanyFixupHwLoops::runOnMachineFunction(MachineFunction &MF) {
+  const EpiphanyInstrInfo *TII = MF.getSubtarget<EpiphanySubtarget>().getInstrInfo();
+  bool Changed = false;
+
+  for (auto &MBB : MF) {
+    MachineBasicBlock::iterator LoopEnd = MBB.getFirstTerminator();
+    while (LoopEnd != MBB.end() && LoopEnd->getOpcode() != Epiphany::LOOPEND)
+      ++LoopEnd;
+    if (LoopEnd == MBB.end()) {
+      continue;
+    }
+
+    MachineBasicBlock *Start = LoopEnd->getOperand(0).getMBB();
+    MCSymbol *StartSym = LoopEnd->getOperand(1).getMCSymbol();
+    MCSymbol *EndSym = LoopEnd->getOperand(2).getMCSymbol();
+    DebugLoc DL = LoopEnd->getDebugLoc();
+    assert(Start == &MBB && "Hardware loop body should be a single block");
+
+    // Find the last real instruction, LE points to it
+    MachineBasicBlock::iterator Last = LoopEnd;
+    bool Found = false;
+    while (Last != MBB.begin()) {
+      --Last;
+      if (!Last->isDebugValue() && !Last->isCFIInstruction() && !Last->isKill() && !Last->isImplicitDef()) {
+        Found = true;
+        break;
+      }
+    }
+    // It should be 32-bit, widen it or pad with a 32-bit nop otherwise
+    if (Found && TII->getInstSizeInBytes(*Last) != 4) {
+      if (unsigned WideOpc = TII->getWideOpcode(Last->getOpcode())) {
+        DEBUG(dbgs() << "Widening hardware loop end: "; Last->dump());
+        Last->setDesc(TII->get(WideOpc));
+      }
+    }
+    if (!Found || TII->getInstSizeInBytes(*Last) != 4) {
+      DEBUG(dbgs() << "Padding hardware loop end in BB#" << MBB.getNumber() << "\n");
+      Last = BuildMI(MBB, LoopEnd, DL, TII->get(Epiphany::MOVi32rr), Epiphany::ZERO)
+        .addReg(Epiphany::ZERO, RegState::Undef);
+    }
+    BuildMI(MBB, Last, DL, TII->get(TargetOpcode::EH_LABEL)).addSym(EndSym);
+
+    // Loop start should be 8-byte aligned
+    Start->setAlignment(3);
+    BuildMI(*Start, Start->begin(), DL, TII->get(TargetOpcode::EH_LABEL)).addSym(StartSym);
+
+    // Exit branch may be just a fallthrough
+    MachineBasicBlock::iterator Next = std::next(LoopEnd);
+    LoopEnd->eraseFromParent();
+    if (Next != MBB.end() && Next->getOpcode() == Epiphany::BNONE32 &&
+        MBB.isLayoutSuccessor(Next->getOperand(0).getMBB())) {
+      Next->eraseFromParent();
+    }
+    Changed = true;
+  }
+
+  return Changed;
+}
+
+//===----------------------------------------------------------------------===//
+//                         Public Constructor Functions
+//===----------------------------------------------------------------------===//
+FunctionPass *llvm::createEpiphanyHardwareLoopsPass() {
+  return new EpiphanyHardwareLoops();
+}
+
+FunctionPass *llvm::createEpiphanyFixupHwLoopsPass() {
+  return new EpiphanyFixupHwLoops();
+}
@@ -0,0 +1,107 @@
+//===---------------------EpiphanyHardwareLoops.h--------------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYHARDWARELOOPS_H
+#define _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYHARDWARELOOPS_H
+
+#include "Epiphany.h"
+#include "EpiphanyConfig.h"
+#include "EpiphanyInstrInfo.h"
+#include "EpiphanySubtarget.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Target/TargetInstrInfo.h"
+
+namespace llvm {
+  void initializeEpiphanyHardwareLoopsPass(PassRegistry&);
+  void initializeEpiphanyFixupHwLoopsPass(PassRegistry&);
+
+  /// Converts counted single-block innermost loops into zero-overhead loops.
+  /// Runs on SSA, before register allocation.
+  class EpiphanyHardwareLoops : public MachineFunctionPass {
+    private:
+      const EpiphanyInstrInfo *TII;
+      MachineRegisterInfo *MRI;
+      MachineLoopInfo *MLI;
+
+      // Description of the counted loop found by analyzeLoop
+      struct CountedLoop {
+        MachineInstr *Phi = nullptr;
+        MachineInstr *Increment = nullptr;
+        MachineInstr *Compare = nullptr;
+        // Value of the IV on the loop entry
+        MachineOperand *Init = nullptr;
+        // Value the IV is compared against
+        MachineOperand *Bound = nullptr;
+        int64_t Step = 0;
+        // Set if the IV value is compared after the increment
+        bool CompareAfterIncrement = false;
+        // Condition under which the loop is continued
+        EpiphanyCC::CondCodes Cond = EpiphanyCC::COND_NONE;
+        // Number of iterations if known at compile time, 0 otherwise
+        int64_t TripCount = 0;
+      };
+
+      bool isHardwareLoopCandidate(MachineLoop *L);
+      bool analyzeLoop(MachineLoop *L, CountedLoop &CL);
+      bool isGuardedAgainstZeroTrip(MachineLoop *L, CountedLoop &CL);
+      unsigned getTripCount(MachineBasicBlock *Preheader, MachineBasicBlock::iterator InsertPos,
+          CountedLoop &CL);
+      unsigned materializeImm(MachineBasicBlock *MBB, MachineBasicBlock::iterator InsertPos,
+          int64_t Imm);
+      bool convertToHardwareLoop(MachineLoop *L);
+
+    public:
+      static char ID;
+      EpiphanyHardwareLoops() : MachineFunctionPass(ID) {
+        initializeEpiphanyHardwareLoopsPass(*PassRegistry::getPassRegistry());
+      }
+
+      void getAnalysisUsage(AnalysisUsage &AU) const override {
+        AU.addRequired<MachineLoopInfo>();
+        MachineFunctionPass::getAnalysisUsage(AU);
+      }
+
+      StringRef getPassName() const override {
+        return "Epiphany hardware loops";
+      }
+
+      bool runOnMachineFunction(MachineFunction &MF) override;
+  };
+
+  /// Late part of the hardware loop generation. Places the loop labels,
+  /// aligns loop start and makes sure the last instruction is 32-bit.
+  /// Should run after everything that can change the loop body.
+  class EpiphanyFixupHwLoops : public MachineFunctionPass {
+    public:
+      static char ID;
+      EpiphanyFixupHwLoops() : MachineFunctionPass(ID) {
+        initializeEpiphanyFixupHwLoopsPass(*PassRegistry::getPassRegistry());
+      }
+
+      StringRef getPassName() const override {
+        return "Epiphany hardware loop fixup";
+      }
+
+      MachineFunctionProperties getRequiredProperties() const override {
+        return MachineFunctionProperties().set(
+            MachineFunctionProperties::Property::NoVRegs);
+      }
+
+      bool runOnMachineFunction(MachineFunction &MF) override;
+  };
+
+} // namespace llvm
+
+#endif
@@ -0,0 +1,127 @@
+//===---------------------EpiphanyHazardRecognizer.cpp---------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the hazard recognizer for the E16 core.
+//
+//  The core interlocks, so nothing here is about correctness, the goal is to
+//  let the scheduler fill the cycles the core would otherwise spend stalled.
+//  Load-use and FPU result latencies are on the DAG edges (see
+//  EpiphanyInstrInfo::getOperandLatency), only the structural hazards are
+//  handled here:
+//  * Issue slots - one IALU/load/store and one FPU/IALU2 instruction per
+//    cycle, taken from the itineraries. Special register moves (including
+//    the CONFIG mode switches) take both slots.
+//  * Fetch bank conflicts - a load or store to the memory bank the code is
+//    fetched from steals the cycle from the fetch unit. Unless the accessed
+//    object is in a bank section, the bank is not known before linking, so
+//    any access not going to the stack (which is at the top of the local
+//    memory) is assumed to possibly hit it, and two of them are not issued
+//    back-to-back if there is anything else to issue.
+//
+
+#include "EpiphanyHazardRecognizer.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "epiphany-hazard"
+
+EpiphanyHazardRecognizer::EpiphanyHazardRecognizer(const InstrItineraryData *II,
+    const ScheduleDAG *DAG, bool TrackFetchBank, const char *ParentDebugType)
+  : ScoreboardHazardRecognizer(II, DAG, ParentDebugType),
+  TrackFetchBank(TrackFetchBank) {
+  // All stages are single-cycle, so the scoreboard finds nothing to look
+  // ahead for and considers itself disabled
+  if (!MaxLookAhead && II && !II->isEmpty()) {
+    MaxLookAhead = 1;
+  }
+}
+
+/// \brief Bank the function code is placed into
+int EpiphanyHazardRecognizer::getFetchBank(const Function &F) {
+  int Bank = EpiphanyTargetObjectFile::getFunctionBank(F);
+  if (Bank < 0) {
+    Bank = EpiphanyTargetObjectFile::getSectionBank(F.getSection());
+  }
+  return Bank < 0 ? EpiphanyBank::CodeBank : Bank;
+}
+
+/// \brief Returns true if MI may access the bank instructions are fetched from
+bool EpiphanyHazardRecognizer::mayHitFetchBank(const MachineInstr &MI) const {
+  if (!MI.mayLoadOrStore()) {
+    return false;
+  }
+
+  // Frame is always at the top of the local memory
+  for (const MachineOperand &MO : MI.operands()) {
+    if (MO.isFI() || (MO.isReg() && (MO.getReg() == Epiphany::SP || MO.getReg() == Epiphany::FP))) {
+      return false;
+    }
+  }
+  for (const MachineMemOperand *MMO : MI.memoperands()) {
+    const PseudoSourceValue *PSV = MMO->getPseudoValue();
+    if (PSV && (PSV->isStack() || PSV->kind() == PseudoSourceValue::FixedStack)) {
+      return false;
+    }
+  }
+
+  // Objects placed into another bank than the code
+  const MachineFunction &MF = *MI.getParent()->getParent();
+  for (const MachineMemOperand *MMO : MI.memoperands()) {
+    const Value *V = MMO->getValue();
+    if (!V) {
+      continue;
+    }
+    const auto *GO = dyn_cast<GlobalObject>(GetUnderlyingObject(V, MF.getDataLayout()));
+    if (!GO) {
+      continue;
+    }
+    int Bank = EpiphanyTargetObjectFile::getSectionBank(GO->getSection());
+    if (Bank >= 0 && Bank != getFetchBank(*MF.getFunction())) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool EpiphanyHazardRecognizer::ShouldPreferAnother(SUnit *SU) {
+  if (!TrackFetchBank || !SU->isInstr() || !HasFetchBankAccess) {
+    return false;
+  }
+  // Access in the previous or in the current cycle
+  return CurCycle <= LastFetchBankAccess + 1 && mayHitFetchBank(*SU->getInstr());
+}
+
+void EpiphanyHazardRecognizer::EmitInstruction(SUnit *SU) {
+  ScoreboardHazardRecognizer::EmitInstruction(SU);
+  if (!TrackFetchBank || !SU->isInstr()) {
+    return;
+  }
+
+  if (mayHitFetchBank(*SU->getInstr())) {
+    LastFetchBankAccess = CurCycle;
+    HasFetchBankAccess = true;
+  }
+}
+
+void EpiphanyHazardRecognizer::AdvanceCycle() {
+  ScoreboardHazardRecognizer::AdvanceCycle();
+  ++CurCycle;
+}
+
+void EpiphanyHazardRecognizer::RecedeCycle() {
+  ScoreboardHazardRecognizer::RecedeCycle();
+  assert(!TrackFetchBank && "Fetch bank accesses are only tracked top-down");
+}
+
+void EpiphanyHazardRecognizer::Reset() {
+  ScoreboardHazardRecognizer::Reset();
+  CurCycle = 0;
+  LastFetchBankAccess = 0;
+  HasFetchBankAccess = false;
+}
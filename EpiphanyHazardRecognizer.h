@@ -0,0 +1,61 @@
+//===---------------------EpiphanyHazardRecognizer.h-----------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYHAZARDRECOGNIZER_H
+#define _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYHAZARDRECOGNIZER_H
+
+#include "Epiphany.h"
+#include "EpiphanyConfig.h"
+#include "EpiphanyInstrInfo.h"
+#include "EpiphanySubtarget.h"
+#include "EpiphanyTargetObjectFile.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/PseudoSourceValue.h"
+#include "llvm/CodeGen/ScheduleDAG.h"
+#include "llvm/CodeGen/ScoreboardHazardRecognizer.h"
+#include "llvm/MC/MCInstrItineraries.h"
+#include "llvm/Support/Debug.h"
+
+namespace llvm {
+
+  /// Hazard recognizer for the E16 core, shared by all schedulers.
+  ///
+  /// Only structural hazards are handled: issue slot conflicts come from the
+  /// itineraries, and back-to-back accesses that may hit the bank
+  /// instructions are fetched from are spread out. Data latencies are left
+  /// to the DAG edges.
+  class EpiphanyHazardRecognizer : public ScoreboardHazardRecognizer {
+    private:
+      // Fetch bank accesses are only tracked by the top-down post-RA
+      // scheduler, the others have no notion of the issue cycle
+      bool TrackFetchBank;
+
+      // Current cycle since the region start
+      unsigned CurCycle = 0;
+      // Last cycle with an access that may stall the instruction fetch
+      unsigned LastFetchBankAccess = 0;
+      bool HasFetchBankAccess = false;
+
+      static int getFetchBank(const Function &F);
+      bool mayHitFetchBank(const MachineInstr &MI) const;
+
+    public:
+      EpiphanyHazardRecognizer(const InstrItineraryData *II, const ScheduleDAG *DAG,
+          bool TrackFetchBank, const char *ParentDebugType);
+
+      bool ShouldPreferAnother(SUnit *SU) override;
+      void EmitInstruction(SUnit *SU) override;
+      void AdvanceCycle() override;
+      void RecedeCycle() override;
+      void Reset() override;
+  };
+
+} // namespace llvm
+
+#endif
@@ -135,11 +135,80 @@ bool EpiphanyDAGToDAGISel::trySelect(SDNode *Node) {
   switch(Opcode) {
     default: break;
 
+    case ISD::LOAD:
+      return tryIndexedLoad(Node);
   }
 
   return false;
 }
 
+/// Selects post-modify loads, these have two results and can't be matched
+/// by the tablegen patterns. Stores are matched in EpiphanyInstrInfo.td.
+bool EpiphanyDAGToDAGISel::tryIndexedLoad(SDNode *Node) {
+  LoadSDNode *LD = cast<LoadSDNode>(Node);
+  if (LD->getAddressingMode() == ISD::UNINDEXED) {
+    return false;
+  }
+  assert(LD->getAddressingMode() == ISD::POST_INC && "Only post-modify loads are legal");
+  SDLoc DL(Node);
+
+  SDValue Offset = LD->getOffset();
+  ConstantSDNode *C = dyn_cast<ConstantSDNode>(Offset);
+  if (C) {
+    Offset = CurDAG->getTargetConstant(C->getSExtValue(), DL, MVT::i32);
+  }
+
+  // Loaded value type, FP values are loaded as integers of the same size
+  EVT VT = LD->getMemoryVT();
+  MVT ResTy = MVT::i32;
+  unsigned RegClassID = 0;
+  unsigned Opc;
+  switch (VT.getSimpleVT().SimpleTy) {
+    default:
+      return false;
+    case MVT::i8:
+      Opc = C ? Epiphany::LDRi8_pmd_r32 : Epiphany::LDRi8_pm_add_r32;
+      break;
+    case MVT::i16:
+      Opc = C ? Epiphany::LDRi16_pmd_r32 : Epiphany::LDRi16_pm_add_r32;
+      break;
+    case MVT::f32:
+      RegClassID = Epiphany::FPR32RegClassID;
+      LLVM_FALLTHROUGH;
+    case MVT::i32:
+      Opc = C ? Epiphany::LDRi32_pmd_r32 : Epiphany::LDRi32_pm_add_r32;
+      break;
+    case MVT::f64:
+      RegClassID = Epiphany::FPR64RegClassID;
+      LLVM_FALLTHROUGH;
+    case MVT::i64:
+      if (!C) {
+        return false;
+      }
+      ResTy = MVT::i64;
+      Opc = Epiphany::LDRi64_pmd;
+      break;
+  }
+
+  SDValue Ops[] = { LD->getBasePtr(), Offset, LD->getChain() };
+  MachineSDNode *Res = CurDAG->getMachineNode(Opc, DL, ResTy, MVT::i32, MVT::Other, Ops);
+  MachineSDNode::mmo_iterator MemOp = MF->allocateMemRefsArray(1);
+  MemOp[0] = LD->getMemOperand();
+  Res->setMemRefs(MemOp, MemOp + 1);
+
+  SDValue Value(Res, 0);
+  if (RegClassID) {
+    Value = SDValue(CurDAG->getMachineNode(TargetOpcode::COPY_TO_REGCLASS, DL,
+          LD->getValueType(0), Value, CurDAG->getTargetConstant(RegClassID, DL, MVT::i32)), 0);
+  }
+
+  ReplaceUses(SDValue(Node, 0), Value);
+  ReplaceUses(SDValue(Node, 1), SDValue(Res, 1));
+  ReplaceUses(SDValue(Node, 2), SDValue(Res, 2));
+  CurDAG->RemoveDeadNode(Node);
+  return true;
+}
+
 //@Select {
 /// Select instructions not customized! Used for
 /// expanded, promoted and normal instructions
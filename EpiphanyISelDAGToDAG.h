@@ -65,6 +65,7 @@ private:
   void Select(SDNode *N) override;
 
   bool trySelect(SDNode *Node);
+  bool tryIndexedLoad(SDNode *Node);
 
   void processFunctionAfterISel(MachineFunction &MF);
 
@@ -32,7 +32,6 @@
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/GlobalVariable.h"
-#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
@@ -42,10 +41,6 @@ using namespace llvm;
 
 #define DEBUG_TYPE "epiphany-lower"
 
-static cl::opt<bool> EnableFastMath("ffast-math",
-    cl::Hidden, cl::ZeroOrMore, cl::init(false),
-    cl::desc("Enable Fast Math processing"));
-
 
 const char *EpiphanyTargetLowering::getTargetNodeName(unsigned Opcode) const {
   switch (Opcode) {
@@ -79,8 +74,9 @@ EpiphanyTargetLowering::EpiphanyTargetLowering(const EpiphanyTargetMachine &TM,
 //    addRegisterClass(MVT::v4i8,  &Epiphany::GPR32RegClass);
     addRegisterClass(MVT::f32,   &Epiphany::FPR32RegClass);
     addRegisterClass(MVT::i64,   &Epiphany::GPR64RegClass);
-//    addRegisterClass(MVT::v2i32, &Epiphany::GPR64RegClass);
+    addRegisterClass(MVT::v2i32, &Epiphany::GPR64RegClass);
     addRegisterClass(MVT::f64,   &Epiphany::FPR64RegClass);
+    addRegisterClass(MVT::v2f32, &Epiphany::FPR64RegClass);
 
     // Max atomic instruction size is 64 for load/store instruction
     setMaxAtomicSizeInBitsSupported(64);
@@ -107,10 +103,11 @@ EpiphanyTargetLowering::EpiphanyTargetLowering(const EpiphanyTargetMachine &TM,
     setOperationAction(ISD::UREM,       MVT::i32,  Expand);
     setOperationAction(ISD::SDIVREM,    MVT::i32,  Expand);
     setOperationAction(ISD::UDIVREM,    MVT::i32,  Expand);
-    setOperationAction(ISD::MULHS,      MVT::i32,  Expand);
-    setOperationAction(ISD::MULHU,      MVT::i32,  Expand);
-    setOperationAction(ISD::UMUL_LOHI,  MVT::i32,  Expand);
-    setOperationAction(ISD::SMUL_LOHI,  MVT::i32,  Expand);
+    // High half of the product is built from 16x16 partial products
+    setOperationAction(ISD::MULHS,      MVT::i32,  Custom);
+    setOperationAction(ISD::MULHU,      MVT::i32,  Custom);
+    setOperationAction(ISD::UMUL_LOHI,  MVT::i32,  Custom);
+    setOperationAction(ISD::SMUL_LOHI,  MVT::i32,  Custom);
 
     // Legalize some vector stores and loads
 //    for (MVT VT : MVT::vector_valuetypes()) {
@@ -121,9 +118,6 @@ EpiphanyTargetLowering::EpiphanyTargetLowering(const EpiphanyTargetMachine &TM,
 //    ValueTypeActions.setTypeAction(MVT::v2i16, TypeLegal);
 //    setOperationAction(ISD::LOAD, MVT::v2i16, Legal);
 //    setOperationAction(ISD::STORE, MVT::v2i16, Legal);
-//    ValueTypeActions.setTypeAction(MVT::v2i32, TypeLegal);
-//    setOperationAction(ISD::LOAD, MVT::v2i32, Legal);
-//    setOperationAction(ISD::STORE, MVT::v2i32, Legal);
 
     for (MVT VT : MVT::fp_valuetypes()) {
       setOperationAction(ISD::FDIV,  VT,  Expand);
@@ -136,15 +130,10 @@ EpiphanyTargetLowering::EpiphanyTargetLowering(const EpiphanyTargetMachine &TM,
       setOperationAction(ISD::FREM,  VT,  Expand);
     }
     
-    // Allow pre/post inc stores and loads
+    // Allow post inc stores and loads, there is no pre-modify addressing.
+    // Post-decrement is a post-increment by a negative offset.
     for (MVT Ty : {MVT::i8, MVT::i16, MVT::i32, MVT::f32, MVT::i64, MVT::f64}) {
-      setIndexedLoadAction(ISD::PRE_DEC,  Ty, Legal);
-      setIndexedLoadAction(ISD::PRE_INC,  Ty, Legal);
-      setIndexedLoadAction(ISD::POST_DEC, Ty, Legal);
       setIndexedLoadAction(ISD::POST_INC, Ty, Legal);
-      setIndexedStoreAction(ISD::PRE_DEC,  Ty, Legal);
-      setIndexedStoreAction(ISD::PRE_INC,  Ty, Legal);
-      setIndexedStoreAction(ISD::POST_DEC, Ty, Legal);
       setIndexedStoreAction(ISD::POST_INC, Ty, Legal);
     }
 
@@ -163,7 +152,7 @@ EpiphanyTargetLowering::EpiphanyTargetLowering(const EpiphanyTargetMachine &TM,
     setLoadExtAction(ISD::SEXTLOAD, MVT::f64, MVT::f32, Expand);
 
     // For now - expand i64 ops that were not implemented yet
-    setOperationAction(ISD::MUL,       MVT::i64, Expand);
+    setOperationAction(ISD::MUL,       MVT::i64, Custom);
     setOperationAction(ISD::SMUL_LOHI, MVT::i64, Expand);
     setOperationAction(ISD::UMUL_LOHI, MVT::i64, Expand);
     setOperationAction(ISD::SDIV,      MVT::i64, Expand);
@@ -206,11 +195,18 @@ EpiphanyTargetLowering::EpiphanyTargetLowering(const EpiphanyTargetMachine &TM,
     setOperationAction(ISD::ADDC,      MVT::i64, Custom);
     setOperationAction(ISD::SUB,       MVT::i64, Custom);
     setOperationAction(ISD::SUBC,      MVT::i64, Custom);
+    for (unsigned Opc : {ISD::SHL, ISD::SRL, ISD::SRA}) {
+      setOperationAction(Opc, MVT::i64, Custom);
+    }
+    // i32 parts are never formed as i64 is legal, i64 parts of wider types
+    // are split into i64 shifts
+    for (unsigned Opc : {ISD::SHL_PARTS, ISD::SRL_PARTS, ISD::SRA_PARTS}) {
+      setOperationAction(Opc, MVT::i32, Expand);
+      setOperationAction(Opc, MVT::i64, Expand);
+    }
 
 //    setOperationAction(ISD::BUILD_VECTOR, MVT::v2i16, Custom);
-//    setOperationAction(ISD::BUILD_VECTOR, MVT::v2i32, Custom);
 //    setOperationAction(ISD::EXTRACT_VECTOR_ELT, MVT::v2i16, Custom);
-//    setOperationAction(ISD::EXTRACT_VECTOR_ELT, MVT::v2i32, Custom);
 
         // Just expand all custom versions, as they're getting on the nerves
     for (MVT VT : MVT::all_valuetypes()) {
@@ -220,10 +216,39 @@ EpiphanyTargetLowering::EpiphanyTargetLowering(const EpiphanyTargetMachine &TM,
       setOperationAction(ISD::SINT_TO_FP, VT, Custom);
     }
 
-    // Libraries for fast math
-    if (EnableFastMath) {
-      setLibcallName(RTLIB::DIV_F32, "__fast_recipsf2");
-      setOperationAction(ISD::FDIV, MVT::f32, Custom);
+    // 2 x 32-bit vectors live in register pairs. Only loads/stores, element
+    // access and element-wise math having patterns are kept, everything else
+    // is split into scalar ops
+    for (MVT VT : {MVT::v2i32, MVT::v2f32}) {
+      for (unsigned Opc = 0; Opc < ISD::BUILTIN_OP_END; ++Opc) {
+        setOperationAction(Opc, VT, Expand);
+      }
+      for (MVT MemVT : MVT::vector_valuetypes()) {
+        setLoadExtAction(ISD::EXTLOAD,  VT, MemVT, Expand);
+        setLoadExtAction(ISD::ZEXTLOAD, VT, MemVT, Expand);
+        setLoadExtAction(ISD::SEXTLOAD, VT, MemVT, Expand);
+        setTruncStoreAction(VT, MemVT, Expand);
+      }
+      setOperationAction(ISD::LOAD,               VT, Legal);
+      setOperationAction(ISD::STORE,              VT, Legal);
+      setOperationAction(ISD::BITCAST,            VT, Legal);
+      setOperationAction(ISD::BUILD_VECTOR,       VT, Custom);
+      setOperationAction(ISD::EXTRACT_VECTOR_ELT, VT, Custom);
+      setOperationAction(ISD::INSERT_VECTOR_ELT,  VT, Custom);
+    }
+    for (unsigned Opc : {ISD::ADD, ISD::SUB, ISD::MUL, ISD::AND, ISD::OR, ISD::XOR,
+                         ISD::SHL, ISD::SRL, ISD::SRA}) {
+      setOperationAction(Opc, MVT::v2i32, Legal);
+    }
+    for (unsigned Opc : {ISD::FADD, ISD::FSUB, ISD::FMUL}) {
+      setOperationAction(Opc, MVT::v2f32, Legal);
+    }
+
+    // Integer division is inlined on request, see LowerDivRem
+    if (STI.hasInlineDiv()) {
+      for (unsigned Opc : {ISD::SDIV, ISD::UDIV, ISD::SREM, ISD::UREM}) {
+        setOperationAction(Opc, MVT::i32, Custom);
+      }
     }
   }
 
@@ -266,9 +291,6 @@ SDValue EpiphanyTargetLowering::LowerOperation(SDValue Op,
     case ISD::BRCOND:
       return LowerBrCond(Op, DAG);
       break;
-    case ISD::FDIV:
-      return LowerFastDiv(Op, DAG);
-      break;
     case ISD::FP_TO_SINT:
     case ISD::FP_TO_UINT:
       return LowerFpToInt(Op, DAG);
@@ -285,6 +307,28 @@ SDValue EpiphanyTargetLowering::LowerOperation(SDValue Op,
     case ISD::SUBC:
       return LowerSub64(Op, DAG);
       break;
+    case ISD::MUL:
+      return LowerMul64(Op, DAG);
+      break;
+    case ISD::SHL:
+    case ISD::SRL:
+    case ISD::SRA:
+      return LowerShift64(Op, DAG);
+      break;
+    case ISD::MULHS:
+    case ISD::MULHU:
+      return LowerMulHi(Op, DAG);
+      break;
+    case ISD::SMUL_LOHI:
+    case ISD::UMUL_LOHI:
+      return LowerMulLoHi(Op, DAG);
+      break;
+    case ISD::SDIV:
+    case ISD::UDIV:
+    case ISD::SREM:
+    case ISD::UREM:
+      return LowerDivRem(Op, DAG);
+      break;
     case ISD::ADDE:
       return LowerAdde(Op, DAG);
       break;
@@ -297,6 +341,9 @@ SDValue EpiphanyTargetLowering::LowerOperation(SDValue Op,
     case ISD::EXTRACT_VECTOR_ELT:
       return LowerExtractVectorElt(Op, DAG);
       break;
+    case ISD::INSERT_VECTOR_ELT:
+      return LowerInsertVectorElt(Op, DAG);
+      break;
   }
   return SDValue();
 }
@@ -305,37 +352,93 @@ SDValue EpiphanyTargetLowering::LowerOperation(SDValue Op,
 static SDValue createGPR64(SelectionDAG &DAG, SDValue Low, SDValue High, MVT VT = MVT::i64) {
   SDLoc DL(High.getNode());
 
-  SDValue RegClass = DAG.getTargetConstant(Epiphany::GPR64RegClassID, DL, MVT::i32);
+  unsigned RegClassID = VT.isFloatingPoint() ? Epiphany::FPR64RegClassID : Epiphany::GPR64RegClassID;
+  SDValue RegClass = DAG.getTargetConstant(RegClassID, DL, MVT::i32);
   SDValue SubRegHi = DAG.getTargetConstant(Epiphany::isub_hi, DL, MVT::i32);
   SDValue SubRegLo = DAG.getTargetConstant(Epiphany::isub_lo, DL, MVT::i32);
   const SDValue Ops[] = { RegClass, High, SubRegHi, Low, SubRegLo };
   return SDValue(DAG.getMachineNode(TargetOpcode::REG_SEQUENCE, DL, VT, Ops), 0);
 }
 
+/// FP constant made from its bits, cheaper than a constant pool load
+static SDValue getF32Imm(SelectionDAG &DAG, const SDLoc &DL, uint32_t Bits) {
+  return DAG.getNode(ISD::BITCAST, DL, MVT::f32, DAG.getConstant(Bits, DL, MVT::i32));
+}
+
 //===----------------------------------------------------------------------===//
 //  Fast arithmetics lowering
 //===----------------------------------------------------------------------===//
-SDValue EpiphanyTargetLowering::LowerFastDiv(SDValue Op, SelectionDAG &DAG) const {
-  SDLoc DL(Op);
 
-  // Get operands
-  SDValue LHS   = Op.getOperand(0);
-  SDValue RHS   = Op.getOperand(1);
+/// Reciprocal of X, seeded by subtracting the float bits from a magic
+/// constant (within 1/8) and refined with Newton-Raphson steps,
+/// Y += Y * (1 - X * Y). Each step maps to FMSUB and FMADD.
+/// Three steps give 23 correct bits.
+static SDValue getRecipF32(SelectionDAG &DAG, const SDLoc &DL, SDValue X, unsigned Steps) {
+  SDValue Seed = DAG.getNode(ISD::SUB, DL, MVT::i32, DAG.getConstant(0x7EF311C3, DL, MVT::i32),
+      DAG.getNode(ISD::BITCAST, DL, MVT::i32, X));
+  SDValue Est = DAG.getNode(ISD::BITCAST, DL, MVT::f32, Seed);
+  SDValue One = getF32Imm(DAG, DL, 0x3F800000);
+  for (unsigned i = 0; i < Steps; ++i) {
+    SDValue Err = DAG.getNode(ISD::FSUB, DL, MVT::f32, One, DAG.getNode(ISD::FMUL, DL, MVT::f32, X, Est));
+    Est = DAG.getNode(ISD::FADD, DL, MVT::f32, Est, DAG.getNode(ISD::FMUL, DL, MVT::f32, Est, Err));
+  }
+  return Est;
+}
+
+/// Reciprocal square root of X, magic constant seed (within 1/5) refined
+/// with Newton-Raphson steps, Y *= 1.5 - X/2 * Y * Y.
+/// Two steps give 17 correct bits, three give 22.
+static SDValue getRsqrtF32(SelectionDAG &DAG, const SDLoc &DL, SDValue X, unsigned Steps) {
+  SDValue Bits = DAG.getNode(ISD::BITCAST, DL, MVT::i32, X);
+  SDValue Seed = DAG.getNode(ISD::SUB, DL, MVT::i32, DAG.getConstant(0x5F3759DF, DL, MVT::i32),
+      DAG.getNode(ISD::SRL, DL, MVT::i32, Bits, DAG.getConstant(1, DL, MVT::i32)));
+  SDValue Est = DAG.getNode(ISD::BITCAST, DL, MVT::f32, Seed);
+  SDValue HalfX = DAG.getNode(ISD::FMUL, DL, MVT::f32, X, getF32Imm(DAG, DL, 0x3F000000));
+  SDValue ThreeHalves = getF32Imm(DAG, DL, 0x3FC00000);
+  for (unsigned i = 0; i < Steps; ++i) {
+    SDValue Sq = DAG.getNode(ISD::FMUL, DL, MVT::f32, Est, Est);
+    SDValue Corr = DAG.getNode(ISD::FSUB, DL, MVT::f32, ThreeHalves,
+        DAG.getNode(ISD::FMUL, DL, MVT::f32, HalfX, Sq));
+    Est = DAG.getNode(ISD::FMUL, DL, MVT::f32, Est, Corr);
+  }
+  return Est;
+}
 
-  // Prepare lib call
-  RTLIB::Libcall LC = RTLIB::DIV_F32;
-  SDValue Callee = DAG.getExternalSymbol(getLibcallName(LC),
-      getPointerTy(DAG.getDataLayout()));
+// FDIV and FSQRT are libcalls, so estimates are used whenever the function
+// allows unsafe FP math, unless disabled with "reciprocal-estimates".
+// Refinement is done here, the generic one would load its constants from
+// the constant pool.
+SDValue EpiphanyTargetLowering::getRecipEstimate(SDValue Operand, SelectionDAG &DAG,
+    int Enabled, int &RefinementSteps) const {
+  if (Operand.getValueType() != MVT::f32) {
+    return SDValue();
+  }
+  if (RefinementSteps == ReciprocalEstimate::Unspecified) {
+    RefinementSteps = 3;
+  }
 
-  assert(LHS.getSimpleValueType() == MVT::f32 && RHS.getSimpleValueType() == MVT::f32 && 
-      "Wrong value type in float fast division!");
+  SDValue Est = getRecipF32(DAG, SDLoc(Operand), Operand, RefinementSteps);
+  RefinementSteps = 0;
+  return Est;
+}
 
-  // Call the library
-  SmallVector<SDValue, 2> Ops({RHS, Callee});
-  std::pair<SDValue, SDValue> Divisor = makeLibCall(DAG, LC, MVT::f32, Ops, /* isSigned = */ true, DL);
+SDValue EpiphanyTargetLowering::getSqrtEstimate(SDValue Operand, SelectionDAG &DAG,
+    int Enabled, int &RefinementSteps, bool &UseOneConstNR, bool Reciprocal) const {
+  if (Operand.getValueType() != MVT::f32) {
+    return SDValue();
+  }
+  if (RefinementSteps == ReciprocalEstimate::Unspecified) {
+    RefinementSteps = 3;
+  }
 
-  // Multiply by divident
-  return DAG.getNode(ISD::FMUL, DL, MVT::f32, Divisor.first, LHS, Divisor.second);
+  SDLoc DL(Operand);
+  SDValue Est = getRsqrtF32(DAG, DL, Operand, RefinementSteps);
+  RefinementSteps = 0;
+  // sqrt(X) = X * rsqrt(X), the seed is finite so zero gives zero
+  if (!Reciprocal) {
+    Est = DAG.getNode(ISD::FMUL, DL, MVT::f32, Operand, Est);
+  }
+  return Est;
 }
 
 SDValue EpiphanyTargetLowering::LowerSube(SDValue Op, SelectionDAG &DAG) const {
@@ -416,6 +519,257 @@ SDValue EpiphanyTargetLowering::LowerAdd64(SDValue Op, SelectionDAG &DAG) const
   return createGPR64(DAG, Low, High, MVT::i64);
 }
 
+//===----------------------------------------------------------------------===//
+//  Multiplication lowering
+//===----------------------------------------------------------------------===//
+
+/// High word of the unsigned 32x32 product. IMUL only gives the low word,
+/// so it is summed from 16x16 partial products, which fit in 32 bits.
+static SDValue getMulHU32(SelectionDAG &DAG, const SDLoc &DL, SDValue LHS, SDValue RHS) {
+  SDValue Mask  = DAG.getConstant(0xffff, DL, MVT::i32);
+  SDValue Shift = DAG.getConstant(16, DL, MVT::i32);
+
+  // Halves of the operands
+  SDValue LHS_l = DAG.getNode(ISD::AND, DL, MVT::i32, LHS, Mask);
+  SDValue LHS_h = DAG.getNode(ISD::SRL, DL, MVT::i32, LHS, Shift);
+  SDValue RHS_l = DAG.getNode(ISD::AND, DL, MVT::i32, RHS, Mask);
+  SDValue RHS_h = DAG.getNode(ISD::SRL, DL, MVT::i32, RHS, Shift);
+
+  // Partial products
+  SDValue LL = DAG.getNode(ISD::MUL, DL, MVT::i32, LHS_l, RHS_l);
+  SDValue LH = DAG.getNode(ISD::MUL, DL, MVT::i32, LHS_l, RHS_h);
+  SDValue HL = DAG.getNode(ISD::MUL, DL, MVT::i32, LHS_h, RHS_l);
+  SDValue HH = DAG.getNode(ISD::MUL, DL, MVT::i32, LHS_h, RHS_h);
+
+  // Middle column, its upper bits are the carry into the high word
+  SDValue Mid = DAG.getNode(ISD::ADD, DL, MVT::i32,
+      DAG.getNode(ISD::SRL, DL, MVT::i32, LL, Shift),
+      DAG.getNode(ISD::AND, DL, MVT::i32, LH, Mask));
+  Mid = DAG.getNode(ISD::ADD, DL, MVT::i32, Mid, DAG.getNode(ISD::AND, DL, MVT::i32, HL, Mask));
+
+  SDValue Hi = DAG.getNode(ISD::ADD, DL, MVT::i32, HH, DAG.getNode(ISD::SRL, DL, MVT::i32, LH, Shift));
+  Hi = DAG.getNode(ISD::ADD, DL, MVT::i32, Hi, DAG.getNode(ISD::SRL, DL, MVT::i32, HL, Shift));
+  return DAG.getNode(ISD::ADD, DL, MVT::i32, Hi, DAG.getNode(ISD::SRL, DL, MVT::i32, Mid, Shift));
+}
+
+/// High word of the signed 32x32 product, the unsigned one corrected for
+/// negative operands
+static SDValue getMulHS32(SelectionDAG &DAG, const SDLoc &DL, SDValue LHS, SDValue RHS) {
+  SDValue Hi = getMulHU32(DAG, DL, LHS, RHS);
+  SDValue Sign = DAG.getConstant(31, DL, MVT::i32);
+  SDValue LHSFix = DAG.getNode(ISD::AND, DL, MVT::i32, DAG.getNode(ISD::SRA, DL, MVT::i32, LHS, Sign), RHS);
+  SDValue RHSFix = DAG.getNode(ISD::AND, DL, MVT::i32, DAG.getNode(ISD::SRA, DL, MVT::i32, RHS, Sign), LHS);
+  Hi = DAG.getNode(ISD::SUB, DL, MVT::i32, Hi, LHSFix);
+  return DAG.getNode(ISD::SUB, DL, MVT::i32, Hi, RHSFix);
+}
+
+SDValue EpiphanyTargetLowering::LowerMulHi(SDValue Op, SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  SDValue LHS = Op.getOperand(0);
+  SDValue RHS = Op.getOperand(1);
+  return Op.getOpcode() == ISD::MULHS ? getMulHS32(DAG, DL, LHS, RHS) : getMulHU32(DAG, DL, LHS, RHS);
+}
+
+SDValue EpiphanyTargetLowering::LowerMulLoHi(SDValue Op, SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  SDValue LHS = Op.getOperand(0);
+  SDValue RHS = Op.getOperand(1);
+  SDValue Lo = DAG.getNode(ISD::MUL, DL, MVT::i32, LHS, RHS);
+  SDValue Hi = Op.getOpcode() == ISD::SMUL_LOHI ? getMulHS32(DAG, DL, LHS, RHS) : getMulHU32(DAG, DL, LHS, RHS);
+  SDValue Ops[] = { Lo, Hi };
+  return DAG.getMergeValues(Ops, DL);
+}
+
+SDValue EpiphanyTargetLowering::LowerMul64(SDValue Op, SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  assert(Op.getSimpleValueType() == MVT::i64 && "Only i64 multiplication is custom lowered");
+
+  // Get operands
+  SDValue LHS = Op.getOperand(0);
+  SDValue RHS = Op.getOperand(1);
+
+  // Extract subregs
+  SDValue LHS_l = DAG.getTargetExtractSubreg(Epiphany::isub_lo, DL, MVT::i32, LHS);
+  SDValue LHS_h = DAG.getTargetExtractSubreg(Epiphany::isub_hi, DL, MVT::i32, LHS);
+  SDValue RHS_l = DAG.getTargetExtractSubreg(Epiphany::isub_lo, DL, MVT::i32, RHS);
+  SDValue RHS_h = DAG.getTargetExtractSubreg(Epiphany::isub_hi, DL, MVT::i32, RHS);
+
+  // Low word of the low product, the cross products only affect the high word
+  SDValue Low  = DAG.getNode(ISD::MUL, DL, MVT::i32, LHS_l, RHS_l);
+  SDValue High = getMulHU32(DAG, DL, LHS_l, RHS_l);
+  High = DAG.getNode(ISD::ADD, DL, MVT::i32, High, DAG.getNode(ISD::MUL, DL, MVT::i32, LHS_l, RHS_h));
+  High = DAG.getNode(ISD::ADD, DL, MVT::i32, High, DAG.getNode(ISD::MUL, DL, MVT::i32, LHS_h, RHS_l));
+  return createGPR64(DAG, Low, High, MVT::i64);
+}
+
+//===----------------------------------------------------------------------===//
+//  Shift lowering
+//===----------------------------------------------------------------------===//
+
+/// 64-bit shift of the (Lo, Hi) pair by Amt, without branches.
+///
+/// Register shifts only use the low 5 bits of the amount, so the shifted
+/// halves are the same for Amt and Amt - 32, and bit 5 selects between
+/// them with MOVCC. The bits crossing into the other half are shifted by
+/// 31 - Amt after a shift by one, which also works for a zero amount.
+static void getShift64(SelectionDAG &DAG, const SDLoc &DL, unsigned Opc, SDValue Lo, SDValue Hi,
+                       SDValue Amt, SDValue &ResLo, SDValue &ResHi) {
+  SDValue One  = DAG.getConstant(1, DL, MVT::i32);
+  SDValue Mask = DAG.getConstant(31, DL, MVT::i32);
+  SDValue Amt5   = DAG.getNode(ISD::AND, DL, MVT::i32, Amt, Mask);
+  SDValue RevAmt = DAG.getNode(ISD::XOR, DL, MVT::i32, Amt5, Mask);
+  SDValue Big = DAG.getSetCC(DL, MVT::i32, DAG.getNode(ISD::AND, DL, MVT::i32, Amt,
+        DAG.getConstant(32, DL, MVT::i32)), DAG.getConstant(0, DL, MVT::i32), ISD::SETNE);
+
+  if (Opc == ISD::SHL) {
+    SDValue Cross = DAG.getNode(ISD::SRL, DL, MVT::i32, DAG.getNode(ISD::SRL, DL, MVT::i32, Lo, One), RevAmt);
+    SDValue ShLo = DAG.getNode(ISD::SHL, DL, MVT::i32, Lo, Amt5);
+    SDValue ShHi = DAG.getNode(ISD::OR, DL, MVT::i32, DAG.getNode(ISD::SHL, DL, MVT::i32, Hi, Amt5), Cross);
+    ResLo = DAG.getSelect(DL, MVT::i32, Big, DAG.getConstant(0, DL, MVT::i32), ShLo);
+    ResHi = DAG.getSelect(DL, MVT::i32, Big, ShLo, ShHi);
+    return;
+  }
+
+  // Right shifts, the high half is filled with zeroes or the sign
+  SDValue Cross = DAG.getNode(ISD::SHL, DL, MVT::i32, DAG.getNode(ISD::SHL, DL, MVT::i32, Hi, One), RevAmt);
+  SDValue ShHi = DAG.getNode(Opc, DL, MVT::i32, Hi, Amt5);
+  SDValue ShLo = DAG.getNode(ISD::OR, DL, MVT::i32, DAG.getNode(ISD::SRL, DL, MVT::i32, Lo, Amt5), Cross);
+  SDValue Fill = (Opc == ISD::SRA) ? DAG.getNode(ISD::SRA, DL, MVT::i32, Hi, Mask)
+                                   : DAG.getConstant(0, DL, MVT::i32);
+  ResLo = DAG.getSelect(DL, MVT::i32, Big, ShHi, ShLo);
+  ResHi = DAG.getSelect(DL, MVT::i32, Big, Fill, ShHi);
+}
+
+SDValue EpiphanyTargetLowering::LowerShift64(SDValue Op, SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  assert(Op.getSimpleValueType() == MVT::i64 && "Only i64 shifts are custom lowered");
+
+  // Get operands
+  SDValue LHS = Op.getOperand(0);
+  SDValue Amt = Op.getOperand(1);
+
+  // Shifts by 32 are subregister moves, matched in the .td together with
+  // the 64-bit loads built from them
+  auto *AmtC = dyn_cast<ConstantSDNode>(Amt);
+  if (AmtC && AmtC->getZExtValue() == 32 && Op.getOpcode() != ISD::SRA) {
+    return Op;
+  }
+
+  SDValue LHS_l = DAG.getTargetExtractSubreg(Epiphany::isub_lo, DL, MVT::i32, LHS);
+  SDValue LHS_h = DAG.getTargetExtractSubreg(Epiphany::isub_hi, DL, MVT::i32, LHS);
+  SDValue Lo, Hi;
+  getShift64(DAG, DL, Op.getOpcode(), LHS_l, LHS_h, DAG.getZExtOrTrunc(Amt, DL, MVT::i32), Lo, Hi);
+  return createGPR64(DAG, Lo, Hi, MVT::i64);
+}
+
+//===----------------------------------------------------------------------===//
+//  Division lowering
+//===----------------------------------------------------------------------===//
+
+/// Lower bound of X / D given RB, the slightly reduced reciprocal of D.
+/// FLOAT is signed, so X is halved for the conversion and the result is
+/// doubled. Subtracting 0.5 keeps FIX from rounding up.
+static SDValue getQuotEstimate(SelectionDAG &DAG, const SDLoc &DL, SDValue X, SDValue RB) {
+  SDValue Half = DAG.getNode(ISD::SRL, DL, MVT::i32, X, DAG.getConstant(1, DL, MVT::i32));
+  SDValue F = DAG.getNode(ISD::FMUL, DL, MVT::f32, DAG.getNode(EpiphanyISD::FLOAT, DL, MVT::f32, Half), RB);
+  F = DAG.getNode(ISD::FSUB, DL, MVT::f32, F, getF32Imm(DAG, DL, 0x3F000000));
+  SDValue Q = DAG.getNode(EpiphanyISD::FIX, DL, MVT::i32, F);
+  return DAG.getNode(ISD::ADD, DL, MVT::i32, Q, Q);
+}
+
+/// Unsigned 32-bit quotient and remainder, D is never zero.
+///
+/// There is no integer divider, so the quotient is estimated in the FPU
+/// from the reciprocal of D and then corrected with integer arithmetic:
+///  * 1/D comes from the same estimate as the FP division.
+///  * The reciprocal is reduced by 2^-18, which covers the error of the
+///    refinement and conversions. The estimates therefore never exceed the
+///    quotient in either rounding mode, and the remainder stays unsigned.
+///  * The first estimate is within 2^15 of the quotient. A second estimate,
+///    made from its remainder, leaves at most three subtractions of D.
+///  * Divisors with the top bit set can't be converted. Their quotient is
+///    0 or 1 and is selected at the end.
+///
+/// The remainders need IMUL, which runs in the IALU2 mode, so the sequence
+/// alternates between the modes and costs four CONFIG switches on top of
+/// the arithmetic.
+static void getUDivRem32(SelectionDAG &DAG, const SDLoc &DL, SDValue N, SDValue D,
+                         SDValue &Quot, SDValue &Rem) {
+  // Reciprocal of the divisor
+  SDValue Y = getRecipF32(DAG, DL, DAG.getNode(EpiphanyISD::FLOAT, DL, MVT::f32, D), 3);
+  // 1 - 2^-18
+  SDValue RB = DAG.getNode(ISD::FMUL, DL, MVT::f32, Y, getF32Imm(DAG, DL, 0x3F7FFFC0));
+
+  // Two estimates, each followed by the exact remainder
+  Quot = getQuotEstimate(DAG, DL, N, RB);
+  Rem  = DAG.getNode(ISD::SUB, DL, MVT::i32, N, DAG.getNode(ISD::MUL, DL, MVT::i32, Quot, D));
+  SDValue Q1 = getQuotEstimate(DAG, DL, Rem, RB);
+  Quot = DAG.getNode(ISD::ADD, DL, MVT::i32, Quot, Q1);
+  Rem  = DAG.getNode(ISD::SUB, DL, MVT::i32, Rem, DAG.getNode(ISD::MUL, DL, MVT::i32, Q1, D));
+
+  // Final correction
+  for (unsigned i = 0; i < 3; ++i) {
+    SDValue Ge = DAG.getSetCC(DL, MVT::i32, Rem, D, ISD::SETUGE);
+    Quot = DAG.getNode(ISD::ADD, DL, MVT::i32, Quot, Ge);
+    Rem  = DAG.getSelect(DL, MVT::i32, Ge, DAG.getNode(ISD::SUB, DL, MVT::i32, Rem, D), Rem);
+  }
+
+  // Divisors not fitting into the signed range
+  SDValue Big = DAG.getSetCC(DL, MVT::i32, D, DAG.getConstant(0, DL, MVT::i32), ISD::SETLT);
+  SDValue BigGe = DAG.getSetCC(DL, MVT::i32, N, D, ISD::SETUGE);
+  Quot = DAG.getSelect(DL, MVT::i32, Big, BigGe, Quot);
+  Rem  = DAG.getSelect(DL, MVT::i32, Big,
+      DAG.getSelect(DL, MVT::i32, BigGe, DAG.getNode(ISD::SUB, DL, MVT::i32, N, D), N), Rem);
+}
+
+SDValue EpiphanyTargetLowering::LowerDivRem(SDValue Op, SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  unsigned Opc = Op.getOpcode();
+  bool IsSigned = (Opc == ISD::SDIV || Opc == ISD::SREM);
+  bool IsRem    = (Opc == ISD::UREM || Opc == ISD::SREM);
+
+  // Get operands
+  SDValue LHS = Op.getOperand(0);
+  SDValue RHS = Op.getOperand(1);
+
+  // The inline sequence is about fifty instructions plus the CONFIG
+  // switches and their setup at the function entry, a call is smaller
+  if (DAG.getMachineFunction().getFunction()->optForSize()) {
+    RTLIB::Libcall LC;
+    switch (Opc) {
+      case ISD::SDIV: LC = RTLIB::SDIV_I32; break;
+      case ISD::UDIV: LC = RTLIB::UDIV_I32; break;
+      case ISD::SREM: LC = RTLIB::SREM_I32; break;
+      default:        LC = RTLIB::UREM_I32; break;
+    }
+    SmallVector<SDValue, 2> Ops({LHS, RHS});
+    return makeLibCall(DAG, LC, MVT::i32, Ops, IsSigned, DL).first;
+  }
+
+  // Signed division works on the absolute values
+  SDValue Shift = DAG.getConstant(31, DL, MVT::i32);
+  SDValue LHSSign, RHSSign;
+  if (IsSigned) {
+    LHSSign = DAG.getNode(ISD::SRA, DL, MVT::i32, LHS, Shift);
+    RHSSign = DAG.getNode(ISD::SRA, DL, MVT::i32, RHS, Shift);
+    LHS = DAG.getNode(ISD::SUB, DL, MVT::i32, DAG.getNode(ISD::XOR, DL, MVT::i32, LHS, LHSSign), LHSSign);
+    RHS = DAG.getNode(ISD::SUB, DL, MVT::i32, DAG.getNode(ISD::XOR, DL, MVT::i32, RHS, RHSSign), RHSSign);
+  }
+
+  // Division and remainder of the same operands share the whole sequence
+  SDValue Quot, Rem;
+  getUDivRem32(DAG, DL, LHS, RHS, Quot, Rem);
+  SDValue Res = IsRem ? Rem : Quot;
+  if (!IsSigned) {
+    return Res;
+  }
+
+  // Remainder takes the sign of the dividend, quotient is negative if the
+  // operand signs differ
+  SDValue ResSign = IsRem ? LHSSign : DAG.getNode(ISD::XOR, DL, MVT::i32, LHSSign, RHSSign);
+  return DAG.getNode(ISD::SUB, DL, MVT::i32, DAG.getNode(ISD::XOR, DL, MVT::i32, Res, ResSign), ResSign);
+}
+
 SDValue EpiphanyTargetLowering::LowerSub64(SDValue Op, SelectionDAG &DAG) const {
   SDLoc DL(Op);
   
@@ -762,6 +1116,73 @@ bool EpiphanyTargetLowering::isOffsetFoldingLegal(const GlobalAddressSDNode *GA)
   return false;
 }
 
+/// Memory accesses must be aligned to their size, otherwise the core raises
+/// an unaligned exception. Returning false makes the legalizer split under
+/// aligned dwords into words and words into halves, so LDRD/STRD are only
+/// selected for accesses known to be dword-aligned.
+bool EpiphanyTargetLowering::allowsMisalignedMemoryAccesses(EVT VT, unsigned AddrSpace,
+    unsigned Align, bool *Fast) const {
+  if (Fast) {
+    *Fast = false;
+  }
+  return false;
+}
+
+/// Post-modify addressing: memory is accessed at the base, then the base is
+/// incremented by a register or by an 11-bit immediate scaled by the access
+/// size. Register increments are only available for the integer accesses up
+/// to a word.
+bool EpiphanyTargetLowering::getPostIndexedAddressParts(SDNode *N, SDNode *Op,
+    SDValue &Base, SDValue &Offset, ISD::MemIndexedMode &AM, SelectionDAG &DAG) const {
+  EVT VT;
+  SDValue Ptr;
+  if (LoadSDNode *LD = dyn_cast<LoadSDNode>(N)) {
+    if (LD->getExtensionType() == ISD::SEXTLOAD) {
+      return false;
+    }
+    VT = LD->getMemoryVT();
+    Ptr = LD->getBasePtr();
+  } else if (StoreSDNode *ST = dyn_cast<StoreSDNode>(N)) {
+    VT = ST->getMemoryVT();
+    Ptr = ST->getBasePtr();
+  } else {
+    return false;
+  }
+
+  if (Op->getOpcode() != ISD::ADD || !VT.isSimple() || VT.isVector()) {
+    return false;
+  }
+  int64_t Size = VT.getStoreSize();
+  if (VT.getSizeInBits() != Size * 8 || Size > 8) {
+    return false;
+  }
+
+  // The other add operand is the increment
+  SDValue Inc;
+  if (Op->getOperand(0) == Ptr) {
+    Inc = Op->getOperand(1);
+  } else if (Op->getOperand(1) == Ptr) {
+    Inc = Op->getOperand(0);
+  } else {
+    return false;
+  }
+
+  if (ConstantSDNode *C = dyn_cast<ConstantSDNode>(Inc)) {
+    // Sign and magnitude, magnitude is in access size units
+    int64_t Imm = C->getSExtValue();
+    if (Imm % Size != 0 || std::abs(Imm / Size) > 0x7ff) {
+      return false;
+    }
+  } else if (!VT.isInteger() || Size > 4) {
+    return false;
+  }
+
+  Base   = Ptr;
+  Offset = Inc;
+  AM     = ISD::POST_INC;
+  return true;
+}
+
 SDValue EpiphanyTargetLowering::LowerGlobalAddress(SDValue Op, SelectionDAG &DAG) const {
   SDLoc DL(Op);
 
@@ -774,8 +1195,15 @@ SDValue EpiphanyTargetLowering::LowerGlobalAddress(SDValue Op, SelectionDAG &DAG
   auto PTY = getPointerTy(DAG.getDataLayout());
 
   SDValue AddrLow  = DAG.getTargetGlobalAddress(GV, DL, PTY, Offset, EpiphanyII::MO_LOW);
-  SDValue AddrHigh = DAG.getTargetGlobalAddress(GV, DL, PTY, Offset, EpiphanyII::MO_HIGH);
   SDValue Low = DAG.getNode(EpiphanyISD::MOV, DL, PTY, AddrLow);
+
+  // Local memory is below 0x8000, the high half is zero
+  const auto &TLOF = static_cast<const EpiphanyTargetObjectFile &>(*getObjFileLowering());
+  if (TLOF.isGlobalInLocalMemory(GV, getTargetMachine())) {
+    return Low;
+  }
+
+  SDValue AddrHigh = DAG.getTargetGlobalAddress(GV, DL, PTY, Offset, EpiphanyII::MO_HIGH);
   return DAG.getNode(EpiphanyISD::MOVT, DL, PTY, Low, AddrHigh);
   //}
   }
@@ -1130,7 +1558,7 @@ SDValue EpiphanyTargetLowering::LowerFpRound(SDValue Op, SelectionDAG &DAG) cons
 
 SDValue EpiphanyTargetLowering::LowerBuildVector(SDValue Op, SelectionDAG &DAG) const {
   MVT VT = Op.getSimpleValueType();
-  if (VT == MVT::v2i32) {
+  if (VT == MVT::v2i32 || VT == MVT::v2f32) {
     return createGPR64(DAG, Op.getOperand(0), Op.getOperand(1), Op.getSimpleValueType());
   } else if (VT == MVT::v2i16) {
     SDLoc DL(Op);
@@ -1145,7 +1573,11 @@ SDValue EpiphanyTargetLowering::LowerExtractVectorElt(SDValue Op, SelectionDAG &
   SDLoc DL(Op);
   MVT VT = Op.getOperand(0).getSimpleValueType();
   ConstantSDNode *IndexNode = dyn_cast<ConstantSDNode>(Op.getOperand(1));
-  if (VT == MVT::v2i32) {
+  // Variable index goes through the stack
+  if (!IndexNode) {
+    return SDValue();
+  }
+  if (VT == MVT::v2i32 || VT == MVT::v2f32) {
     int Index = IndexNode->getZExtValue() == 0 ? Epiphany::isub_lo : Epiphany::isub_hi;
     return DAG.getTargetExtractSubreg(Index, DL, Op.getValueType(), Op.getOperand(0));
   } else if (VT == MVT::v2i16) {
@@ -1161,6 +1593,28 @@ SDValue EpiphanyTargetLowering::LowerExtractVectorElt(SDValue Op, SelectionDAG &
   llvm_unreachable(("Unable to build vector, type unimplemented" + Op.getValueType().getEVTString()).c_str());
 }
 
+SDValue EpiphanyTargetLowering::LowerInsertVectorElt(SDValue Op, SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  MVT VT = Op.getSimpleValueType();
+  ConstantSDNode *IndexNode = dyn_cast<ConstantSDNode>(Op.getOperand(2));
+  // Variable index goes through the stack
+  if (!IndexNode) {
+    return SDValue();
+  }
+
+  // Rebuild the pair with one half replaced
+  MVT EltVT = VT.getVectorElementType();
+  SDValue Vec = Op.getOperand(0);
+  SDValue Low  = DAG.getTargetExtractSubreg(Epiphany::isub_lo, DL, EltVT, Vec);
+  SDValue High = DAG.getTargetExtractSubreg(Epiphany::isub_hi, DL, EltVT, Vec);
+  if (IndexNode->getZExtValue() == 0) {
+    Low = Op.getOperand(1);
+  } else {
+    High = Op.getOperand(1);
+  }
+  return createGPR64(DAG, Low, High, VT);
+}
+
 //===----------------------------------------------------------------------===//
 //  Inline asm parsing
 //===----------------------------------------------------------------------===//
@@ -1419,8 +1873,54 @@ EpiphanyTargetLowering::LowerReturn(SDValue Chain,
 //===----------------------------------------------------------------------===//
 //@            Function Call Calling Convention Implementation
 //===----------------------------------------------------------------------===//
-// From original Hoenchen implementation
 
+/// Code placement used to tell near calls from far ones. Bank sections are
+/// all in the local memory, empty string is the default text section.
+static StringRef getCodeRegion(const GlobalObject &GO) {
+  if (const auto *F = dyn_cast<Function>(&GO)) {
+    if (EpiphanyTargetObjectFile::getFunctionBank(*F) >= 0) {
+      return EpiphanyBank::TextPrefix;
+    }
+  }
+  if (EpiphanyTargetObjectFile::getSectionBank(GO.getSection()) >= 0) {
+    return EpiphanyBank::TextPrefix;
+  }
+  return GO.getSection();
+}
+
+/// Returns true if Callee may be out of the BL range, e.g. placed into the
+/// external DRAM while the caller runs from the local memory. Callee is
+/// null for libcalls.
+///
+/// "long-call" and "short-call" callee attributes take precedence, then
+/// the long-calls feature makes every call far. Otherwise the call is
+/// near only if the callee is defined here and placed into the same region
+/// as the caller. The eSDK linker scripts may put e-lib, libgcc or the
+/// default text section of other objects into the external DRAM, so
+/// libcalls, declarations and definitions the linker may replace are far.
+bool EpiphanyTargetLowering::isFarCall(const Function &Caller, const GlobalValue *Callee) const {
+  const auto *F = dyn_cast_or_null<Function>(Callee);
+  if (F && F->hasFnAttribute("long-call")) {
+    return true;
+  }
+  if (F && F->hasFnAttribute("short-call")) {
+    return false;
+  }
+  if (Subtarget.useLongCalls()) {
+    return true;
+  }
+
+  if (!Callee) {
+    return true;
+  }
+  const GlobalObject *GO = Callee->getBaseObject();
+  if (!GO || GO->isDeclarationForLinker() || GO->isWeakForLinker()) {
+    return true;
+  }
+  return getCodeRegion(Caller) != getCodeRegion(*GO);
+}
+
+// From original Hoenchen implementation
 SDValue
 EpiphanyTargetLowering::LowerCall(CallLoweringInfo &CLI, SmallVectorImpl<SDValue> &InVals) const {
   // Init needed parameters
@@ -1557,25 +2057,31 @@ EpiphanyTargetLowering::LowerCall(CallLoweringInfo &CLI, SmallVectorImpl<SDValue
     InFlag = Chain.getValue(1);
   }
 
-  // The linker is responsible for inserting veneers when necessary to put a
-  // function call destination in range, so we don't need to bother with a
-  // wrapper here.
-  // For internal linkage we can use BranchAndLink without regs, while for external it'd be better to use JALR
+  // BL reaches +-16MB, far callees are called with JALR. The linker does
+  // not insert veneers.
   EVT PTY = getPointerTy(DAG.getDataLayout());
   if (auto *G = dyn_cast<GlobalAddressSDNode>(Callee)) {
     DEBUG(dbgs() << "\nArgument is a global value");
     const GlobalValue *GV = G->getGlobal();
-    SDValue AddrLow  = DAG.getTargetGlobalAddress(GV, DL, PTY, 0, EpiphanyII::MO_LOW);
-    SDValue AddrHigh = DAG.getTargetGlobalAddress(GV, DL, PTY, 0, EpiphanyII::MO_HIGH);
-    Callee = DAG.getNode(EpiphanyISD::MOV, DL, PTY, AddrLow);
-    Callee = DAG.getNode(EpiphanyISD::MOVT, DL, PTY, Callee, AddrHigh);
+    if (!isFarCall(*MF.getFunction(), GV)) {
+      Callee = DAG.getTargetGlobalAddress(GV, DL, PTY);
+    } else {
+      SDValue AddrLow  = DAG.getTargetGlobalAddress(GV, DL, PTY, 0, EpiphanyII::MO_LOW);
+      SDValue AddrHigh = DAG.getTargetGlobalAddress(GV, DL, PTY, 0, EpiphanyII::MO_HIGH);
+      Callee = DAG.getNode(EpiphanyISD::MOV, DL, PTY, AddrLow);
+      Callee = DAG.getNode(EpiphanyISD::MOVT, DL, PTY, Callee, AddrHigh);
+    }
   } else if (auto *S = dyn_cast<ExternalSymbolSDNode>(Callee)) {
     DEBUG(dbgs() << "\nArgument is an external symbol");
     const char *Sym = S->getSymbol();
-    SDValue AddrLow  = DAG.getTargetExternalSymbol(Sym, PTY, EpiphanyII::MO_LOW);
-    SDValue AddrHigh = DAG.getTargetExternalSymbol(Sym, PTY, EpiphanyII::MO_HIGH);
-    Callee = DAG.getNode(EpiphanyISD::MOV, DL, PTY, AddrLow);
-    Callee = DAG.getNode(EpiphanyISD::MOVT, DL, PTY, Callee, AddrHigh);
+    if (!isFarCall(*MF.getFunction(), nullptr)) {
+      Callee = DAG.getTargetExternalSymbol(Sym, PTY);
+    } else {
+      SDValue AddrLow  = DAG.getTargetExternalSymbol(Sym, PTY, EpiphanyII::MO_LOW);
+      SDValue AddrHigh = DAG.getTargetExternalSymbol(Sym, PTY, EpiphanyII::MO_HIGH);
+      Callee = DAG.getNode(EpiphanyISD::MOV, DL, PTY, AddrLow);
+      Callee = DAG.getNode(EpiphanyISD::MOVT, DL, PTY, Callee, AddrHigh);
+    }
   }
 
   // We produce the following DAG scheme for the actual call instruction:
@@ -80,6 +80,20 @@ namespace llvm {
       // Offset handling for arrays for non-PIC mode
       bool isOffsetFoldingLegal(const GlobalAddressSDNode *GA) const override;
 
+      // Misaligned accesses trap, so they are split by the legalizer
+      bool allowsMisalignedMemoryAccesses(EVT VT, unsigned AddrSpace, unsigned Align,
+          bool *Fast) const override;
+
+      // Post-modify load/store formation
+      bool getPostIndexedAddressParts(SDNode *N, SDNode *Op, SDValue &Base, SDValue &Offset,
+          ISD::MemIndexedMode &AM, SelectionDAG &DAG) const override;
+
+      // Newton-Raphson estimates for the f32 division and square root
+      SDValue getRecipEstimate(SDValue Operand, SelectionDAG &DAG, int Enabled,
+          int &RefinementSteps) const override;
+      SDValue getSqrtEstimate(SDValue Operand, SelectionDAG &DAG, int Enabled,
+          int &RefinementSteps, bool &UseOneConstNR, bool Reciprocal) const override;
+
       // Overriding operation and custom inserter lowering
       SDValue LowerOperation(SDValue Op, SelectionDAG &DAG) const override;
       MachineBasicBlock *EmitInstrWithCustomInserter(MachineInstr &MI, MachineBasicBlock *MBB) const override;
@@ -155,17 +169,22 @@ namespace llvm {
       SDValue LowerConstantPool(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerBuildVector(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerExtractVectorElt(SDValue Op, SelectionDAG &DAG) const;
+      SDValue LowerInsertVectorElt(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerFpExtend(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerFpRound(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerFpToInt(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerIntToFp(SDValue Op, SelectionDAG &DAG) const;
-      SDValue LowerFastDiv(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerSelectCC(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerSelect(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerSetCC(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerBrCC(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerBrCond(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerAdd64(SDValue Op, SelectionDAG &DAG) const;
+      SDValue LowerMul64(SDValue Op, SelectionDAG &DAG) const;
+      SDValue LowerMulHi(SDValue Op, SelectionDAG &DAG) const;
+      SDValue LowerMulLoHi(SDValue Op, SelectionDAG &DAG) const;
+      SDValue LowerShift64(SDValue Op, SelectionDAG &DAG) const;
+      SDValue LowerDivRem(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerSub64(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerAdde(SDValue Op, SelectionDAG &DAG) const;
       SDValue LowerSube(SDValue Op, SelectionDAG &DAG) const;
@@ -195,6 +214,8 @@ namespace llvm {
           const SDLoc &DL, SelectionDAG &DAG,
           SmallVectorImpl<SDValue> &InVals) const;
 
+      bool isFarCall(const Function &Caller, const GlobalValue *Callee) const;
+
       // TODO: For now - no
       bool IsEligibleForTailCallOptimization(SDValue Callee,
           CallingConv::ID CalleeCC,
@@ -14,10 +14,16 @@
 #include "EpiphanyInstrInfo.h"
 
 #include "MCTargetDesc/EpiphanyAddressingModes.h"
+#include "EpiphanyHazardRecognizer.h"
 #include "EpiphanyTargetMachine.h"
 #include "EpiphanyMachineFunction.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/CodeGen/DFAPacketizer.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/PseudoSourceValue.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/TargetRegistry.h"
 
@@ -27,6 +33,7 @@ using namespace llvm;
 
 #define GET_INSTRINFO_CTOR_DTOR
 #include "EpiphanyGenInstrInfo.inc"
+#include "EpiphanyGenDFAPacketizer.inc"
 
 // Pin the vtable to this file.
 void EpiphanyInstrInfo::anchor() {}
@@ -40,6 +47,13 @@ EpiphanyInstrInfo::EpiphanyInstrInfo(const EpiphanySubtarget &STI)
     return RI;
   }
 
+/// Create machine specific model for scheduling, used by the packetizer
+DFAPacketizer *EpiphanyInstrInfo::CreateTargetScheduleState(
+    const TargetSubtargetInfo &STI) const {
+  const InstrItineraryData *II = STI.getInstrItineraryData();
+  return static_cast<const EpiphanySubtarget &>(STI).createDFAPacketizer(II);
+}
+
 //@expandPostRAPseudo
 /// Expand Pseudo instructions into real backend instructions
 bool EpiphanyInstrInfo::expandPostRAPseudo(MachineInstr &MI) const {
@@ -106,13 +120,31 @@ bool EpiphanyInstrInfo::analyzeBranch(MachineBasicBlock &MBB, MachineBasicBlock
       return true;
     }
 
-    // Indirect branches with links are not handled
-    if (I->getOpcode() == Epiphany::BL32 || I->getOpcode() == Epiphany::JR32) {
+    // Indirect branches are not handled
+    if (I->getOpcode() == Epiphany::JR32) {
       return true;
     }
 
+    // Hardware loop end is a conditional branch back to the loop start, loop
+    // labels are kept in the condition so it can be rebuilt. Only the
+    // pipeliner needs it, running on SSA right after the hardware loops pass.
+    // Branch folding, tail merging and block placement come after the
+    // register allocation and could break the single-block layout LS/LE rely
+    // on, so for them the loop end stays opaque.
+    if (I->getOpcode() == Epiphany::LOOPEND) {
+      if (!Cond.empty() || !MBB.getParent()->getRegInfo().isSSA()) {
+        return true;
+      }
+      FBB = TBB;
+      TBB = I->getOperand(0).getMBB();
+      Cond.push_back(MachineOperand::CreateImm(EpiphanyCC::COND_LOOP));
+      Cond.push_back(MachineOperand::CreateMCSymbol(I->getOperand(1).getMCSymbol()));
+      Cond.push_back(MachineOperand::CreateMCSymbol(I->getOperand(2).getMCSymbol()));
+      continue;
+    }
+
     // Handle unconditional branches.
-    if (I->getOpcode() == Epiphany::BNONE32) {
+    if (I->getOpcode() == Epiphany::BNONE32 || I->getOpcode() == Epiphany::BNONE16) {
       // If modification is not allowed
       if (!AllowModify) {
         TBB = I->getOperand(0).getMBB();
@@ -143,7 +175,7 @@ bool EpiphanyInstrInfo::analyzeBranch(MachineBasicBlock &MBB, MachineBasicBlock
     }
 
     // Handle conditional branches.
-    if (I->getOpcode() != Epiphany::BCC) {
+    if (I->getOpcode() != Epiphany::BCC && I->getOpcode() != Epiphany::BCC16) {
       continue;
     }
     auto BranchCode = static_cast<EpiphanyCC::CondCodes>(I->getOperand(1).getImm());
@@ -180,14 +212,14 @@ bool EpiphanyInstrInfo::analyzeBranch(MachineBasicBlock &MBB, MachineBasicBlock
 // removeBranch - helper function for branch analysis
 // Used with IfConversion pass
 unsigned EpiphanyInstrInfo::removeBranch(MachineBasicBlock &MBB, int *BytesRemoved) const {
-  assert(!BytesRemoved && "code size not handled");
-
   // Branches to handle
   DEBUG(dbgs()<< "\n<----------------->";);
   DEBUG(dbgs() << "\nRemoving branches out of BB#" << MBB.getNumber() << "\n");
-  unsigned uncond[] = {Epiphany::BNONE32, Epiphany::BL32, Epiphany::BCC};
+  unsigned uncond[] = {Epiphany::BNONE32, Epiphany::BCC, Epiphany::BNONE16, Epiphany::BCC16,
+    Epiphany::LOOPEND};
   MachineBasicBlock::iterator I = MBB.end();
   unsigned Count = 0;
+  int Removed = 0;
 
   while (I != MBB.begin()) {
     --I;
@@ -200,11 +232,15 @@ unsigned EpiphanyInstrInfo::removeBranch(MachineBasicBlock &MBB, int *BytesRemov
       break;
     }
     // Remove the branch.
+    Removed += getInstSizeInBytes(*I);
     I->eraseFromParent();
     I = MBB.end();
     ++Count;
   }
 
+  if (BytesRemoved) {
+    *BytesRemoved = Removed;
+  }
   DEBUG(MBB.getParent()->dump(););
   return Count;
 }
@@ -217,40 +253,55 @@ unsigned EpiphanyInstrInfo::insertBranch(MachineBasicBlock &MBB,
 
   // Shouldn't be a fall through.
   assert(TBB && "InsertBranch must not be told to insert a fallthrough");
-  assert((Cond.size() == 1 || Cond.size() == 0) &&
+  assert((Cond.size() <= 1 || Cond[0].getImm() == EpiphanyCC::COND_LOOP) &&
       "Branch conditions have one component!");
-  assert(!BytesAdded && "code size not handled");
-
+  // Long forms are inserted, the branch selector shrinks them before emission
   if (Cond.empty()) {
     // Unconditional branch?
     assert(!FBB && "Unconditional branch with multiple successors!");
-    BuildMI(&MBB, DL, get(Epiphany::BNONE32)).addMBB(TBB);
+    MachineInstr *MI = BuildMI(&MBB, DL, get(Epiphany::BNONE32)).addMBB(TBB);
+    if (BytesAdded) {
+      *BytesAdded = getInstSizeInBytes(*MI);
+    }
     return 1;
   }
 
   // Conditional branch.
   unsigned Count = 0;
-  BuildMI(&MBB, DL, get(Epiphany::BCC)).addMBB(TBB).addImm(Cond[0].getImm());
+  int Added = 0;
+  MachineInstr *MI;
+  if (Cond[0].getImm() == EpiphanyCC::COND_LOOP) {
+    MI = BuildMI(&MBB, DL, get(Epiphany::LOOPEND)).addMBB(TBB)
+      .addSym(Cond[1].getMCSymbol()).addSym(Cond[2].getMCSymbol());
+  } else {
+    MI = BuildMI(&MBB, DL, get(Epiphany::BCC)).addMBB(TBB).addImm(Cond[0].getImm());
+  }
+  Added += getInstSizeInBytes(*MI);
   ++Count;
 
   if (FBB) {
     // Two-way Conditional branch. Insert the second branch.
-    BuildMI(&MBB, DL, get(Epiphany::BNONE32)).addMBB(FBB);
+    MI = BuildMI(&MBB, DL, get(Epiphany::BNONE32)).addMBB(FBB);
+    Added += getInstSizeInBytes(*MI);
     ++Count;
   }
+  if (BytesAdded) {
+    *BytesAdded = Added;
+  }
   DEBUG(MBB.getParent()->dump(););
   return Count;
 }
 
 bool EpiphanyInstrInfo::reverseBranchCondition(SmallVectorImpl<MachineOperand> &Cond) const {
-  assert(Cond.size() == 1 && "More than 1 condition");
   auto CC = static_cast<EpiphanyCC::CondCodes>(Cond[0].getImm());
+  assert((Cond.size() == 1 || CC == EpiphanyCC::COND_LOOP) && "More than 1 condition");
   switch(CC) {
     default:
       llvm_unreachable("Wrong branch condition code!");
       break;
     case EpiphanyCC::COND_BLT:
     case EpiphanyCC::COND_BLTE:
+    case EpiphanyCC::COND_LOOP:
       // can't be reversed
       return true;
       break;
@@ -300,6 +351,300 @@ bool EpiphanyInstrInfo::reverseBranchCondition(SmallVectorImpl<MachineOperand> &
   return false;
 }
 
+bool EpiphanyInstrInfo::isBranchOffsetInRange(unsigned BranchOpc, int64_t BrOffset) const {
+  switch (BranchOpc) {
+    default:
+      llvm_unreachable("Unexpected branch opcode");
+    // Displacement is in halfwords
+    case Epiphany::BNONE16:
+    case Epiphany::BCC16:
+      return isInt<9>(BrOffset);
+    case Epiphany::BNONE32:
+    case Epiphany::BCC:
+      return isInt<25>(BrOffset);
+    // Loop start is kept in LS, it is reachable from anywhere
+    case Epiphany::LOOPEND:
+      return true;
+  }
+}
+
+MachineBasicBlock *EpiphanyInstrInfo::getBranchDestBlock(const MachineInstr &MI) const {
+  switch (MI.getOpcode()) {
+    default:
+      llvm_unreachable("Unexpected branch opcode");
+    case Epiphany::BNONE16:
+    case Epiphany::BCC16:
+    case Epiphany::BNONE32:
+    case Epiphany::BCC:
+    case Epiphany::LOOPEND:
+      return MI.getOperand(0).getMBB();
+  }
+}
+
+//-------------------------------------------------------------------
+// Software pipelining
+//-------------------------------------------------------------------
+
+/// \brief Find the LC setup of the hardware loop, searching up from the MBB
+/// predecessors (the pipeliner prologs are placed between the preheader and
+/// the loop)
+static MachineInstr *findLoopCountSetup(MachineBasicBlock *MBB) {
+  SmallPtrSet<MachineBasicBlock *, 8> Visited;
+  while (MBB->pred_size() == 1) {
+    MBB = *MBB->pred_begin();
+    if (!Visited.insert(MBB).second) {
+      return nullptr;
+    }
+    for (auto I = MBB->rbegin(), E = MBB->rend(); I != E; ++I) {
+      // Another hardware loop, the setup is not there
+      if (I->getOpcode() == Epiphany::LOOPEND) {
+        return nullptr;
+      }
+      if (I->getOpcode() == Epiphany::MOVTS32_core && I->getOperand(0).getReg() == Epiphany::LC) {
+        return &*I;
+      }
+    }
+  }
+  return nullptr;
+}
+
+/// Analyze the loop for the software pipeliner. Only hardware loops are
+/// supported, so there is no induction variable to update and the loop end
+/// works as a compare.
+///
+/// \return false on success
+bool EpiphanyInstrInfo::analyzeLoop(MachineLoop &L, MachineInstr *&IndVarInst,
+    MachineInstr *&CmpInst) const {
+  MachineBasicBlock *LoopBB = L.getBottomBlock();
+  MachineBasicBlock::iterator I = LoopBB->getFirstTerminator();
+  if (I == LoopBB->end() || I->getOpcode() != Epiphany::LOOPEND || !findLoopCountSetup(LoopBB)) {
+    return true;
+  }
+  IndVarInst = nullptr;
+  CmpInst = &*I;
+  return false;
+}
+
+/// Peel one iteration off the hardware loop for the pipeliner prolog MBB.
+/// Called once for each prolog, starting from the last one, so the counter
+/// is decremented in a chain and LC is set right before the kernel.
+///
+/// \return Register with the number of iterations left
+unsigned EpiphanyInstrInfo::reduceLoopCount(MachineBasicBlock &MBB,
+    MachineInstr *IndVar, MachineInstr &Cmp, SmallVectorImpl<MachineOperand> &Cond,
+    SmallVectorImpl<MachineInstr *> &PrevInsts, unsigned Iter, unsigned MaxIter) const {
+  assert(!IndVar && Cmp.getOpcode() == Epiphany::LOOPEND && "Expecting a hardware loop");
+  MachineInstr *Setup = findLoopCountSetup(&MBB);
+  assert(Setup && "Hardware loop setup not found");
+  MachineRegisterInfo &MRI = MBB.getParent()->getRegInfo();
+  DebugLoc DL = Cmp.getDebugLoc();
+
+  unsigned LoopCount = Setup->getOperand(1).getReg();
+  Setup->getOperand(1).setIsKill(false);
+  unsigned NewLoopCount = MRI.createVirtualRegister(&Epiphany::GPR32RegClass);
+  MachineInstr *NewSub = BuildMI(&MBB, DL, get(Epiphany::SUBri_r32), NewLoopCount)
+    .addReg(LoopCount).addImm(1);
+
+  // Prologs after this one count from the decremented value
+  for (MachineInstr *MI : PrevInsts) {
+    MI->substituteRegister(LoopCount, NewLoopCount, 0, getRegisterInfo());
+  }
+  PrevInsts.clear();
+  PrevInsts.push_back(NewSub);
+
+  // Kernel counter is set in the last prolog, original one goes away with the first
+  if (Iter == MaxIter) {
+    BuildMI(&MBB, DL, get(Epiphany::MOVTS32_core), Epiphany::LC).addReg(NewLoopCount);
+  }
+  if (Iter == 0) {
+    Setup->eraseFromParent();
+  }
+
+  // Go to the epilog if nothing is left for the kernel, flags are set by the sub
+  Cond.push_back(MachineOperand::CreateImm(EpiphanyCC::COND_EQ));
+  return NewLoopCount;
+}
+
+/// Get the base register and byte offset of the displacement load/store
+bool EpiphanyInstrInfo::getMemOpBaseRegImmOfs(MachineInstr &LdSt, unsigned &BaseReg,
+    int64_t &Offset, const TargetRegisterInfo *TRI) const {
+  uint64_t TSFlags = LdSt.getDesc().TSFlags;
+  unsigned Unit = EpiphanyII::getUnit(TSFlags);
+  if ((Unit != EpiphanyII::UnitLoad && Unit != EpiphanyII::UnitStore) ||
+      EpiphanyII::getAddrMode(TSFlags) != EpiphanyII::AddrDisp) {
+    return false;
+  }
+  // Frame indexes are not resolved yet
+  if (!LdSt.getOperand(1).isReg() || !LdSt.getOperand(2).isImm()) {
+    return false;
+  }
+  BaseReg = LdSt.getOperand(1).getReg();
+  Offset = LdSt.getOperand(2).getImm();
+  return true;
+}
+
+/// Get the increment value if MI adds a constant to the register
+bool EpiphanyInstrInfo::getIncrementValue(const MachineInstr &MI, int &Value) const {
+  switch (MI.getOpcode()) {
+    default:
+      return false;
+    case Epiphany::ADDri_r16:
+    case Epiphany::ADDri_r32:
+    case Epiphany::SUBri_r16:
+    case Epiphany::SUBri_r32:
+      break;
+  }
+  if (!MI.getOperand(2).isImm()) {
+    return false;
+  }
+  Value = MI.getOperand(2).getImm();
+  if (MI.getOpcode() == Epiphany::SUBri_r16 || MI.getOpcode() == Epiphany::SUBri_r32) {
+    Value = -Value;
+  }
+  return true;
+}
+
+/// Get the base operand, byte offset and size of the displacement load/store,
+/// base can be a register or a frame index
+static bool getMemOpBaseOfsWidth(const MachineInstr &MI, const MachineOperand *&Base,
+    int64_t &Offset, unsigned &Width) {
+  uint64_t TSFlags = MI.getDesc().TSFlags;
+  unsigned Unit = EpiphanyII::getUnit(TSFlags);
+  if ((Unit != EpiphanyII::UnitLoad && Unit != EpiphanyII::UnitStore) ||
+      EpiphanyII::getAddrMode(TSFlags) != EpiphanyII::AddrDisp) {
+    return false;
+  }
+  Base = &MI.getOperand(1);
+  if ((!Base->isReg() && !Base->isFI()) || !MI.getOperand(2).isImm()) {
+    return false;
+  }
+  Offset = MI.getOperand(2).getImm();
+  Width = EpiphanyII::getMemSize(TSFlags);
+  return true;
+}
+
+/// Frame objects don't overlap, except for the fixed ones, which are created
+/// at given offsets and are only distinct if their ranges are
+static bool areDistinctFrameObjects(int FIa, int FIb, const MachineFrameInfo &MFI) {
+  if (FIa == FIb) {
+    return false;
+  }
+  if (!MFI.isFixedObjectIndex(FIa) || !MFI.isFixedObjectIndex(FIb)) {
+    return true;
+  }
+  int64_t OffsetA = MFI.getObjectOffset(FIa);
+  int64_t OffsetB = MFI.getObjectOffset(FIb);
+  return OffsetA + MFI.getObjectSize(FIa) <= OffsetB || OffsetB + MFI.getObjectSize(FIb) <= OffsetA;
+}
+
+/// Returns true if the object the access goes to is known and differs
+/// from the one of the other access
+static bool accessDistinctObjects(const MachineMemOperand &MMOa, const MachineMemOperand &MMOb,
+    const MachineFunction &MF) {
+  const MachineFrameInfo &MFI = MF.getFrameInfo();
+  const PseudoSourceValue *PSVa = MMOa.getPseudoValue();
+  const PseudoSourceValue *PSVb = MMOb.getPseudoValue();
+
+  // Different frame objects
+  if (PSVa && PSVb) {
+    const auto *FSa = dyn_cast<FixedStackPseudoSourceValue>(PSVa);
+    const auto *FSb = dyn_cast<FixedStackPseudoSourceValue>(PSVb);
+    return FSa && FSb && areDistinctFrameObjects(FSa->getFrameIndex(), FSb->getFrameIndex(), MFI);
+  }
+
+  const Value *Va = MMOa.getValue();
+  const Value *Vb = MMOb.getValue();
+  const DataLayout &DL = MF.getDataLayout();
+  // Frame never contains globals
+  if (PSVa || PSVb) {
+    const PseudoSourceValue *PSV = PSVa ? PSVa : PSVb;
+    const Value *V = PSVa ? Vb : Va;
+    return V && (PSV->isStack() || PSV->kind() == PseudoSourceValue::FixedStack) &&
+           isa<GlobalObject>(GetUnderlyingObject(V, DL));
+  }
+
+  // Different globals, allocas or noalias arguments
+  if (!Va || !Vb) {
+    return false;
+  }
+  const Value *Oa = GetUnderlyingObject(Va, DL);
+  const Value *Ob = GetUnderlyingObject(Vb, DL);
+  return Oa != Ob && isIdentifiedObject(Oa) && isIdentifiedObject(Ob);
+}
+
+/// Accesses are disjoint if they go to non-overlapping ranges from the same
+/// base or frame index, to different frame objects or to different globals.
+/// Used by the schedulers and the load/store optimizer, as AA is not always
+/// available and doesn't know the frame.
+bool EpiphanyInstrInfo::areMemAccessesTriviallyDisjoint(MachineInstr &MIa, MachineInstr &MIb,
+    AliasAnalysis *AA) const {
+  if (MIa.hasUnmodeledSideEffects() || MIb.hasUnmodeledSideEffects() ||
+      MIa.hasOrderedMemoryRef() || MIb.hasOrderedMemoryRef()) {
+    return false;
+  }
+
+  // Same base, if the register changes in between there is a dependency
+  // through the instruction changing it anyway
+  const MachineOperand *BaseA, *BaseB;
+  int64_t OffsetA, OffsetB;
+  unsigned WidthA, WidthB;
+  if (getMemOpBaseOfsWidth(MIa, BaseA, OffsetA, WidthA) &&
+      getMemOpBaseOfsWidth(MIb, BaseB, OffsetB, WidthB)) {
+    const MachineFrameInfo &MFI = MIa.getParent()->getParent()->getFrameInfo();
+    if (BaseA->isFI() && BaseB->isFI() &&
+        areDistinctFrameObjects(BaseA->getIndex(), BaseB->getIndex(), MFI)) {
+      return true;
+    }
+    if (BaseA->isIdenticalTo(*BaseB)) {
+      int64_t LowOffset = std::min(OffsetA, OffsetB);
+      int64_t HighOffset = std::max(OffsetA, OffsetB);
+      unsigned LowWidth = OffsetA < OffsetB ? WidthA : WidthB;
+      return LowOffset + LowWidth <= HighOffset;
+    }
+  }
+
+  if (!MIa.hasOneMemOperand() || !MIb.hasOneMemOperand()) {
+    return false;
+  }
+  return accessDistinctObjects(**MIa.memoperands_begin(), **MIb.memoperands_begin(),
+                               *MIa.getParent()->getParent());
+}
+
+//-------------------------------------------------------------------
+// Scheduling
+//-------------------------------------------------------------------
+
+/// FP results come one stage earlier in truncate mode
+static bool hasEarlyFPResult(const EpiphanySubtarget &STI, const MachineInstr &MI) {
+  return STI.hasTruncateFP() && EpiphanyII::getUnit(MI.getDesc().TSFlags) == EpiphanyII::UnitFPU;
+}
+
+/// Operand latency from the itineraries, adjusted for the FPU rounding mode
+int EpiphanyInstrInfo::getOperandLatency(const InstrItineraryData *ItinData,
+    const MachineInstr &DefMI, unsigned DefIdx, const MachineInstr &UseMI,
+    unsigned UseIdx) const {
+  int Latency = TargetInstrInfo::getOperandLatency(ItinData, DefMI, DefIdx, UseMI, UseIdx);
+  if (Latency > 1 && hasEarlyFPResult(Subtarget, DefMI)) {
+    --Latency;
+  }
+  return Latency;
+}
+
+ScheduleHazardRecognizer *EpiphanyInstrInfo::CreateTargetHazardRecognizer(
+    const TargetSubtargetInfo *STI, const ScheduleDAG *DAG) const {
+  return new EpiphanyHazardRecognizer(STI->getInstrItineraryData(), DAG, false, "pre-RA-sched");
+}
+
+ScheduleHazardRecognizer *EpiphanyInstrInfo::CreateTargetMIHazardRecognizer(
+    const InstrItineraryData *II, const ScheduleDAG *DAG) const {
+  return new EpiphanyHazardRecognizer(II, DAG, false, "machine-scheduler");
+}
+
+ScheduleHazardRecognizer *EpiphanyInstrInfo::CreateTargetPostRAHazardRecognizer(
+    const InstrItineraryData *II, const ScheduleDAG *DAG) const {
+  return new EpiphanyHazardRecognizer(II, DAG, true, "post-RA-sched");
+}
+
 //-------------------------------------------------------------------
 // Misc
 //-------------------------------------------------------------------
@@ -332,9 +677,7 @@ bool EpiphanyInstrInfo::isSchedulingBoundary(const MachineInstr &MI,
   }
 
   // Don't mess around with no return calls.
-  unsigned uncond[] = {Epiphany::BNONE32, Epiphany::JR16, Epiphany::JR32};
-  bool isNoReturn = std::find(std::begin(uncond), std::end(uncond), MI.getOpcode()) != std::end(uncond);
-  if (isNoReturn)
+  if (MI.getDesc().isUnconditionalBranch() || MI.getDesc().isIndirectBranch())
     return true;
 
   // Terminators and labels can't be scheduled around.
@@ -346,6 +689,64 @@ bool EpiphanyInstrInfo::isSchedulingBoundary(const MachineInstr &MI,
 }
 
 
+//-------------------------------------------------------------------
+// Outlining
+//-------------------------------------------------------------------
+bool EpiphanyInstrInfo::isLegalToOutline(const MachineInstr &MI) const {
+  // Control flow, labels and everything not being a real instruction. Debug
+  // values are skipped by the outliner, so they don't split the sequences
+  if (MI.isTerminator() || MI.isCall() || MI.isReturn() || MI.isBranch() ||
+      MI.isPosition() || MI.isDebugValue() || MI.isInlineAsm() ||
+      MI.isKill() || MI.isImplicitDef() || MI.getDesc().isPseudo()) {
+    return false;
+  }
+
+  // Prologue and epilogue should stay in place for the unwinder
+  if (MI.getFlag(MachineInstr::FrameSetup) || MI.getFlag(MachineInstr::FrameDestroy)) {
+    return false;
+  }
+
+  // GID/GIE, MOVTS and friends
+  if (MI.hasUnmodeledSideEffects() || MI.isNotDuplicable()) {
+    return false;
+  }
+
+  // The outlined sequence is entered with BL, so it can't touch LR
+  if (MI.readsRegister(Epiphany::LR, &RI) || MI.modifiesRegister(Epiphany::LR, &RI)) {
+    return false;
+  }
+
+  // Block and jump table references are not meaningful out of place
+  for (const MachineOperand &MO : MI.operands()) {
+    if (MO.isMBB() || MO.isJTI() || MO.isBlockAddress()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int EpiphanyInstrInfo::getOutliningBenefit(unsigned SequenceSize,
+    unsigned Occurrences) const {
+  // Each occurrence becomes a 32-bit BL, the sequence itself is emitted once
+  // and ends with a 32-bit JR LR
+  const unsigned CallSize = get(Epiphany::BL32).getSize();
+  const unsigned FrameSize = get(Epiphany::JR32).getSize();
+  return (int)(Occurrences * SequenceSize) -
+         (int)(Occurrences * CallSize + SequenceSize + FrameSize);
+}
+
+void EpiphanyInstrInfo::buildOutlinedFrame(MachineBasicBlock &MBB,
+    const DebugLoc &DL) const {
+  BuildMI(MBB, MBB.end(), DL, get(Epiphany::JR32)).addReg(Epiphany::LR);
+}
+
+MachineBasicBlock::iterator EpiphanyInstrInfo::insertOutlinedCall(
+    MachineBasicBlock &MBB, MachineBasicBlock::iterator It, MCSymbol *Sym) const {
+  DebugLoc DL = It != MBB.end() ? It->getDebugLoc() : DebugLoc();
+  return BuildMI(MBB, It, DL, get(Epiphany::BL32)).addSym(Sym);
+}
+
 //-------------------------------------------------------------------
 // Load/Store
 //-------------------------------------------------------------------
@@ -380,32 +781,12 @@ bool EpiphanyInstrInfo::isCandidateToMergeOrPair(MachineInstr &MI) const {
 /// any side effects other than loading from the stack slot.
 unsigned EpiphanyInstrInfo::isLoadFromStackSlot(const MachineInstr &MI,
     int &FrameIndex) const {
-  // Load instructions
-  unsigned inst[] = {
-    Epiphany::LDRi16_r16,
-    Epiphany::LDRi16_r32,
-    Epiphany::LDRi16_idx_add_r16,
-    Epiphany::LDRi16_idx_add_r32,
-    Epiphany::LDRi16_idx_sub_r32,
-    Epiphany::LDRi16_pm_add_r16,
-    Epiphany::LDRi16_pm_add_r32,
-    Epiphany::LDRi16_pm_sub_r32,
-    Epiphany::LDRi16_pmd_r32,
-    Epiphany::LDRi32_r16,
-    Epiphany::LDRi32_r32,
-    Epiphany::LDRi32_idx_add_r16,
-    Epiphany::LDRi32_idx_add_r32,
-    Epiphany::LDRi32_idx_sub_r32,
-    Epiphany::LDRi32_pm_add_r16,
-    Epiphany::LDRi32_pm_add_r32,
-    Epiphany::LDRi32_pm_sub_r32,
-    Epiphany::LDRi32_pmd_r32,
-    Epiphany::LDRi64,
-    Epiphany::LDRf64
-  };
+  uint64_t TSFlags = MI.getDesc().TSFlags;
   DEBUG(dbgs() << "\nisLoadToStackSlot for "; MI.print(dbgs()));
-  // Check if current opcode is one of those
-  bool found = (std::find(std::begin(inst), std::end(inst), MI.getOpcode()) != std::end(inst));
+  // Displacement load, byte loads can't reload a whole slot
+  bool found = EpiphanyII::getUnit(TSFlags) == EpiphanyII::UnitLoad
+    && EpiphanyII::getAddrMode(TSFlags) == EpiphanyII::AddrDisp
+    && EpiphanyII::getMemSize(TSFlags) > 1;
   // If true, check operands
   if (found) {
     if (MI.getOperand(1).isFI() && MI.getOperand(2).isImm() && MI.getOperand(2).getImm() == 0) {
@@ -424,37 +805,18 @@ unsigned EpiphanyInstrInfo::isLoadFromStackSlot(const MachineInstr &MI,
 /// any side effects other than storing to the stack slot.
 unsigned EpiphanyInstrInfo::isStoreToStackSlot(const MachineInstr &MI,
     int &FrameIndex) const {
-  unsigned inst[] = {
-    Epiphany::STRi16_r16,
-    Epiphany::STRi16_r32,
-    Epiphany::STRi16_idx_add_r16,
-    Epiphany::STRi16_idx_add_r32,
-    Epiphany::STRi16_idx_sub_r32,
-    Epiphany::STRi16_pm_add_r16,
-    Epiphany::STRi16_pm_add_r32,
-    Epiphany::STRi16_pm_sub_r32,
-    Epiphany::STRi16_pmd_r32,
-    Epiphany::STRi32_r16,
-    Epiphany::STRi32_r32,
-    Epiphany::STRi32_idx_add_r16,
-    Epiphany::STRi32_idx_add_r32,
-    Epiphany::STRi32_idx_sub_r32,
-    Epiphany::STRi32_pm_add_r16,
-    Epiphany::STRi32_pm_add_r32,
-    Epiphany::STRi32_pm_sub_r32,
-    Epiphany::STRi32_pmd_r32,
-    Epiphany::STRi64,
-    Epiphany::STRf64
-  };
+  uint64_t TSFlags = MI.getDesc().TSFlags;
   DEBUG(dbgs() << "\nisStoreToStackSlot for "; MI.print(dbgs()));
-  // Check if current opcode is one of those
-  bool found = (std::find(std::begin(inst), std::end(inst), MI.getOpcode()) != std::end(inst));
+  // Displacement store, byte stores can't spill a whole slot
+  bool found = EpiphanyII::getUnit(TSFlags) == EpiphanyII::UnitStore
+    && EpiphanyII::getAddrMode(TSFlags) == EpiphanyII::AddrDisp
+    && EpiphanyII::getMemSize(TSFlags) > 1;
   // If true, check operands
   if (found) {
-    if (MI.getOperand(0).isFI() && MI.getOperand(1).isImm() && MI.getOperand(1).getImm() == 0) {
-      FrameIndex = MI.getOperand(0).getIndex();
+    if (MI.getOperand(1).isFI() && MI.getOperand(2).isImm() && MI.getOperand(2).getImm() == 0) {
+      FrameIndex = MI.getOperand(1).getIndex();
       DEBUG(dbgs() << "\nFound store op for "; MI.print(dbgs()));
-      return MI.getOperand(2).getReg();
+      return MI.getOperand(0).getReg();
     }
   }
   return 0;
@@ -700,10 +1062,77 @@ void EpiphanyInstrInfo::expandRTS(MachineBasicBlock &MBB,
 // }
 
 // Return the number of bytes of code the specified instruction may be.
-unsigned EpiphanyInstrInfo::GetInstSizeInBytes(const MachineInstr &MI) const {
+unsigned EpiphanyInstrInfo::getInstSizeInBytes(const MachineInstr &MI) const {
   switch (MI.getOpcode()) {
     default:
       return MI.getDesc().getSize();
+    case TargetOpcode::INLINEASM: {
+      const MachineFunction *MF = MI.getParent()->getParent();
+      const char *AsmStr = MI.getOperand(0).getSymbolName();
+      return getInlineAsmLength(AsmStr, *MF->getTarget().getMCAsmInfo());
+    }
+  }
+}
+
+// Return the 32-bit form of a 16-bit instruction, 0 if there's none.
+// Inverse of the EpiphanySizeReduction table, both forms take the same
+// operands, so only the descriptor has to be changed.
+unsigned EpiphanyInstrInfo::getWideOpcode(unsigned Opc) const {
+  switch (Opc) {
+    default:
+      return 0;
+    case Epiphany::ADDrr_r16:                  return Epiphany::ADDrr_r32;
+    case Epiphany::ADDCrr_r16:                 return Epiphany::ADDCrr_r32;
+    case Epiphany::SUBrr_r16:                  return Epiphany::SUBrr_r32;
+    case Epiphany::SUBCrr_r16:                 return Epiphany::SUBCrr_r32;
+    case Epiphany::CMPrr_r16:                  return Epiphany::CMPrr_r32;
+    case Epiphany::ANDrr_r16:                  return Epiphany::ANDrr_r32;
+    case Epiphany::ORRrr_r16:                  return Epiphany::ORRrr_r32;
+    case Epiphany::EORrr_r16:                  return Epiphany::EORrr_r32;
+    case Epiphany::ASRrr_r16:                  return Epiphany::ASRrr_r32;
+    case Epiphany::LSRrr_r16:                  return Epiphany::LSRrr_r32;
+    case Epiphany::LSLrr_r16:                  return Epiphany::LSLrr_r32;
+    case Epiphany::ADDri_r16:                  return Epiphany::ADDri_r32;
+    case Epiphany::ADDCri_r16:                 return Epiphany::ADDCri_r32;
+    case Epiphany::SUBri_r16:                  return Epiphany::SUBri_r32;
+    case Epiphany::SUBCri_r16:                 return Epiphany::SUBCri_r32;
+    case Epiphany::CMPri_r16:                  return Epiphany::CMPri_r32;
+    case Epiphany::FADDrr_r16:                 return Epiphany::FADDrr_r32;
+    case Epiphany::FSUBrr_r16:                 return Epiphany::FSUBrr_r32;
+    case Epiphany::FCMPrr_r16:                 return Epiphany::FCMPrr_r32;
+    case Epiphany::FMULrr_r16:                 return Epiphany::FMULrr_r32;
+    case Epiphany::FMADDrr_r16:                return Epiphany::FMADDrr_r32;
+    case Epiphany::FMSUBrr_r16:                return Epiphany::FMSUBrr_r32;
+    case Epiphany::IADDrr_r16:                 return Epiphany::IADDrr_r32;
+    case Epiphany::ISUBrr_r16:                 return Epiphany::ISUBrr_r32;
+    case Epiphany::IMULrr_r16:                 return Epiphany::IMULrr_r32;
+    case Epiphany::IMADDrr_r16:                return Epiphany::IMADDrr_r32;
+    case Epiphany::IMSUBrr_r16:                return Epiphany::IMSUBrr_r32;
+    case Epiphany::LDRi8_r16:                  return Epiphany::LDRi8_r32;
+    case Epiphany::LDRi16_r16:                 return Epiphany::LDRi16_r32;
+    case Epiphany::LDRi32_r16:                 return Epiphany::LDRi32_r32;
+    case Epiphany::STRi8_r16:                  return Epiphany::STRi8_r32;
+    case Epiphany::STRi16_r16:                 return Epiphany::STRi16_r32;
+    case Epiphany::STRi32_r16:                 return Epiphany::STRi32_r32;
+    case Epiphany::LDRi8_idx_add_r16:          return Epiphany::LDRi8_idx_add_r32;
+    case Epiphany::LDRi16_idx_add_r16:         return Epiphany::LDRi16_idx_add_r32;
+    case Epiphany::LDRi32_idx_add_r16:         return Epiphany::LDRi32_idx_add_r32;
+    case Epiphany::STRi8_idx_add_r16:          return Epiphany::STRi8_idx_add_r32;
+    case Epiphany::STRi16_idx_add_r16:         return Epiphany::STRi16_idx_add_r32;
+    case Epiphany::STRi32_idx_add_r16:         return Epiphany::STRi32_idx_add_r32;
+    case Epiphany::LDRi8_pm_add_r16:           return Epiphany::LDRi8_pm_add_r32;
+    case Epiphany::LDRi16_pm_add_r16:          return Epiphany::LDRi16_pm_add_r32;
+    case Epiphany::LDRi32_pm_add_r16:          return Epiphany::LDRi32_pm_add_r32;
+    case Epiphany::STRi8_pm_add_r16:           return Epiphany::STRi8_pm_add_r32;
+    case Epiphany::STRi16_pm_add_r16:          return Epiphany::STRi16_pm_add_r32;
+    case Epiphany::STRi32_pm_add_r16:          return Epiphany::STRi32_pm_add_r32;
+    case Epiphany::LSR16ri:                    return Epiphany::LSR32ri;
+    case Epiphany::LSL16ri:                    return Epiphany::LSL32ri;
+    case Epiphany::ASR16ri:                    return Epiphany::ASR32ri;
+    case Epiphany::BITR16ri:                   return Epiphany::BITR32ri;
+    case Epiphany::MOVi16ri:                   return Epiphany::MOVi32ri;
+    case Epiphany::MOVi16rr:                   return Epiphany::MOVi32rr;
+    case Epiphany::MOVCC16:                    return Epiphany::MOVCC;
   }
 }
 // }
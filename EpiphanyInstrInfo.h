@@ -18,6 +18,7 @@
 
 #include "Epiphany.h"
 #include "EpiphanyRegisterInfo.h"
+#include "MCTargetDesc/EpiphanyBaseInfo.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/Target/TargetInstrInfo.h"
 
@@ -43,10 +44,15 @@ namespace llvm {
     const EpiphanyRegisterInfo &getRegisterInfo() const;
 
     /// Return the number of bytes of code the specified instruction may be.
-    unsigned GetInstSizeInBytes(const MachineInstr &MI) const;
+    unsigned getInstSizeInBytes(const MachineInstr &MI) const override;
+    /// Return the 32-bit form of a 16-bit instruction, 0 if there's none.
+    unsigned getWideOpcode(unsigned Opc) const;
 
     bool expandPostRAPseudo(MachineInstr &MI) const override;
 
+    /// Create the DFA used by the dual-issue packetizer
+    DFAPacketizer *CreateTargetScheduleState(const TargetSubtargetInfo &STI) const override;
+
     void adjustStackPtr(unsigned SP, int64_t Amount, MachineBasicBlock &MBB,
         MachineBasicBlock::iterator I) const;
 
@@ -117,6 +123,55 @@ namespace llvm {
         const DebugLoc &DL, int *BytesAdded = nullptr) const override;
     bool reverseBranchCondition(SmallVectorImpl<MachineOperand> &Cond) const override;
 
+    /// Branch displacement limits, used by the branch selector
+    bool isBranchOffsetInRange(unsigned BranchOpc, int64_t BrOffset) const override;
+    MachineBasicBlock *getBranchDestBlock(const MachineInstr &MI) const override;
+
+    //==---
+    // Software pipelining.
+    //==---
+    bool analyzeLoop(MachineLoop &L, MachineInstr *&IndVarInst,
+        MachineInstr *&CmpInst) const override;
+    unsigned reduceLoopCount(MachineBasicBlock &MBB, MachineInstr *IndVar,
+        MachineInstr &Cmp, SmallVectorImpl<MachineOperand> &Cond,
+        SmallVectorImpl<MachineInstr *> &PrevInsts, unsigned Iter,
+        unsigned MaxIter) const override;
+    bool getMemOpBaseRegImmOfs(MachineInstr &LdSt, unsigned &BaseReg,
+        int64_t &Offset, const TargetRegisterInfo *TRI) const override;
+    bool getIncrementValue(const MachineInstr &MI, int &Value) const override;
+    bool areMemAccessesTriviallyDisjoint(MachineInstr &MIa, MachineInstr &MIb,
+        AliasAnalysis *AA = nullptr) const override;
+
+    //==---
+    // Scheduling.
+    //==---
+    using TargetInstrInfo::getOperandLatency;
+    int getOperandLatency(const InstrItineraryData *ItinData,
+        const MachineInstr &DefMI, unsigned DefIdx,
+        const MachineInstr &UseMI, unsigned UseIdx) const override;
+    ScheduleHazardRecognizer *CreateTargetHazardRecognizer(
+        const TargetSubtargetInfo *STI, const ScheduleDAG *DAG) const override;
+    ScheduleHazardRecognizer *CreateTargetMIHazardRecognizer(
+        const InstrItineraryData *II, const ScheduleDAG *DAG) const override;
+    ScheduleHazardRecognizer *CreateTargetPostRAHazardRecognizer(
+        const InstrItineraryData *II, const ScheduleDAG *DAG) const override;
+
+    //==---
+    // Outlining, see EpiphanyOutliner.cpp
+    // LLVM 4.0 has no generic machine outliner, so these are not overrides.
+    //==---
+    /// Returns true if MI can be moved into an outlined sequence. Liveness of
+    /// LR is checked by the outliner itself.
+    bool isLegalToOutline(const MachineInstr &MI) const;
+    /// Bytes saved by outlining a sequence of SequenceSize bytes found at
+    /// Occurrences places, negative if outlining makes the code bigger.
+    int getOutliningBenefit(unsigned SequenceSize, unsigned Occurrences) const;
+    /// Finishes the outlined sequence with the return.
+    void buildOutlinedFrame(MachineBasicBlock &MBB, const DebugLoc &DL) const;
+    /// Inserts the call of the outlined sequence starting at Sym before It.
+    MachineBasicBlock::iterator insertOutlinedCall(MachineBasicBlock &MBB,
+        MachineBasicBlock::iterator It, MCSymbol *Sym) const;
+
     // Misc
     void insertNoop(MachineBasicBlock &MBB, MachineBasicBlock::iterator MI) const override;
     /// Test if the given instruction should be considered a scheduling boundary.
@@ -6,25 +6,41 @@
 // License. See LICENSE.TXT for details.
 //
 //===----------------------------------------------------------------------===//
-/// 
+///
 /// \file
-/// This file contains a pass that performs load / store related peephole
-/// optimizations. This pass should be run after register allocation.
-/// 
+/// This file contains a pass that merges pairs of 32-bit loads/stores to
+/// adjacent words into 64-bit ones. It runs twice, before register allocation
+/// (on SSA) and after it.
+///
 /// Flow:
-/// * Split MachineFunction (MF) into MachineBasicBlocks (MBB)
-/// * For each MBB look through instructions trying to find the next pairable one (see isPairableLoadStoreInst)
-/// * If found pairable instruction, check if it has any flags preventing pairing
-/// * If no such flags found, try to find matching paired instruction
-///   * Take a couple of next instructions, find instruction with the same opcode, and run a couple of checks
-///   * Check alignment, reg base, check if reg is not modified
-///   * For real regs, try to find super-reg
-///   * For real regs, check order
-///   * For reg-based (not frame-based) offsets check base alignment (frame SHOULD be 8-byte aligned)
-/// * If all green, try to pair regs
-///   * For virtual regs, create reg sequence. If frame-based - merge based on stack growth direction and move
-///     frame object into fixed local stack area
-///   * For virtual regs, just swap with the super-reg
+/// * Walk each extended basic block (a block and the tree of single-predecessor
+///   blocks below it) top-down, after RA each block is walked separately
+/// * Keep an index of unpaired accesses keyed by the paired opcode, base
+///   (register, frame index or single-word frame object) and offset, plus
+///   the last def/use position of each register and the list of memory
+///   accesses since the last call or side effect
+/// * For each pairable access look up the index for an access to the word
+///   right before or after it, and check if one of them can be moved to the
+///   other one:
+///   * Registers are not redefined (or for loads, used) in between
+///   * Nothing in between may alias the moved access
+///     (EpiphanyInstrInfo::areMemAccessesTriviallyDisjoint, then AA on the
+///     memory operands)
+///   * The pair is dword aligned
+///   * After RA, registers form an even/odd pair
+///   * Across blocks only loads are moved, up into the dominating block
+/// * Merge:
+///   * Before RA, create REG_SEQUENCE/COPY for the virtual regs. Two
+///     single-word frame objects are merged into one dword object
+///   * After RA, just use the super-reg
+/// * Before RA, adjacent accesses that could not be merged get their value
+///   registers hinted into an even/odd pair, to be merged after RA
+/// * After RA, fold a later increment of the base into the access with zero
+///   offset, making it a post-modify one:
+///     ldr r0, [r2]
+///     add r2, r2, #4
+///     ; becomes
+///     ldr r0, [r2], #1
 ///
 //===----------------------------------------------------------------------===//
 
@@ -35,31 +51,17 @@ using namespace llvm;
 #define DEBUG_TYPE "epiphany_ls_opt"
 
 STATISTIC(NumPairCreated, "Number of load/store pair instructions generated");
+STATISTIC(NumCrossBlockPairs, "Number of load pairs formed across basic blocks");
+STATISTIC(NumFrameSlotsMerged, "Number of frame objects merged into dword ones");
+STATISTIC(NumRegPairHints, "Number of register pairs hinted for the allocator");
+STATISTIC(NumPostIndexMerged, "Number of base updates folded into post-modify accesses");
 
-// The LdStLimit limits how far we search for load/store pairs.
-static cl::opt<unsigned> LdStLimit("epiphany-load-store-scan-limit", cl::init(20), cl::Hidden);
-
+// Same as in AArch64LoadStoreOptimizer
+static cl::opt<unsigned> UpdateLimit("epiphany-ls-update-limit", cl::init(100), cl::Hidden,
+    cl::desc("Maximum number of instructions searched for a base register update"));
 
 char EpiphanyLoadStoreOptimizer::ID = 0;
 
-/// \brief Returns true if this instruction should be considered for pairing
-///
-/// \param MI Machine instruction to check
-///
-/// \return true if this instruction should be considered for pairing
-static bool isPairableLoadStoreInst(MachineInstr &MI) {
-  unsigned inst[] = {
-      Epiphany::STRi32_r16,
-      Epiphany::STRi32_r32,
-      Epiphany::STRf32,
-      Epiphany::LDRi32_r16,
-      Epiphany::LDRi32_r32,
-      Epiphany::LDRf32
-  };
-  unsigned Opc = MI.getOpcode();
-  return std::find(std::begin(inst), std::end(inst), Opc) != std::end(inst);
-}
-
 static unsigned int getMemScale(unsigned Opc) {
   switch (Opc) {
     default:
@@ -89,44 +91,19 @@ static unsigned int getMemScale(unsigned Opc) {
   }
 }
 
-static unsigned int getMemScale(MachineInstr &MI) {
+static unsigned int getMemScale(const MachineInstr &MI) {
   return getMemScale(MI.getOpcode());
 }
 
-/// Returns correct instruction alignment. For Epiphany it is equal to memory scale
-static unsigned int getAlignment(MachineInstr &MI) {
-  return getMemScale(MI);
-}
-
-static unsigned int getAlignment(unsigned Opc) {
-  return getMemScale(Opc);
-}
-
-/// Return paired opcode for the provided one, e.g. STRi64_r32 for STRi32_r32
+/// Return paired opcode for the provided one, e.g. STRi64 for STRi32_r32
 static unsigned getMatchingPairOpcode(unsigned Opc) {
   switch (Opc) {
     default:
       llvm_unreachable("Opcode has no pairwise equivalent");
       break;
-    case Epiphany::STRi8_r16:
-      return Epiphany::STRi16_r16;
-    case Epiphany::STRi8_r32:
-      return Epiphany::STRi16_r32;
-    case Epiphany::STRi16_r16:
-      return Epiphany::STRi32_r16;
-    case Epiphany::STRi16_r32:
-      return Epiphany::STRi32_r32;
     case Epiphany::STRi32_r16:
     case Epiphany::STRi32_r32:
       return Epiphany::STRi64;
-    case Epiphany::LDRi8_r16:
-      return Epiphany::LDRi16_r16;
-    case Epiphany::LDRi8_r32:
-      return Epiphany::LDRi16_r32;
-    case Epiphany::LDRi16_r16:
-      return Epiphany::LDRi32_r16;
-    case Epiphany::LDRi16_r32:
-      return Epiphany::LDRi32_r32;
     case Epiphany::LDRi32_r16:
     case Epiphany::LDRi32_r32:
       return Epiphany::LDRi64;
@@ -137,11 +114,38 @@ static unsigned getMatchingPairOpcode(unsigned Opc) {
   }
 }
 
-/// Convert the byte-offset used by unscaled into an "element" offset used
-/// by the scaled pair load/store instructions.
-static bool inBoundsForPair(int64_t Offset) {
-  // Well, in fact if the op is in bounds for any kind of store/load - it will be in bound for pairing
-  return true;
+/// Post-modify by displacement form of the access, 0 if there is none
+static unsigned getPostIndexedOpcode(unsigned Opc) {
+  switch (Opc) {
+    default:
+      return 0;
+    case Epiphany::LDRi8_r16:
+    case Epiphany::LDRi8_r32:
+      return Epiphany::LDRi8_pmd_r32;
+    case Epiphany::LDRi16_r16:
+    case Epiphany::LDRi16_r32:
+      return Epiphany::LDRi16_pmd_r32;
+    case Epiphany::LDRi32_r16:
+    case Epiphany::LDRi32_r32:
+    case Epiphany::LDRf32:
+      return Epiphany::LDRi32_pmd_r32;
+    case Epiphany::LDRi64:
+    case Epiphany::LDRf64:
+      return Epiphany::LDRi64_pmd;
+    case Epiphany::STRi8_r16:
+    case Epiphany::STRi8_r32:
+      return Epiphany::STRi8_pmd_r32;
+    case Epiphany::STRi16_r16:
+    case Epiphany::STRi16_r32:
+      return Epiphany::STRi16_pmd_r32;
+    case Epiphany::STRi32_r16:
+    case Epiphany::STRi32_r32:
+    case Epiphany::STRf32:
+      return Epiphany::STRi32_pmd_r32;
+    case Epiphany::STRi64:
+    case Epiphany::STRf64:
+      return Epiphany::STRi64_pmd;
+  }
 }
 
 /// Get register for the store/load machine operand
@@ -159,566 +163,739 @@ static const MachineOperand &getOffsetOperand(const MachineInstr &MI) {
   return MI.getOperand(2);
 }
 
-/// Returns true if we need to use offset, false if frame index should be used
-static bool baseIsFrameIndex(const MachineInstr &FirstMI, const MachineInstr &SecondMI) {
-  return getBaseOperand(FirstMI).isFI() && getBaseOperand(SecondMI).isFI();
-}
-
-/// Returns true if FirstMI and MI are candidates for merging or pairing.
-/// Otherwise, returns false.
-static bool areCandidatesToMergeOrPair(MachineInstr &FirstMI, MachineInstr &SecondMI, LoadStoreFlags &Flags) {
-  // If this is volatile not a candidate.
-  if (SecondMI.hasOrderedMemoryRef())
+/// \brief Compute the index key of the pairable load/store
+///
+/// \return false if the access can't be indexed
+bool EpiphanyLoadStoreOptimizer::getAccessKey(const MachineInstr &MI, AccessKey &Key) const {
+  const MachineOperand &Base = getBaseOperand(MI);
+  const MachineOperand &Offset = getOffsetOperand(MI);
+  if (!Offset.isImm()) {
     return false;
+  }
 
-  // We should have already checked FirstMI for pair suppression and volatility.
-  assert(!FirstMI.hasOrderedMemoryRef() &&
-         "FirstMI shouldn't get here if either of these checks are true.");
-
-  unsigned OpcA = FirstMI.getOpcode();
-  unsigned OpcB = SecondMI.getOpcode();
+  unsigned PairedOp = getMatchingPairOpcode(MI.getOpcode());
+  if (Base.isReg()) {
+    Key = std::make_pair(std::make_pair(PairedOp, (unsigned)BASE_REG),
+                         std::make_pair((int64_t)Base.getReg(), Offset.getImm()));
+    return true;
+  }
 
-  // Opcodes match: nothing more to check.
-  if (OpcA != OpcB) {
+  // Objects placed by the local stack allocation already have their offsets
+  int FI = Base.getIndex();
+  if (!Base.isFI() || MFI->isObjectPreAllocated(FI)) {
     return false;
   }
 
+  // Single-word objects can be merged with each other
+  if (!MFI->isFixedObjectIndex(FI) && !UnmergeableFrameIdxs.test(FI) &&
+      MFI->getObjectSize(FI) == getMemScale(MI) && Offset.getImm() == 0) {
+    Key = std::make_pair(std::make_pair(PairedOp, (unsigned)BASE_FI_SLOT),
+                         std::make_pair((int64_t)0, (int64_t)FI));
+    return true;
+  }
+
+  Key = std::make_pair(std::make_pair(PairedOp, (unsigned)BASE_FI),
+                       std::make_pair((int64_t)FI, Offset.getImm()));
   return true;
 }
 
-/// trackRegDefsUses - Remember what registers the specified instruction uses
-/// and modifies.
-static void trackRegDefsUses(const MachineInstr &MI, BitVector &ModifiedRegs,
-                             BitVector &UsedRegs, const TargetRegisterInfo *TRI) {
+/// Remember the position the instruction defines and uses registers at
+void EpiphanyLoadStoreOptimizer::trackRegDefsUses(const MachineInstr &MI, ScanState &State) const {
   for (const MachineOperand &MO : MI.operands()) {
-    if (MO.isRegMask())
-      ModifiedRegs.setBitsNotInMask(MO.getRegMask());
-
-    if (!MO.isReg())
+    if (!MO.isReg() || !MO.getReg()) {
       continue;
+    }
     unsigned Reg = MO.getReg();
-    if (!Reg)
+    DenseMap<unsigned, unsigned> &Last = MO.isDef() ? State.LastDef : State.LastUse;
+    if (TRI->isVirtualRegister(Reg)) {
+      Last[Reg] = State.Pos;
       continue;
-    if (MO.isDef()) {
-      // WZR/XZR are not modified even when used as a destination register.
-      if (!TRI->isVirtualRegister(Reg)) {
-        for (MCRegAliasIterator AI(Reg, TRI, /* includeSelf = */ true); AI.isValid(); ++AI) {
-          ModifiedRegs.set(*AI);
-        }
-      } else {
-        ModifiedRegs.set(TRI->virtReg2Index(Reg));
-      }
-    } else {
-      assert(MO.isUse() && "Reg operand not a def and not a use?!?");
-      if (!TRI->isVirtualRegister(Reg)) {
-        for (MCRegAliasIterator AI(Reg, TRI, /* includeSelf = */ true); AI.isValid(); ++AI) {
-          UsedRegs.set(*AI);
-        }
-      } else {
-        UsedRegs.set(TRI->virtReg2Index(Reg));
-      }
+    }
+    for (MCRegAliasIterator AI(Reg, TRI, /* includeSelf = */ true); AI.isValid(); ++AI) {
+      Last[*AI] = State.Pos;
     }
   }
 }
 
-/// Keeps track on which frame indexes were used between two candidates to merge
-static void trackFrameIdxs(const MachineInstr &MI, BitVector &ModifiedFrameIdxs, BitVector &UsedFrameIdxs) {
-  for (const MachineOperand &MO : MI.operands()) {
-    if (MO.isFI()) {
-      if (MI.mayStore()) {
-        ModifiedFrameIdxs.set(MO.getIndex());
-      } else {
-        UsedFrameIdxs.set(MO.getIndex());
-      }
-    }
+/// \brief Returns true if the register is not defined (and not used if
+/// \p CheckUses is set) after the given position
+bool EpiphanyLoadStoreOptimizer::isRegFree(unsigned Reg, unsigned From, bool CheckUses,
+                                           const ScanState &State) const {
+  if (State.LastDef.lookup(Reg) > From) {
+    return false;
   }
+  return !CheckUses || State.LastUse.lookup(Reg) <= From;
 }
 
-/// \brief Returns true if the alignment for specified regs and their offsets is good for pairing.
-/// Only applicable when the frame is finalized
-///
-/// \param FirstMI First instruction to check
-/// \param SecondMI Second instruction to check
+/// \brief Returns true if the two accesses may touch the same memory
 ///
-/// \return true if alignment is ok for pairing
-bool EpiphanyLoadStoreOptimizer::isAlignmentCorrect(MachineInstr &FirstMI, MachineInstr &SecondMI) {
-  // Resolve target reg class
-  unsigned MainReg = getRegOperand(FirstMI).getReg();
-  unsigned PairedReg = getRegOperand(SecondMI).getReg();
-  int64_t MainOffset = getOffsetOperand(FirstMI).getImm() ;
-  int64_t PairedOffset = getOffsetOperand(SecondMI).getImm();
-
-  // Check that base alignment matches paired opcode alignment
-  int PairedAlignment = getAlignment(getMatchingPairOpcode(FirstMI.getOpcode()));
-  if (getBaseOperand(FirstMI).getReg() != Epiphany::FP) {
-    // Only applicable when we are dealing with non-FP-based offset, as frame is 8-byte aligned
-    MachineInstr::mmo_iterator FirstMMOI = FirstMI.memoperands_begin();
-    MachineMemOperand FirstMO = **FirstMMOI;
-    MachineInstr::mmo_iterator SecondMMOI = SecondMI.memoperands_begin();
-    MachineMemOperand SecondMO = **SecondMMOI;
-    if (FirstMO.getBaseAlignment() != PairedAlignment && SecondMO.getBaseAlignment() != PairedAlignment) {
-      DEBUG(dbgs() << "Base alignment out, skipping\n");
-      return false;
-    }
-
-    // Check if at least one instruction is aligned to the paired opcode alignment
-    if ((MainOffset % PairedAlignment != 0) && (PairedOffset % PairedAlignment) != 0) {
-      DEBUG(dbgs() << "Offsets alignment out, skipping\n");
-      return false;
-    }
+/// Frame objects, distinct globals and disjoint offsets from the same base
+/// are sorted out by the target hook, the rest is asked from AA on the
+/// memory operands the same way the scheduler does
+bool EpiphanyLoadStoreOptimizer::mayAlias(MachineInstr &MIa, MachineInstr &MIb) const {
+  if (TII->areMemAccessesTriviallyDisjoint(MIa, MIb, AA)) {
+    return false;
+  }
+  if (MIa.hasUnmodeledSideEffects() || MIb.hasUnmodeledSideEffects() ||
+      MIa.hasOrderedMemoryRef() || MIb.hasOrderedMemoryRef()) {
+    return true;
+  }
+  if (!AA || !MIa.hasOneMemOperand() || !MIb.hasOneMemOperand()) {
+    return true;
   }
 
-  // If regs are already defined - check alignment based on regs order
-  if (!TRI->isVirtualRegister(MainReg)) {
-    // Machine reg checks
-    // Offset stride -1 for FI as stack grows down
-    const TargetRegisterClass *RC = TRI->getMinimalPhysRegClass(MainReg) == &Epiphany::GPR32RegClass ?
-                                    &Epiphany::GPR64RegClass : &Epiphany::FPR64RegClass;
-
-    // Determine which offset should be higher
-    unsigned sra = TRI->getMatchingSuperReg(MainReg, Epiphany::isub_lo, RC);
-    unsigned srb = TRI->getMatchingSuperReg(PairedReg, Epiphany::isub_hi, RC);
-    int64_t HighOffset = PairedOffset;
-    int64_t LowOffset = MainOffset;
-    if ((!sra || !srb) || (sra != srb)) {
-      sra = TRI->getMatchingSuperReg(PairedReg, Epiphany::isub_lo, RC);
-      srb = TRI->getMatchingSuperReg(MainReg, Epiphany::isub_hi, RC);
-      HighOffset = MainOffset;
-      LowOffset = PairedOffset;
-    }
+  const MachineMemOperand *MMOa = *MIa.memoperands_begin();
+  const MachineMemOperand *MMOb = *MIb.memoperands_begin();
+  if (!MMOa->getValue() || !MMOb->getValue()) {
+    return true;
+  }
+  // Both locations start at the lower offset, so they cover the overlap
+  int64_t MinOffset = std::min(MMOa->getOffset(), MMOb->getOffset());
+  int64_t OverlapA = MMOa->getSize() + MMOa->getOffset() - MinOffset;
+  int64_t OverlapB = MMOb->getSize() + MMOb->getOffset() - MinOffset;
+  return AA->alias(MemoryLocation(MMOa->getValue(), OverlapA),
+                   MemoryLocation(MMOb->getValue(), OverlapB)) != NoAlias;
+}
 
-    // Can't form super reg
-    if (!(sra && srb) || (sra != srb)) {
-      return false;
+/// \brief Returns true if the access can't be moved across the memory
+/// accesses made after the given position
+bool EpiphanyLoadStoreOptimizer::hasMemConflict(MachineInstr &MI, unsigned From,
+                                                const ScanState &State) const {
+  for (auto It = State.MemInsns.rbegin(), E = State.MemInsns.rend(); It != E && It->Pos > From; ++It) {
+    MachineInstr &Other = *It->MI;
+    if (!MI.mayStore() && !Other.mayStore()) {
+      continue;
     }
-
-    // Low reg offset should be always lower than high reg offset, and it should be aligned to the paired opcode align
-    if (LowOffset >= HighOffset || (LowOffset % getAlignment(getMatchingPairOpcode(FirstMI.getOpcode())) != 0)) {
-      return false;
+    if (mayAlias(MI, Other)) {
+      DEBUG(dbgs() << "Conflicts with "; Other.print(dbgs()));
+      return true;
     }
   }
-  return true;
-}
-
-/// \brief Returns true if specified regs can form a super reg.
-/// Only applicable for real machine registers, not vregs
-///
-/// \param MainReg First reg to check for pairing
-/// \param PairedReg Second reg to check for pairing
-///
-/// \return true if regs can be paired
-bool EpiphanyLoadStoreOptimizer::canFormSuperReg(unsigned MainReg, unsigned PairedReg) {
-  // Resolve target reg class
-  const TargetRegisterClass *RC = TRI->getMinimalPhysRegClass(MainReg) == &Epiphany::GPR32RegClass ?
-                                  &Epiphany::GPR64RegClass : &Epiphany::FPR64RegClass;
-
-  unsigned sra = TRI->getMatchingSuperReg(MainReg, Epiphany::isub_lo, RC);
-  unsigned srb = TRI->getMatchingSuperReg(PairedReg, Epiphany::isub_hi, RC);
-  if ((!sra || !srb) || (sra != srb)) {
-    sra = TRI->getMatchingSuperReg(PairedReg, Epiphany::isub_lo, RC);
-    srb = TRI->getMatchingSuperReg(MainReg, Epiphany::isub_hi, RC);
-  }
-  return !(!(sra && srb) || (sra != srb));
+  return false;
 }
 
-/// Checks if two load/store instructions have similar base, and their 
-/// offsets differ by some fixed stride
-static bool isBaseAndOffsetCorrect(unsigned MainBase, unsigned PairBase, int64_t MainOffset,
-                                   int64_t PairOffset, int OffsetStride) {
-  return (MainBase == PairBase &&
-          ((MainOffset == PairOffset + OffsetStride) || (MainOffset + OffsetStride == PairOffset)));
+/// \brief Returns true if specified regs form the low and high halves of a
+/// super reg. Only applicable for real machine registers, not vregs
+bool EpiphanyLoadStoreOptimizer::canFormSuperReg(unsigned LoReg, unsigned HiReg) const {
+  unsigned DReg = TRI->getMatchingSuperReg(LoReg, Epiphany::isub_lo, &Epiphany::GPR64RegClass);
+  return DReg && DReg == TRI->getMatchingSuperReg(HiReg, Epiphany::isub_hi, &Epiphany::GPR64RegClass);
 }
 
-/// Cleans register kill flags before merge
-///
-/// Can have two cases based on \p MergeForward value:
-/// If merging backward
-/// \code
-///   STRi32 %r0, ...
-///   USE %r1
-///   STRi32 kill %r1  ; need to clear kill flag when moving STRi32 upwards
-/// \endcode
+/// \brief Returns true if the pair starting at the given access is dword aligned
 ///
-/// If merging forward
-/// \code
-///   STRi32 %r1, ...
-///   USE kill %r1   ; need to clear kill flag when moving STRi32 downwards
-///   STRi32 %r0
-/// \endcode
-void EpiphanyLoadStoreOptimizer::cleanKillFlags(MachineOperand RegOp0, MachineOperand RegOp1,
-                                                MachineBasicBlock::iterator I, MachineBasicBlock::iterator Paired,
-                                                bool MergeForward) {
-  if (!MergeForward) {
-    // Clear kill flags on store if moving backward
-    RegOp0.setIsKill(false);
-    RegOp1.setIsKill(false);
-  } else {
-    // Clear kill flags on store if moving forward
-    unsigned Reg = getRegOperand(*I).getReg();
-    for (MachineInstr &MI : make_range(std::next(I), Paired))
-      MI.clearRegisterKills(Reg, TRI);
+/// \param Lo Access to the lower word
+/// \param LoKey Index key of the lower access
+bool EpiphanyLoadStoreOptimizer::isAlignmentCorrect(const MachineInstr &Lo, const AccessKey &LoKey) const {
+  int64_t Base = LoKey.second.first;
+  int64_t Offset = LoKey.second.second;
+  switch (LoKey.first.second) {
+    default:
+      llvm_unreachable("Unknown access base kind");
+    // Merged object is realigned
+    case BASE_FI_SLOT:
+      return true;
+    case BASE_FI:
+      if (Offset % 8 != 0) {
+        return false;
+      }
+      return !MFI->isFixedObjectIndex(Base) || MFI->getObjectAlignment(Base) >= 8;
+    case BASE_REG:
+      // Offset is in bytes, LDRD/STRD encode it in dwords, so it has to be a
+      // multiple of 8
+      if (Offset % 8 != 0) {
+        return false;
+      }
+      // Frame is dword aligned
+      if (Base == Epiphany::FP || Base == Epiphany::SP) {
+        return true;
+      }
+      if (!Lo.hasOneMemOperand()) {
+        return false;
+      }
+      return (*Lo.memoperands_begin())->getAlignment() >= 8;
   }
 }
 
-/// \brief Merge two real reg-based 32-bit load/store instructions into a single 64-bit one
-///
-/// \param PairedOp Wide store/load operation opcode
-/// \param OffsetImm Offset to use
-/// \param RegOp0 Reg operand from the first paired store/load
-/// \param RegOp1 Reg operand from the second paired store/load
-/// \param I Iterator pointing at the first paired store/load
-/// \param Paired Iterator pointing at the second paired store/load
-/// \param Flags Store/load flags
+/// \brief Check if the earlier access \p Prev and \p MI can be merged
 ///
-/// \return Builder result
-MachineInstrBuilder EpiphanyLoadStoreOptimizer::mergeRegInsns(unsigned PairedOp, int64_t OffsetImm,
-                                                              MachineOperand RegOp0, MachineOperand RegOp1,
-                                                              MachineBasicBlock::iterator I,
-                                                              MachineBasicBlock::iterator Paired,
-                                                              const LoadStoreFlags &Flags) {
-
-  MachineInstrBuilder MIB;
-  bool MergeForward = Flags.getMergeForward();
-  // Insert our new paired instruction after whichever of the paired
-  // instructions MergeForward indicates.
-  MachineBasicBlock::iterator InsertionPoint = MergeForward ? Paired : I;
-  unsigned PairedReg = RegOp0.getReg();
-  const MachineOperand &PairedBase = getBaseOperand(*Paired);
-  const MachineOperand &MainBase = getBaseOperand(*I);
-  const MachineOperand &BaseRegOp = MergeForward ? PairedBase : MainBase;
-  DebugLoc DL = I->getDebugLoc();
-
-  MachineBasicBlock *MBB = I->getParent();
-  if (PairedOp == Epiphany::STRi64 || PairedOp == Epiphany::LDRi64) {
-    const TargetRegisterClass *RC = &Epiphany::GPR64RegClass;
-    unsigned sreg = TRI->getMatchingSuperReg(PairedReg, Epiphany::isub_hi, RC);
-    if (!sreg) {
-      sreg = TRI->getMatchingSuperReg(PairedReg, Epiphany::isub_lo, RC);
-    }
-    MIB = BuildMI(*MBB, InsertionPoint, DL, TII->get(PairedOp))
-        .addReg(sreg)
-        .addOperand(BaseRegOp)
-        .addImm(OffsetImm)
-        .setMemRefs(I->mergeMemRefsWith(*Paired));
-  } else {
-    // Standard 32-bit reg
-    MIB = BuildMI(*MBB, InsertionPoint, DL, TII->get(PairedOp))
-        .addOperand(RegOp0)
-        .addOperand(BaseRegOp)
-        .addImm(OffsetImm)
-        .setMemRefs(I->mergeMemRefsWith(*Paired));
+/// \param MergeForward Set to true if the pair should replace MI, false if
+/// it should replace Prev
+bool EpiphanyLoadStoreOptimizer::canMerge(const MemAccess &Prev, MachineInstr &MI,
+                                          const AccessKey &PrevKey, const AccessKey &Key,
+                                          const ScanState &State, bool &MergeForward) const {
+  MachineInstr &PrevMI = *Prev.MI;
+  DEBUG(dbgs() << "Checking instruction "; PrevMI.print(dbgs()));
+  const MachineOperand &PrevRegOp = getRegOperand(PrevMI);
+  const MachineOperand &RegOp = getRegOperand(MI);
+  bool IsLoad = MI.mayLoad();
+
+  // Both halves of the load pair can't go into the same register
+  if (IsLoad && PrevRegOp.getReg() == RegOp.getReg()) {
+    DEBUG(dbgs() << "Can't merge into same reg\n");
+    return false;
   }
 
-  DEBUG(dbgs() << "\t");
-  DEBUG(((MachineInstr *) MIB)->print(dbgs()));
-  return MIB;
-}
+  // Lower address goes into the low half, merged frame objects keep the
+  // first one at the start
+  bool PrevIsLo = Key.first.second == BASE_FI_SLOT || PrevKey.second.second < Key.second.second;
+  const MachineInstr &Lo = PrevIsLo ? PrevMI : MI;
+  const MachineOperand &LoRegOp = PrevIsLo ? PrevRegOp : RegOp;
+  const MachineOperand &HiRegOp = PrevIsLo ? RegOp : PrevRegOp;
+  if (PreRA) {
+    // Subreg defs only appear after the two-address pass
+    if (!TRI->isVirtualRegister(LoRegOp.getReg()) || !TRI->isVirtualRegister(HiRegOp.getReg()) ||
+        (IsLoad && (LoRegOp.getSubReg() || HiRegOp.getSubReg()))) {
+      return false;
+    }
+  } else if (!canFormSuperReg(LoRegOp.getReg(), HiRegOp.getReg())) {
+    DEBUG(dbgs() << "Can't find matching superreg\n");
+    return false;
+  }
 
-/// Merges two n-bit load/store instructions into a single 2*n-bit one
-MachineBasicBlock::iterator
-EpiphanyLoadStoreOptimizer::mergePairedInsns(MachineBasicBlock::iterator I,
-                                             MachineBasicBlock::iterator Paired, const LoadStoreFlags &Flags) {
-  MachineBasicBlock::iterator NextI = I;
-  ++NextI;
-  // If NextI is the second of the two instructions to be merged, we need
-  // to skip one further. Either way we merge will invalidate the iterator,
-  // and we don't need to scan the new instruction, as it's a pairwise
-  // instruction, which we're not considering for further action anyway.
-  if (NextI == Paired)
-    ++NextI;
-
-  unsigned Opc = I->getOpcode();
-
-  bool MergeForward = Flags.getMergeForward();
-  // Also based on MergeForward is from where we copy the base register operand
-  // so we get the flags compatible with the input code.
-  const MachineOperand &BaseRegOp = MergeForward ? getBaseOperand(*Paired) : getBaseOperand(*I);
-  int64_t Offset = getOffsetOperand(*I).getImm();
-  int64_t PairedOffset = getOffsetOperand(*Paired).getImm();
-  // Offset stride is 1 frame index or 1 instruction memory size. Sign depends on stack growth direction
-  int OffsetStride = getMemScale(*I);
-  OffsetStride = StackGrowsDown ? OffsetStride : -OffsetStride;
-
-  // Which register is Rt and which is Rt2 depends on the offset order.
-  MachineInstr *RtMI, *Rt2MI;
-  if (Offset == PairedOffset + OffsetStride) {
-    RtMI = &*Paired;
-    Rt2MI = &*I;
-  } else {
-    RtMI = &*I;
-    Rt2MI = &*Paired;
+  if (!isAlignmentCorrect(Lo, PrevIsLo ? PrevKey : Key)) {
+    DEBUG(dbgs() << "Can't be paired due to alignment\n");
+    return false;
   }
-  int64_t OffsetImm = getOffsetOperand(*RtMI).getImm();
-  // Construct the new instruction.
-  DebugLoc DL = I->getDebugLoc();
-  MachineOperand RegOp0 = getRegOperand(*RtMI);
-  MachineOperand RegOp1 = getRegOperand(*Rt2MI);
 
-  // Kill flags may become invalid when moving stores for pairing.
-  if (RegOp0.isUse()) {
-    cleanKillFlags(RegOp0, RegOp1, I, Paired, MergeForward);
+  // Base register should hold the same value at both points
+  if (Key.first.second == BASE_REG && !isRegFree(Key.second.first, Prev.Pos, false, State)) {
+    DEBUG(dbgs() << "Base register is modified\n");
+    return false;
   }
 
-  DEBUG(dbgs() << "Creating pair load/store. Replacing instructions:\n\t");
-  DEBUG(I->print(dbgs()));
-  DEBUG(dbgs() << "\t");
-  DEBUG(Paired->print(dbgs()));
-  DEBUG(dbgs() << "  with instruction:\n");
-  unsigned PairedOp = getMatchingPairOpcode(Opc);
-  unsigned PairedReg = RegOp0.getReg();
-  mergeRegInsns(PairedOp, OffsetImm, RegOp0, RegOp1, I, Paired, Flags);
-  DEBUG(dbgs() << "\n");
+  // Move the second access up to the first one. Stored value should be
+  // ready, loaded one should not be used or overwritten in between
+  if (isRegFree(RegOp.getReg(), Prev.Pos, IsLoad, State) && !hasMemConflict(MI, Prev.Pos, State)) {
+    // Across blocks only loads are moved, into the block dominating the
+    // original one. Other half of the aligned dword is as accessible as the
+    // first one, so the load can be executed on the other paths as well
+    if (Prev.Pos < State.BlockStart && !IsLoad) {
+      return false;
+    }
+    MergeForward = false;
+    return true;
+  }
+  if (Prev.Pos < State.BlockStart) {
+    return false;
+  }
 
-  // Erase the old instructions.
-  I->eraseFromParent();
-  Paired->eraseFromParent();
+  // Move the first access down to the second one
+  if (isRegFree(PrevRegOp.getReg(), Prev.Pos, IsLoad, State) && !hasMemConflict(PrevMI, Prev.Pos, State)) {
+    MergeForward = true;
+    return true;
+  }
 
-  return NextI;
+  DEBUG(dbgs() << "Registers or memory are modified in between\n");
+  return false;
 }
 
-/// Scan the instructions looking for a load/store that can be combined with the
-/// current instruction into a wider equivalent or a load/store pair.
-MachineBasicBlock::iterator
-EpiphanyLoadStoreOptimizer::findMatchingInst(MachineBasicBlock::iterator I,
-                                             LoadStoreFlags &Flags, unsigned Limit) {
-  MachineBasicBlock::iterator E = I->getParent()->end();
-  MachineBasicBlock::iterator MBBI = I;
-  MachineInstr &FirstMI = *I;
-  ++MBBI;
-
-  bool MayLoad = FirstMI.mayLoad();
-  // Get first instruction reg data
-  unsigned Reg = getRegOperand(FirstMI).getReg();
-  unsigned RegIdx = Reg;
-  unsigned BaseReg = getBaseOperand(FirstMI).isReg() ? getBaseOperand(FirstMI).getReg() : Epiphany::FP;
-  unsigned BaseRegIdx = BaseReg;
-
-  // Track which registers have been modified and used between the first insn
-  // (inclusive) and the second insn.
-  ModifiedRegs.reset();
-  UsedRegs.reset();
-
-  // Remember any instructions that read/write memory between FirstMI and MI.
-  SmallVector<MachineInstr *, 4> MemInsns;
-
-  for (unsigned Count = 0; MBBI != E && Count < Limit; ++MBBI) {
-    MachineInstr &MI = *MBBI;
-    // Don't count transient instructions towards the search limit since there
-    // may be different numbers of them if e.g. debug information is present.
-    if (!MI.isTransient())
-      ++Count;
-
-    if (areCandidatesToMergeOrPair(FirstMI, MI, Flags) &&
-        getOffsetOperand(MI).isImm()) {
-      assert(MI.mayLoadOrStore() && "Expected memory operation.");
-      // Get second instruction reg data
-      unsigned MIReg = getRegOperand(MI).getReg();
-      unsigned MIRegIdx = MIReg;
-      unsigned MIBaseReg = getBaseOperand(MI).isReg() ? getBaseOperand(MI).getReg() : Epiphany::FP;
-      // Get offsets
-      int64_t Offset = getOffsetOperand(FirstMI).getImm();
-      int64_t MIOffset = getOffsetOperand(MI).getImm();
-
-      // If we've found another instruction with the same opcode, check to see
-      // if regs, base and offset are compatible with our starting instruction.
-      // These instructions all have scaled immediate operands, so we just
-      // check for +1/-1. Make sure to check the new instruction offset is
-      // actually an immediate and not a symbolic reference destined for
-      // a relocation.
-      int OffsetStride = getMemScale(FirstMI);
-      if (isBaseAndOffsetCorrect(BaseReg, MIBaseReg, Offset, MIOffset, OffsetStride)) {
-        DEBUG(dbgs() << "Checking instruction "; MI.dump());
-
-        // First, check register parity
-        if (!canFormSuperReg(Reg, MIReg)) {
-          trackRegDefsUses(MI, ModifiedRegs, UsedRegs, TRI);
-          MemInsns.push_back(&MI);
-          DEBUG(dbgs() << "Can't find matching superreg\n");
+/// Redirect all accesses to the frame object into another one, placed at
+/// the given offset in it. Memory operands are rebuilt as well, so alias
+/// queries and the stack slot coloring don't see the removed object
+void EpiphanyLoadStoreOptimizer::remapFrameSlot(int FromFI, int ToFI, int64_t Offset) {
+  for (MachineBasicBlock &MBB : *MF) {
+    for (MachineInstr &MI : MBB) {
+      bool Changed = false;
+      for (unsigned i = 0, e = MI.getNumOperands(); i != e; ++i) {
+        MachineOperand &MO = MI.getOperand(i);
+        if (!MO.isFI() || MO.getIndex() != FromFI) {
           continue;
         }
+        DEBUG(dbgs() << "Changing instruction\n\t"; MI.print(dbgs()));
+        MO.setIndex(ToFI);
+        MachineOperand &OffsetOp = MI.getOperand(i + 1);
+        OffsetOp.setImm(OffsetOp.getImm() + Offset);
+        Changed = true;
+      }
 
-        // Check if the alignment is correct
-        if (!isAlignmentCorrect(FirstMI, MI)) {
-          trackRegDefsUses(MI, ModifiedRegs, UsedRegs, TRI);
-          MemInsns.push_back(&MI);
-          DEBUG(dbgs() << "Can't be paired due to alignment\n");
-          continue;
+      SmallVector<MachineMemOperand *, 2> MMOs;
+      for (MachineMemOperand *MMO : MI.memoperands()) {
+        const auto *FS = dyn_cast_or_null<FixedStackPseudoSourceValue>(MMO->getPseudoValue());
+        if (FS && FS->getFrameIndex() == FromFI) {
+          MMO = MF->getMachineMemOperand(
+              MachinePointerInfo::getFixedStack(*MF, ToFI, Offset + MMO->getOffset()),
+              MMO->getFlags(), MMO->getSize(), MFI->getObjectAlignment(ToFI), MMO->getAAInfo());
+          Changed = true;
         }
+        MMOs.push_back(MMO);
+      }
+      if (Changed) {
+        MachineInstr::mmo_iterator MemRefs = MF->allocateMemRefsArray(MMOs.size());
+        std::copy(MMOs.begin(), MMOs.end(), MemRefs);
+        MI.setMemRefs(MemRefs, MemRefs + MMOs.size());
+        DEBUG(dbgs() << "To\n\t"; MI.print(dbgs()));
+      }
+    }
+  }
+}
 
-        // Get the left-lowest offset
-        int64_t MinOffset = Offset < MIOffset ? Offset : MIOffset;
+/// Remove the instruction from its block. It is deleted only after the
+/// function is done, so stale pointers in the saved states can be detected
+void EpiphanyLoadStoreOptimizer::removeInstr(MachineInstr &MI) {
+  MI.removeFromParent();
+  Removed.insert(&MI);
+}
 
-        // If the resultant immediate offset of merging these
-        // instructions is out of range for
-        // a pairwise instruction, bail and keep looking.
-        if (!inBoundsForPair(MinOffset)) {
-          trackRegDefsUses(MI, ModifiedRegs, UsedRegs, TRI);
-          MemInsns.push_back(&MI);
-          DEBUG(dbgs() << "Out of bound for pairing\n");
-          continue;
-        }
-        // If the destination register of the loads is the same register, bail
-        // and keep looking. A load-pair instruction with both destination
-        // registers the same is UNPREDICTABLE and will result in an exception.
-        if (MayLoad && Reg == getRegOperand(MI).getReg()) {
-          trackRegDefsUses(MI, ModifiedRegs, UsedRegs, TRI);
-          MemInsns.push_back(&MI);
-          DEBUG(dbgs() << "Can't merge into same reg\n");
-          continue;
-        }
+/// \brief Hints the value registers of two adjacent accesses into an even/odd
+/// pair, so the accesses could be merged after RA
+///
+/// \param Lo Access to the lower word
+/// \param Hi Access to the higher word
+void EpiphanyLoadStoreOptimizer::hintRegPair(const MachineInstr &Lo, const MachineInstr &Hi) const {
+  unsigned LoReg = getRegOperand(Lo).getReg();
+  unsigned HiReg = getRegOperand(Hi).getReg();
+  if (!TRI->isVirtualRegister(LoReg) || !TRI->isVirtualRegister(HiReg) || LoReg == HiReg) {
+    return;
+  }
+  // Don't override other hints, pairs are only hinted once
+  std::pair<unsigned, unsigned> LoHint = MRI->getRegAllocationHint(LoReg);
+  std::pair<unsigned, unsigned> HiHint = MRI->getRegAllocationHint(HiReg);
+  if (LoHint.first || LoHint.second || HiHint.first || HiHint.second) {
+    return;
+  }
 
-        // If the Rt of the second instruction was not modified or used between
-        // the two instructions and none of the instructions between the second
-        // and first alias with the second, we can combine the second into the
-        // first.
-        if (!ModifiedRegs[MIRegIdx]) {
-          if (!(MI.mayLoad() && UsedRegs[MIRegIdx])) {
-            Flags.setMergeForward(false);
-            return MBBI;
-          }
-        } else {
-          DEBUG(dbgs() << "Proposed paired reg was modified, will try to merge forward\n");
-        }
+  DEBUG(dbgs() << "Hinting " << PrintReg(LoReg, TRI) << " and " << PrintReg(HiReg, TRI)
+        << " into a register pair\n");
+  MRI->setRegAllocationHint(LoReg, EpiphanyRI::RegPairEven, HiReg);
+  MRI->setRegAllocationHint(HiReg, EpiphanyRI::RegPairOdd, LoReg);
+  ++NumRegPairHints;
+}
 
-        // Likewise, if the Rt of the first instruction is not modified or used
-        // between the two instructions and none of the instructions between the
-        // first and the second alias with the first, we can combine the first
-        // into the second.
-        if (!ModifiedRegs[RegIdx] && !(MayLoad && UsedRegs[RegIdx])) {
-          Flags.setMergeForward(true);
-          return MBBI;
-        }
-        // Unable to combine these instructions due to interference in between.
-        // Keep looking.
-      }
-    }
+/// \brief Merges two 32-bit load/store instructions into a single 64-bit one
+///
+/// \param Prev Earlier access
+/// \param MI Later access
+/// \param PrevKey Index key of the earlier access
+/// \param Key Index key of the later access
+/// \param MergeForward Place the pair at MI if true, at Prev otherwise
+/// \param State Scan state to record the new instructions in
+///
+/// \return The paired instruction
+MachineInstr *EpiphanyLoadStoreOptimizer::mergePairedInsns(MachineInstr &Prev, MachineInstr &MI,
+                                                           const AccessKey &PrevKey, const AccessKey &Key,
+                                                           bool MergeForward, ScanState &State) {
+  MachineInstr &InsertMI = MergeForward ? MI : Prev;
+  MachineBasicBlock &MBB = *InsertMI.getParent();
+  MachineBasicBlock::iterator InsertPos = InsertMI.getIterator();
+  DebugLoc DL = InsertMI.getDebugLoc();
+
+  BaseKind Kind = (BaseKind)Key.first.second;
+  bool PrevIsLo = Kind == BASE_FI_SLOT || PrevKey.second.second < Key.second.second;
+  MachineInstr &Lo = PrevIsLo ? Prev : MI;
+  MachineInstr &Hi = PrevIsLo ? MI : Prev;
+  const MachineOperand &LoRegOp = getRegOperand(Lo);
+  const MachineOperand &HiRegOp = getRegOperand(Hi);
+  // Base operand is taken from the instruction being replaced, so its flags
+  // are correct at this point
+  MachineOperand BaseOp = Kind == BASE_FI_SLOT ? getBaseOperand(Prev) : getBaseOperand(InsertMI);
+  int64_t Offset = Kind == BASE_FI_SLOT ? 0 : getOffsetOperand(Lo).getImm();
+
+  unsigned PairedOp = Key.first.first;
+  const MCInstrDesc &PairedDesc = TII->get(PairedOp);
+  bool IsStore = PairedDesc.mayStore();
 
-    // If the instruction wasn't a matching load or store.  Stop searching if we
-    // encounter a call instruction that might modify memory.
-    if (MI.isCall())
-      return E;
+  DEBUG(dbgs() << "Creating pair load/store. Replacing instructions:\n\t");
+  DEBUG(Prev.print(dbgs()));
+  DEBUG(dbgs() << "\t");
+  DEBUG(MI.print(dbgs()));
+  DEBUG(dbgs() << "  with instructions:\n");
+
+  // Kill flags may become invalid when moving stores downwards
+  if (IsStore && MergeForward) {
+    unsigned Reg = getRegOperand(Prev).getReg();
+    for (MachineInstr &Between : make_range(std::next(Prev.getIterator()), MI.getIterator())) {
+      Between.clearRegisterKills(Reg, TRI);
+    }
+  }
 
-    // Update modified / uses register lists.
-    trackRegDefsUses(MI, ModifiedRegs, UsedRegs, TRI);
+  SmallVector<MachineInstr *, 4> NewInsns;
+  MachineInstr *PairMI;
+  if (PreRA) {
+    const TargetRegisterClass *RC = PairedOp == Epiphany::LDRf64 || PairedOp == Epiphany::STRf64 ?
+                                    &Epiphany::FPR64RegClass : &Epiphany::GPR64RegClass;
+    unsigned DReg = MRI->createVirtualRegister(RC);
+    if (IsStore) {
+      // In terms of store - create regsequence before storing
+      NewInsns.push_back(BuildMI(MBB, InsertPos, DL, TII->get(TargetOpcode::REG_SEQUENCE), DReg)
+          .addReg(LoRegOp.getReg(), 0, LoRegOp.getSubReg())
+          .addImm(Epiphany::isub_lo)
+          .addReg(HiRegOp.getReg(), 0, HiRegOp.getSubReg())
+          .addImm(Epiphany::isub_hi));
+      PairMI = BuildMI(MBB, InsertPos, DL, PairedDesc)
+          .addReg(DReg)
+          .addOperand(BaseOp)
+          .addImm(Offset)
+          .setMemRefs(Prev.mergeMemRefsWith(MI));
+      NewInsns.push_back(PairMI);
+    } else {
+      // In terms of load - issue two copy instruction for vregs we had
+      PairMI = BuildMI(MBB, InsertPos, DL, PairedDesc, DReg)
+          .addOperand(BaseOp)
+          .addImm(Offset)
+          .setMemRefs(Prev.mergeMemRefsWith(MI));
+      NewInsns.push_back(PairMI);
+      NewInsns.push_back(BuildMI(MBB, InsertPos, DL, TII->get(TargetOpcode::COPY), LoRegOp.getReg())
+          .addReg(DReg, 0, Epiphany::isub_lo));
+      NewInsns.push_back(BuildMI(MBB, InsertPos, DL, TII->get(TargetOpcode::COPY), HiRegOp.getReg())
+          .addReg(DReg, 0, Epiphany::isub_hi));
+    }
+  } else {
+    unsigned DReg = TRI->getMatchingSuperReg(LoRegOp.getReg(), Epiphany::isub_lo, &Epiphany::GPR64RegClass);
+    PairMI = BuildMI(MBB, InsertPos, DL, PairedDesc)
+        .addReg(DReg, getDefRegState(!IsStore))
+        .addOperand(BaseOp)
+        .addImm(Offset)
+        .setMemRefs(Prev.mergeMemRefsWith(MI));
+    NewInsns.push_back(PairMI);
+  }
 
-    // Otherwise, if the base register is modified, we have no match, so
-    // return early. Should only happen when dealing with real registers
-    if (ModifiedRegs[BaseRegIdx])
-      return E;
+  for (MachineInstr *NewMI : NewInsns) {
+    DEBUG(dbgs() << "\t"; NewMI->print(dbgs()));
+    // Conservatively at the current position
+    trackRegDefsUses(*NewMI, State);
+  }
+  DEBUG(dbgs() << "\n");
 
-    // Update list of instructions that read/write memory.
-    if (MI.mayLoadOrStore())
-      MemInsns.push_back(&MI);
+  removeInstr(Prev);
+  removeInstr(MI);
+
+  // Adjust alignment and size, and move all accesses to the second object
+  // into the first one
+  int FI = (int)Key.second.first;
+  if (Kind == BASE_FI_SLOT) {
+    int LoFI = getBaseOperand(Prev).getIndex();
+    int HiFI = getBaseOperand(MI).getIndex();
+    MFI->setObjectSize(LoFI, getMemScale(PairedOp));
+    MFI->setObjectAlignment(LoFI, std::max(MFI->getObjectAlignment(LoFI), getMemScale(PairedOp)));
+    remapFrameSlot(HiFI, LoFI, getMemScale(MI));
+    MFI->RemoveStackObject(HiFI);
+    // Pair covers the whole merged object
+    MachineInstr::mmo_iterator MemRefs = MF->allocateMemRefsArray(1);
+    MemRefs[0] = MF->getMachineMemOperand(MachinePointerInfo::getFixedStack(*MF, LoFI),
+        IsStore ? MachineMemOperand::MOStore : MachineMemOperand::MOLoad,
+        getMemScale(PairedOp), MFI->getObjectAlignment(LoFI));
+    PairMI->setMemRefs(MemRefs, MemRefs + 1);
+    ++NumFrameSlotsMerged;
+  } else if (Kind == BASE_FI && MFI->getObjectAlignment(FI) < getMemScale(PairedOp)) {
+    MFI->setObjectAlignment(FI, getMemScale(PairedOp));
   }
-  return E;
-}
 
-// Find loads and stores that can be merged into a single load or store pair
-// instruction.
-bool EpiphanyLoadStoreOptimizer::tryToPairLoadStoreInst(MachineBasicBlock::iterator &MBBI) {
-  MachineInstr &MI = *MBBI;
-  MachineBasicBlock::iterator E = MI.getParent()->end();
-  DEBUG(dbgs() << "\nTrying to pair instruction: ";
-            MI.print(dbgs()););
+  return PairMI;
+}
 
+/// \brief Find an earlier access to the adjacent word and merge with it
+///
+/// \return true if MI was merged
+bool EpiphanyLoadStoreOptimizer::tryToPairLoadStoreInst(MachineInstr &MI, ScanState &State) {
+  DEBUG(dbgs() << "\nTrying to pair instruction: "; MI.print(dbgs()));
   if (!TII->isCandidateToMergeOrPair(MI)) {
     DEBUG(dbgs() << "Not a candidate for merging\n");
     return false;
   }
 
-  // Early exit if the offset is not possible to match. (6 bits of positive
-  // range, plus allow an extra one in case we find a later insn that matches
-  // with Offset-1)
-  int64_t Offset = getOffsetOperand(MI).getImm();
-  int OffsetStride = 1;
-  // Allow one more for offset.
-  if (Offset > 0)
-    Offset -= OffsetStride;
-  if (!inBoundsForPair(Offset)) {
-    DEBUG(dbgs() << "Out of bounds for pairing\n");
+  AccessKey Key;
+  if (!getAccessKey(MI, Key)) {
     return false;
   }
 
-  // Look ahead up to LdStLimit instructions for a pairable instruction.
-  LoadStoreFlags Flags;
-  MachineBasicBlock::iterator Paired =
-      findMatchingInst(MBBI, Flags, LdStLimit);
-  if (Paired != E) {
+  int64_t Stride = Key.first.second == BASE_FI_SLOT ? 1 : getMemScale(MI);
+  for (int64_t Delta : { -Stride, Stride }) {
+    AccessKey PrevKey = Key;
+    PrevKey.second.second += Delta;
+    auto It = State.Index.find(PrevKey);
+    if (It == State.Index.end()) {
+      continue;
+    }
+
+    // Instruction could be removed or changed by an earlier merge
+    MemAccess Prev = It->second;
+    AccessKey CurKey;
+    if (Removed.count(Prev.MI) || !getAccessKey(*Prev.MI, CurKey) || CurKey != PrevKey) {
+      State.Index.erase(It);
+      continue;
+    }
+
+    bool MergeForward;
+    if (!canMerge(Prev, MI, PrevKey, Key, State, MergeForward)) {
+      // Separate frame objects have no fixed order yet
+      bool PrevIsLo = Delta < 0;
+      if (PreRA && Key.first.second != BASE_FI_SLOT &&
+          isAlignmentCorrect(PrevIsLo ? *Prev.MI : MI, PrevIsLo ? PrevKey : Key)) {
+        hintRegPair(PrevIsLo ? *Prev.MI : MI, PrevIsLo ? MI : *Prev.MI);
+      }
+      continue;
+    }
+
+    bool CrossBlock = Prev.Pos < State.BlockStart;
+    State.Index.erase(It);
+    MachineInstr *PairMI = mergePairedInsns(*Prev.MI, MI, PrevKey, Key, MergeForward, State);
+
+    // Pair takes the place of the first access in the history, or is added
+    // at the current position
+    auto MemIt = std::find_if(State.MemInsns.begin(), State.MemInsns.end(),
+                              [&](const MemAccess &A) { return A.MI == Prev.MI; });
+    assert(MemIt != State.MemInsns.end() && "Paired access is not in the history");
+    if (MergeForward) {
+      State.MemInsns.erase(MemIt);
+      State.MemInsns.push_back({ PairMI, State.Pos });
+    } else {
+      MemIt->MI = PairMI;
+    }
+
     ++NumPairCreated;
-    // Keeping the iterator straight is a pain, so we let the merge routine tell
-    // us what the next instruction is after it's done mucking about.
-    MBBI = mergePairedInsns(MBBI, Paired, Flags);
+    if (CrossBlock) {
+      ++NumCrossBlockPairs;
+    }
     return true;
-  } else {
-    DEBUG(dbgs() << "Unable to find matching instruction\n");
   }
+
+  State.Index[Key] = { &MI, State.Pos };
   return false;
 }
 
-/// \brief Runs optimizer for the given MBB.
+/// \brief Runs optimizer for the given MBB, continuing from the given state
 ///
 /// \param MBB Machine basic block to optimize
+/// \param State Scan state at the block entry, updated to the block exit
 ///
 /// \return true if the block was modified
-bool EpiphanyLoadStoreOptimizer::optimizeBlock(MachineBasicBlock &MBB) {
+bool EpiphanyLoadStoreOptimizer::optimizeBlock(MachineBasicBlock &MBB, ScanState &State) {
   bool Modified = false;
+  State.BlockStart = State.Pos + 1;
 
   // Find loads and stores that can be merged into a single load or store
   //    pair instruction.
   //      e.g.,
-  //        str r0,  [fp]
-  //        str r1,  [fp, #1]
+  //        str r0,  [r2]
+  //        str r1,  [r2, #1]
   //        ; becomes
-  //        strd r0, [fp]
-  for (MachineBasicBlock::iterator MBBI = MBB.begin(), E = MBB.end();
-       MBBI != E;) {
-    if (isPairableLoadStoreInst(*MBBI) && tryToPairLoadStoreInst(MBBI))
+  //        strd r0, [r2]
+  for (MachineBasicBlock::iterator MBBI = MBB.begin(), E = MBB.end(); MBBI != E;) {
+    MachineInstr &MI = *MBBI++;
+    if (MI.isDebugValue()) {
+      continue;
+    }
+    ++State.Pos;
+
+    // Nothing is moved across calls and instructions with unknown effects
+    if (MI.isCall() || MI.hasUnmodeledSideEffects() || MI.hasOrderedMemoryRef()) {
+      State.Index.clear();
+      State.MemInsns.clear();
+      trackRegDefsUses(MI, State);
+      continue;
+    }
+
+    if (EpiphanyII::isPairable(MI.getDesc().TSFlags) && tryToPairLoadStoreInst(MI, State)) {
       Modified = true;
-    else
+      continue;
+    }
+
+    trackRegDefsUses(MI, State);
+    if (MI.mayLoadOrStore()) {
+      State.MemInsns.push_back({ &MI, State.Pos });
+    }
+  }
+
+  return Modified;
+}
+
+/// \brief Returns the increment if MI adds an immediate to BaseReg in place
+/// and the flags it sets are not used
+static bool isBaseUpdate(const MachineInstr &MI, unsigned BaseReg, int64_t &Inc) {
+  switch (MI.getOpcode()) {
+    default:
+      return false;
+    case Epiphany::ADDri_r16:
+    case Epiphany::ADDri_r32:
+    case Epiphany::SUBri_r16:
+    case Epiphany::SUBri_r32:
+      break;
+  }
+  if (MI.getOperand(0).getReg() != BaseReg || !MI.getOperand(1).isReg() ||
+      MI.getOperand(1).getReg() != BaseReg || !MI.getOperand(2).isImm()) {
+    return false;
+  }
+  if (!MI.registerDefIsDead(Epiphany::STATUS)) {
+    return false;
+  }
+
+  Inc = MI.getOperand(2).getImm();
+  if (MI.getOpcode() == Epiphany::SUBri_r16 || MI.getOpcode() == Epiphany::SUBri_r32) {
+    Inc = -Inc;
+  }
+  return true;
+}
+
+/// \brief Folds base register increments following zero-offset accesses
+/// into post-modify accesses. Only runs after RA.
+///
+/// \return true if the block was modified
+bool EpiphanyLoadStoreOptimizer::mergeBaseUpdates(MachineBasicBlock &MBB) {
+  bool Modified = false;
+
+  for (MachineBasicBlock::iterator MBBI = MBB.begin(), E = MBB.end(); MBBI != E;) {
+    MachineInstr &MI = *MBBI++;
+    unsigned NewOpc = getPostIndexedOpcode(MI.getOpcode());
+    if (!NewOpc || !getBaseOperand(MI).isReg() || !getOffsetOperand(MI).isImm() ||
+        getOffsetOperand(MI).getImm() != 0 || MI.hasOrderedMemoryRef()) {
+      continue;
+    }
+    unsigned BaseReg = getBaseOperand(MI).getReg();
+    unsigned Reg = getRegOperand(MI).getReg();
+    // Value register is either loaded or stored after the update
+    if (TRI->regsOverlap(Reg, BaseReg)) {
+      continue;
+    }
+
+    // Look for the update, base should not be touched before it
+    MachineInstr *Update = nullptr;
+    int64_t Inc = 0;
+    unsigned Count = 0;
+    for (MachineBasicBlock::iterator I = MBBI; I != E && Count < UpdateLimit; ++I) {
+      MachineInstr &Next = *I;
+      if (Next.isDebugValue()) {
+        continue;
+      }
+      ++Count;
+      if (isBaseUpdate(Next, BaseReg, Inc)) {
+        Update = &Next;
+        break;
+      }
+      if (Next.isCall() || Next.readsRegister(BaseReg, TRI) || Next.modifiesRegister(BaseReg, TRI)) {
+        break;
+      }
+    }
+    if (!Update) {
+      continue;
+    }
+
+    // Sign and magnitude displacement in access size units
+    int64_t Scale = getMemScale(MI);
+    if (Inc == 0 || Inc % Scale != 0 || std::abs(Inc / Scale) > 0x7ff) {
+      continue;
+    }
+
+    DEBUG(dbgs() << "Folding base update:\n    "; Update->print(dbgs());
+          dbgs() << "  into:\n    "; MI.print(dbgs()));
+
+    MachineInstrBuilder MIB;
+    const MachineOperand &RegOp = getRegOperand(MI);
+    if (MI.mayLoad()) {
+      MIB = BuildMI(MBB, MI, MI.getDebugLoc(), TII->get(NewOpc))
+        .addReg(Reg, RegState::Define)
+        .addReg(BaseReg, RegState::Define)
+        .addReg(BaseReg)
+        .addImm(Inc);
+    } else {
+      MIB = BuildMI(MBB, MI, MI.getDebugLoc(), TII->get(NewOpc))
+        .addReg(BaseReg, RegState::Define)
+        .addReg(Reg, getKillRegState(RegOp.isKill()))
+        .addReg(BaseReg)
+        .addImm(Inc);
+    }
+    MIB.setMemRefs(MI.memoperands_begin(), MI.memoperands_end());
+
+    DEBUG(dbgs() << "  result:\n    "; MIB->print(dbgs()));
+
+    // The update may be the next instruction to look at
+    if (MBBI == MachineBasicBlock::iterator(Update)) {
       ++MBBI;
+    }
+    removeInstr(MI);
+    removeInstr(*Update);
+    ++NumPostIndexMerged;
+    Modified = true;
   }
 
   return Modified;
 }
 
+/// \brief Runs optimizer for the extended basic block starting at the given
+/// one. Each block continues with the state its predecessor ended with.
+bool EpiphanyLoadStoreOptimizer::optimizeExtendedBlock(MachineBasicBlock &Root) {
+  bool Modified = false;
+  SmallVector<std::pair<MachineBasicBlock *, ScanState>, 4> Worklist;
+  Worklist.push_back(std::make_pair(&Root, ScanState()));
+  while (!Worklist.empty()) {
+    MachineBasicBlock *MBB = Worklist.back().first;
+    ScanState State = std::move(Worklist.back().second);
+    Worklist.pop_back();
+
+    Modified |= optimizeBlock(*MBB, State);
+
+    SmallVector<MachineBasicBlock *, 2> Children;
+    for (MachineBasicBlock *Succ : MBB->successors()) {
+      if (Succ != MBB && Succ->pred_size() == 1 && !Succ->isEHPad()) {
+        Children.push_back(Succ);
+      }
+    }
+    // Last successor takes the state over, others get a copy
+    for (unsigned i = 0; i + 1 < Children.size(); ++i) {
+      Worklist.push_back(std::make_pair(Children[i], State));
+    }
+    if (!Children.empty()) {
+      Worklist.push_back(std::make_pair(Children.back(), std::move(State)));
+    }
+  }
+  return Modified;
+}
+
 
 INITIALIZE_PASS_BEGIN(EpiphanyLoadStoreOptimizer, "epiphany-ls-opt", "Epiphany Load Store Optimization", false, false)
+INITIALIZE_PASS_DEPENDENCY(AAResultsWrapperPass)
 INITIALIZE_PASS_END(EpiphanyLoadStoreOptimizer, "epiphany-ls-opt", "Epiphany Load Store Optimization", false, false)
 
 bool EpiphanyLoadStoreOptimizer::runOnMachineFunction(MachineFunction &Fn) {
-  DEBUG(dbgs() << "\nRunning Epiphany Load/Store Optimization Pass\n");
   if (skipFunction(*Fn.getFunction()))
     return false;
 
-  Subtarget = &static_cast<const EpiphanySubtarget &>(Fn.getSubtarget());
-  TII = Subtarget->getInstrInfo();
-  TRI = Subtarget->getRegisterInfo();
-  TFI = Subtarget->getFrameLowering();
+  const EpiphanySubtarget &Subtarget = static_cast<const EpiphanySubtarget &>(Fn.getSubtarget());
+  TII = Subtarget.getInstrInfo();
+  TRI = Subtarget.getRegisterInfo();
   MFI = &Fn.getFrameInfo();
   MRI = &Fn.getRegInfo();
   MF = &Fn;
-
-  // Get stack growth direction
-  StackGrowsDown = TFI->getStackGrowthDirection() == TargetFrameLowering::StackGrowsDown;
-  LastLocalBlockOffset = StackGrowsDown ? -4 : 4;
-
-  // Resize the modified and used register bitfield trackers.  We do this once
-  // per function and then clear the bitfield each time we optimize a load or
-  // store.
-  ModifiedRegs.resize(MRI->getNumVirtRegs() + TRI->getNumRegs());
-  UsedRegs.resize(MRI->getNumVirtRegs() + TRI->getNumRegs());
+  AA = &getAnalysis<AAResultsWrapperPass>().getAAResults();
+  PreRA = MRI->isSSA();
+  DEBUG(dbgs() << "\nRunning Epiphany Load/Store Optimization Pass (" << (PreRA ? "pre" : "post") << "-RA)\n");
+
+  // Frame objects used in any other way than (frame index, offset) can't be
+  // moved into another object
+  UnmergeableFrameIdxs.reset();
+  UnmergeableFrameIdxs.resize(std::max(MFI->getObjectIndexEnd(), 0));
+  for (MachineBasicBlock &MBB : Fn) {
+    for (MachineInstr &MI : MBB) {
+      for (unsigned i = 0, e = MI.getNumOperands(); i != e; ++i) {
+        const MachineOperand &MO = MI.getOperand(i);
+        if (MO.isFI() && MO.getIndex() >= 0 && (i + 1 == e || !MI.getOperand(i + 1).isImm())) {
+          UnmergeableFrameIdxs.set(MO.getIndex());
+        }
+      }
+    }
+  }
 
   bool Modified = false;
-  for (auto &MBB : Fn) {
-    Modified |= optimizeBlock(MBB);
-    if (Modified) {
-      MFI->setUseLocalStackAllocationBlock(true);
+  if (PreRA) {
+    // Start an extended basic block at each block which has not exactly one
+    // predecessor, others are visited from their predecessor
+    for (MachineBasicBlock &MBB : Fn) {
+      if (MBB.pred_size() != 1 || MBB.isEHPad() || *MBB.pred_begin() == &MBB) {
+        Modified |= optimizeExtendedBlock(MBB);
+      }
+    }
+  } else {
+    // Liveness across blocks is not tracked after RA
+    for (MachineBasicBlock &MBB : Fn) {
+      ScanState State;
+      Modified |= optimizeBlock(MBB, State);
+      Modified |= mergeBaseUpdates(MBB);
     }
   }
 
-  // Adjust local frame block size
-  int64_t LocalFrameSize = StackGrowsDown ? -LastLocalBlockOffset - 4 : LastLocalBlockOffset - 4;
-  MFI->setLocalFrameSize(LocalFrameSize);
+  for (MachineInstr *MI : Removed) {
+    Fn.DeleteMachineInstr(MI);
+  }
+  Removed.clear();
 
   return Modified;
 }
@@ -1,4 +1,4 @@
-//===---------------------EpiphanyFpuConfigPass.h--------------------------===//
+//===---------------------EpiphanyLoadStoreOptimizer.h---------------------===//
 //                     The LLVM Compiler Infrastructure
 //
 // This file is distributed under the University of Illinois Open Source
@@ -12,17 +12,22 @@
 #include "Epiphany.h"
 #include "EpiphanyConfig.h"
 #include "EpiphanyMachineFunction.h"
+#include "EpiphanyRegisterInfo.h"
 #include "EpiphanySubtarget.h"
 #include "EpiphanyTargetMachine.h"
 #include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
-#include "llvm/CodeGen/MachineDominators.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
-#include "llvm/CodeGen/MachineLoopInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/Passes.h"
+#include "llvm/CodeGen/PseudoSourceValue.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/MathExtras.h"
@@ -33,70 +38,104 @@
 namespace llvm {
   void initializeEpiphanyLoadStoreOptimizerPass(PassRegistry &);
 
-  typedef struct LoadStoreFlags {
-    // If a matching instruction is found, MergeForward is set to true if the
-    // merge is to remove the first instruction and replace the second with
-    // a pair-wise insn, and false if the reverse is true.
-    bool MergeForward;
-
-    LoadStoreFlags() : MergeForward(false) {}
-
-    void setMergeForward(bool V = true) { MergeForward = V; }
-
-    bool getMergeForward() const { return MergeForward; }
-  } LoadStoreFlags;
-
-
+  /// Merges pairs of 32-bit loads/stores to adjacent words into LDRD/STRD.
+  ///
+  /// Runs twice. Before register allocation (SSA) virtual registers are
+  /// paired with REG_SEQUENCE/COPY, single-word frame objects are merged
+  /// into dword ones, and loads are hoisted across extended basic blocks.
+  /// After it only registers forming an even/odd pair are merged, inside a
+  /// single block.
+  /// Adjacent accesses not merged before RA get their registers hinted into
+  /// an even/odd pair for the second run.
+  /// Then base register increments are folded into the preceding accesses,
+  /// making them post-modify ones.
   class EpiphanyLoadStoreOptimizer : public MachineFunctionPass {
-
-  private:
-    const EpiphanyInstrInfo *TII;
-    const TargetRegisterInfo *TRI;
-    const EpiphanySubtarget *Subtarget;
-    const EpiphanyFrameLowering *TFI;
-    MachineFunction *MF;
-    MachineRegisterInfo *MRI;
-    MachineFrameInfo *MFI;
-    // Track which registers have been modified and used.
-    BitVector ModifiedRegs, UsedRegs;
-    bool StackGrowsDown;
-    int64_t LastLocalBlockOffset = -4;
-
-    bool optimizeBlock(MachineBasicBlock &MBB);
-
-    bool tryToPairLoadStoreInst(MachineBasicBlock::iterator &MBBI);
-
-    bool isAlignmentCorrect(MachineInstr &FirstMI, MachineInstr &SecondMI);
-
-    bool canFormSuperReg(unsigned MainReg, unsigned PairedReg);
-
-    MachineBasicBlock::iterator findMatchingInst(MachineBasicBlock::iterator I,
-                                                 LoadStoreFlags &Flags, unsigned Limit);
-
-    MachineBasicBlock::iterator mergePairedInsns(MachineBasicBlock::iterator I,
-                                                 MachineBasicBlock::iterator Paired, const LoadStoreFlags &Flags);
-
-    MachineInstrBuilder mergeRegInsns(unsigned PairedOp, int64_t OffsetImm,
-                                      MachineOperand RegOp0, MachineOperand RegOp1,
-                                      MachineBasicBlock::iterator I, MachineBasicBlock::iterator Paired,
-                                      const LoadStoreFlags &Flags);
-
-    void cleanKillFlags(MachineOperand RegOp0, MachineOperand RegOp1,
-                        MachineBasicBlock::iterator I, MachineBasicBlock::iterator Paired,
-                        bool MergeForward);
-
-  public:
-    static char ID;
-
-    EpiphanyLoadStoreOptimizer() : MachineFunctionPass(ID) {
-      initializeEpiphanyLoadStoreOptimizerPass(*PassRegistry::getPassRegistry());
-    }
-
-    StringRef getPassName() const {
-      return "Epiphany Load/Store Optimization Pass";
-    }
-
-    bool runOnMachineFunction(MachineFunction &MF);
+    private:
+      // Kind of the access base
+      enum BaseKind {
+        // Register base, immediate offset
+        BASE_REG,
+        // Frame index base, offset inside the object
+        BASE_FI,
+        // Single-word frame object, "offset" is the frame index itself
+        BASE_FI_SLOT
+      };
+
+      // (paired opcode, base kind), (base, offset)
+      typedef std::pair<std::pair<unsigned, unsigned>, std::pair<int64_t, int64_t> > AccessKey;
+
+      struct MemAccess {
+        MachineInstr *MI;
+        // Position along the extended basic block
+        unsigned Pos;
+      };
+
+      // Everything known at the current point of the extended basic block.
+      // Copied for each successor, so each path sees only its own history.
+      struct ScanState {
+        // Last unpaired access for each base and offset
+        DenseMap<AccessKey, MemAccess> Index;
+        // All memory accesses since the last barrier, in program order
+        SmallVector<MemAccess, 32> MemInsns;
+        // Last position each register was defined and used at
+        DenseMap<unsigned, unsigned> LastDef, LastUse;
+        unsigned Pos = 0;
+        // Position of the first instruction of the current block
+        unsigned BlockStart = 0;
+      };
+
+      const EpiphanyInstrInfo *TII;
+      const TargetRegisterInfo *TRI;
+      MachineFunction *MF;
+      MachineRegisterInfo *MRI;
+      MachineFrameInfo *MFI;
+      AliasAnalysis *AA;
+      bool PreRA;
+
+      // Frame objects having uses other than (frame index, offset), these
+      // can't be merged into another object
+      BitVector UnmergeableFrameIdxs;
+      // Instructions removed from the blocks, deleted when the function is done
+      SmallPtrSet<MachineInstr *, 16> Removed;
+
+      bool getAccessKey(const MachineInstr &MI, AccessKey &Key) const;
+      void trackRegDefsUses(const MachineInstr &MI, ScanState &State) const;
+      bool isRegFree(unsigned Reg, unsigned From, bool CheckUses, const ScanState &State) const;
+      bool mayAlias(MachineInstr &MIa, MachineInstr &MIb) const;
+      bool hasMemConflict(MachineInstr &MI, unsigned From, const ScanState &State) const;
+      bool canFormSuperReg(unsigned LoReg, unsigned HiReg) const;
+      bool isAlignmentCorrect(const MachineInstr &Lo, const AccessKey &LoKey) const;
+      bool canMerge(const MemAccess &Prev, MachineInstr &MI, const AccessKey &PrevKey,
+                    const AccessKey &Key, const ScanState &State, bool &MergeForward) const;
+
+      MachineInstr *mergePairedInsns(MachineInstr &Prev, MachineInstr &MI, const AccessKey &PrevKey,
+                                     const AccessKey &Key, bool MergeForward, ScanState &State);
+      void hintRegPair(const MachineInstr &Lo, const MachineInstr &Hi) const;
+      void remapFrameSlot(int FromFI, int ToFI, int64_t Offset);
+      void removeInstr(MachineInstr &MI);
+
+      bool tryToPairLoadStoreInst(MachineInstr &MI, ScanState &State);
+      bool optimizeBlock(MachineBasicBlock &MBB, ScanState &State);
+      bool optimizeExtendedBlock(MachineBasicBlock &Root);
+      bool mergeBaseUpdates(MachineBasicBlock &MBB);
+
+    public:
+      static char ID;
+
+      EpiphanyLoadStoreOptimizer() : MachineFunctionPass(ID) {
+        initializeEpiphanyLoadStoreOptimizerPass(*PassRegistry::getPassRegistry());
+      }
+
+      void getAnalysisUsage(AnalysisUsage &AU) const override {
+        AU.addRequired<AAResultsWrapperPass>();
+        MachineFunctionPass::getAnalysisUsage(AU);
+      }
+
+      StringRef getPassName() const override {
+        return "Epiphany Load/Store Optimization Pass";
+      }
+
+      bool runOnMachineFunction(MachineFunction &MF) override;
   };
 
 } // namespace llvm
@@ -0,0 +1,324 @@
+//===---------------------EpiphanyOutliner.cpp-----------------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass moves repeated instruction sequences into shared subroutines.
+//
+//  Code and data of a core have to fit into 32KB of the local memory, so for
+//  functions optimized for size every byte counts. LLVM 4.0 has no generic
+//  machine outliner, and creating new functions this late is not possible,
+//  so sequences repeated within a function are moved into a block appended to
+//  the same function. The block starts with a label, each occurrence is
+//  replaced with BL to it, and the block ends with JR LR. As the block shares
+//  the frame with its callers, stack accesses need no adjustment.
+//
+//  BL overwrites LR, so only functions saving LR in the prologue are handled,
+//  and only at the points where LR does not hold the return address (after
+//  the prologue saved it and before the epilogue restored it), or anything
+//  else the allocator put into it. Hardware loop bodies are left alone.
+//
+//  Sequences are searched from the longest to the shortest, at each length
+//  the most profitable ones are outlined first. Profitability is decided by
+//  EpiphanyInstrInfo::getOutliningBenefit with the actual instruction sizes,
+//  so the pass runs after the size reduction. Branches are only shortened
+//  later, by the branch selector, so the reported savings are an estimate.
+//  Each outlined sequence and the totals per function and module are
+//  reported with -pass-remarks=epiphany_outliner.
+//
+//  Debug values don't take part in the matching, so -g doesn't change the
+//  code. They stay in place after the call replacing the sequence.
+//
+
+#include "EpiphanyOutliner.h"
+#include <algorithm>
+#include <map>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "epiphany_outliner"
+
+STATISTIC(NumOutlined, "Number of sequences outlined");
+STATISTIC(NumOutlinedCalls, "Number of outlined sequence calls inserted");
+STATISTIC(NumBytesSaved, "Estimated number of code bytes saved by outlining");
+
+static cl::opt<unsigned> MaxSequenceLength(
+  "epiphany-outliner-max-length",
+  cl::desc("Maximum number of instructions in an outlined sequence"),
+  cl::Hidden,
+  cl::init(64));
+
+char EpiphanyOutliner::ID = 0;
+
+INITIALIZE_PASS(EpiphanyOutliner, "epiphany-outliner", "Epiphany Machine Outliner", false, false)
+
+/// \brief Returns true if the prologue saves LR, so it can be clobbered
+bool EpiphanyOutliner::savesLR(const MachineFunction &MF) const {
+  for (const auto &MI : MF.front()) {
+    if (MI.getFlag(MachineInstr::FrameSetup) && MI.readsRegister(Epiphany::LR, TRI)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool EpiphanyOutliner::isLRLiveOut(const MachineBasicBlock &MBB) const {
+  for (const auto *Succ : MBB.successors()) {
+    for (MCRegAliasIterator AI(Epiphany::LR, TRI, true); AI.isValid(); ++AI) {
+      if (Succ->isLiveIn(*AI)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/// \brief Fills Instrs and IDs, leaving out everything that can't be outlined
+void EpiphanyOutliner::mapInstructions(MachineFunction &MF) {
+  DenseMap<MachineInstr *, unsigned, MachineInstrExpressionTrait> InstrIDs;
+  // Unique IDs go down from the top, so they never clash with the shared ones
+  unsigned UniqueID = ~0u;
+  Instrs.clear();
+  IDs.clear();
+
+  for (auto &MBB : MF) {
+    // Hardware loop bodies are single blocks ending with LOOPEND
+    bool InHwLoop = false;
+    for (auto &MI : MBB.terminators()) {
+      InHwLoop |= MI.getOpcode() == Epiphany::LOOPEND;
+    }
+
+    // Walk backwards to know where LR is free
+    SmallVector<std::pair<MachineInstr *, unsigned>, 32> BlockIDs;
+    bool LRLive = isLRLiveOut(MBB);
+    for (auto I = MBB.rbegin(), E = MBB.rend(); I != E; ++I) {
+      MachineInstr &MI = *I;
+      // Sequences run across debug values
+      if (MI.isDebugValue()) {
+        continue;
+      }
+      if (!InHwLoop && !LRLive && TII->isLegalToOutline(MI)) {
+        auto It = InstrIDs.insert(std::make_pair(&MI, (unsigned)InstrIDs.size())).first;
+        BlockIDs.push_back(std::make_pair(&MI, It->second));
+      } else {
+        BlockIDs.push_back(std::make_pair(nullptr, UniqueID--));
+      }
+      if (MI.modifiesRegister(Epiphany::LR, TRI)) {
+        LRLive = false;
+      }
+      if (MI.readsRegister(Epiphany::LR, TRI)) {
+        LRLive = true;
+      }
+    }
+
+    for (auto I = BlockIDs.rbegin(), E = BlockIDs.rend(); I != E; ++I) {
+      Instrs.push_back(I->first);
+      IDs.push_back(I->second);
+    }
+    // Sequences never cross blocks
+    Instrs.push_back(nullptr);
+    IDs.push_back(UniqueID--);
+  }
+}
+
+/// \brief Returns true if the sequence can still be outlined
+bool EpiphanyOutliner::isFree(unsigned Start, unsigned Length) const {
+  for (unsigned i = Start; i < Start + Length; ++i) {
+    if (!Instrs[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// \brief Collects the profitable sequences of the given length
+void EpiphanyOutliner::findCandidates(unsigned Length,
+    SmallVectorImpl<Candidate> &Candidates) const {
+  std::map<std::vector<unsigned>, SmallVector<unsigned, 4>> Groups;
+  for (unsigned i = 0; i + Length <= Instrs.size(); ++i) {
+    if (!isFree(i, Length)) {
+      continue;
+    }
+    std::vector<unsigned> Key(IDs.begin() + i, IDs.begin() + i + Length);
+    Groups[std::move(Key)].push_back(i);
+  }
+
+  for (auto &G : Groups) {
+    if (G.second.size() < 2) {
+      continue;
+    }
+    // Occurrences can't overlap, starts are sorted
+    Candidate C;
+    C.Length = Length;
+    for (unsigned Start : G.second) {
+      if (C.Starts.empty() || Start >= C.Starts.back() + Length) {
+        C.Starts.push_back(Start);
+      }
+    }
+    C.Size = 0;
+    for (unsigned i = C.Starts.front(); i < C.Starts.front() + Length; ++i) {
+      C.Size += TII->getInstSizeInBytes(*Instrs[i]);
+    }
+    C.Benefit = TII->getOutliningBenefit(C.Size, C.Starts.size());
+    if (C.Benefit > 0) {
+      Candidates.push_back(std::move(C));
+    }
+  }
+}
+
+void EpiphanyOutliner::outline(MachineFunction &MF, const Candidate &C) {
+  MachineInstr *First = Instrs[C.Starts.front()];
+  DEBUG(dbgs() << "Outlining " << C.Length << " instructions (" << C.Size
+               << " bytes) from " << C.Starts.size() << " places, saving "
+               << C.Benefit << " bytes, starting with "; First->dump());
+
+  // Body of the outlined sequence
+  MachineBasicBlock *OutMBB = MF.CreateMachineBasicBlock();
+  MF.push_back(OutMBB);
+  MCSymbol *Sym = MF.getContext().createTempSymbol("outlined", true);
+  BuildMI(*OutMBB, OutMBB->end(), First->getDebugLoc(), TII->get(TargetOpcode::EH_LABEL)).addSym(Sym);
+  for (unsigned i = C.Starts.front(); i < C.Starts.front() + C.Length; ++i) {
+    MachineInstr *NewMI = MF.CloneMachineInstr(Instrs[i]);
+    // Flags come from the first occurrence, matching ignores them. Registers
+    // may be used after the call, or be dead or undefined at one occurrence
+    // only
+    for (auto &MO : NewMI->operands()) {
+      if (!MO.isReg()) {
+        continue;
+      }
+      if (MO.isDef()) {
+        MO.setIsDead(false);
+      } else {
+        MO.setIsKill(false);
+        MO.setIsUndef(false);
+      }
+    }
+    OutMBB->push_back(NewMI);
+  }
+  TII->buildOutlinedFrame(*OutMBB, First->getDebugLoc());
+
+  // Live-ins keep the verifier happy, that's everything read before written
+  SmallSet<unsigned, 16> Defined;
+  for (auto &MI : *OutMBB) {
+    for (auto &MO : MI.operands()) {
+      if (MO.isReg() && MO.getReg() && MO.isUse() && !MO.isUndef() &&
+          !Defined.count(MO.getReg()) && !OutMBB->isLiveIn(MO.getReg())) {
+        OutMBB->addLiveIn(MO.getReg());
+      }
+    }
+    for (auto &MO : MI.operands()) {
+      if (MO.isReg() && MO.getReg() && MO.isDef()) {
+        Defined.insert(MO.getReg());
+      }
+    }
+  }
+
+  // Calls replacing the occurrences
+  for (unsigned Start : C.Starts) {
+    MachineInstr *MI = Instrs[Start];
+    MachineBasicBlock &MBB = *MI->getParent();
+    TII->insertOutlinedCall(MBB, MI, Sym);
+    for (unsigned i = Start; i < Start + C.Length; ++i) {
+      Instrs[i]->eraseFromParent();
+      Instrs[i] = nullptr;
+    }
+    ++NumOutlinedCalls;
+  }
+
+  emitOptimizationRemark(MF.getFunction()->getContext(), DEBUG_TYPE, *MF.getFunction(),
+      First->getDebugLoc(), "outlined " + Twine(C.Length) + " instructions (" + Twine(C.Size) +
+      " bytes) from " + Twine((unsigned)C.Starts.size()) + " places, saving about " +
+      Twine(C.Benefit) + " bytes");
+  ++NumOutlined;
+  NumBytesSaved += C.Benefit;
+}
+
+bool EpiphanyOutliner::doInitialization(Module &M) {
+  ModuleBytesSaved = 0;
+  LastOutlined = nullptr;
+  return false;
+}
+
+bool EpiphanyOutliner::doFinalization(Module &M) {
+  if (LastOutlined) {
+    emitOptimizationRemark(M.getContext(), DEBUG_TYPE, *LastOutlined, DebugLoc(),
+        "outlining saved about " + Twine(ModuleBytesSaved) + " bytes in the module");
+  }
+  return false;
+}
+
+bool EpiphanyOutliner::runOnMachineFunction(MachineFunction &MF) {
+  // Trading the speed for the size only makes sense when asked to
+  if (!MF.getFunction()->optForSize()) {
+    return false;
+  }
+
+  DEBUG(dbgs() << "\nRunning Epiphany outliner on " << MF.getName() << "\n");
+  TII = MF.getSubtarget<EpiphanySubtarget>().getInstrInfo();
+  TRI = MF.getSubtarget().getRegisterInfo();
+  if (!savesLR(MF)) {
+    DEBUG(dbgs() << "LR is not saved, skipping\n");
+    return false;
+  }
+
+  mapInstructions(MF);
+
+  // Longest run of the instructions that can be outlined
+  unsigned MaxLength = 0;
+  for (unsigned i = 0, Run = 0; i < Instrs.size(); ++i) {
+    Run = Instrs[i] ? Run + 1 : 0;
+    MaxLength = std::max(MaxLength, Run);
+  }
+  MaxLength = std::min(MaxLength, (unsigned)MaxSequenceLength);
+
+  bool Changed = false;
+  unsigned BytesSaved = 0;
+  for (unsigned Length = MaxLength; Length >= 2; --Length) {
+    SmallVector<Candidate, 8> Candidates;
+    findCandidates(Length, Candidates);
+    std::stable_sort(Candidates.begin(), Candidates.end(),
+        [](const Candidate &A, const Candidate &B) { return A.Benefit > B.Benefit; });
+
+    for (auto &C : Candidates) {
+      // Earlier candidates of the same length may have taken some places
+      SmallVector<unsigned, 4> Starts;
+      for (unsigned Start : C.Starts) {
+        if (isFree(Start, Length)) {
+          Starts.push_back(Start);
+        }
+      }
+      if (Starts.size() != C.Starts.size()) {
+        C.Starts = Starts;
+        C.Benefit = Starts.size() < 2 ? 0 : TII->getOutliningBenefit(C.Size, Starts.size());
+        if (C.Benefit <= 0) {
+          continue;
+        }
+      }
+      outline(MF, C);
+      BytesSaved += C.Benefit;
+      Changed = true;
+    }
+  }
+
+  if (Changed) {
+    const Function &F = *MF.getFunction();
+    emitOptimizationRemark(F.getContext(), DEBUG_TYPE, F, DebugLoc(),
+        "outlining saved about " + Twine(BytesSaved) + " bytes in " + F.getName());
+    ModuleBytesSaved += BytesSaved;
+    LastOutlined = &F;
+  }
+
+  Instrs.clear();
+  IDs.clear();
+  return Changed;
+}
+
+//===----------------------------------------------------------------------===//
+//                         Public Constructor Functions
+//===----------------------------------------------------------------------===//
+FunctionPass *llvm::createEpiphanyOutlinerPass() {
+  return new EpiphanyOutliner();
+}
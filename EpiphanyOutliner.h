@@ -0,0 +1,90 @@
+//===---------------------EpiphanyOutliner.h-------------------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYOUTLINER_H
+#define _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYOUTLINER_H
+
+#include "Epiphany.h"
+#include "EpiphanyConfig.h"
+#include "EpiphanyInstrInfo.h"
+#include "EpiphanySubtarget.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Target/TargetInstrInfo.h"
+
+namespace llvm {
+  void initializeEpiphanyOutlinerPass(PassRegistry&);
+
+  /// Moves instruction sequences repeated inside a function into a shared
+  /// block at the function end, called with BL and returning with JR LR.
+  /// Runs on functions optimized for size, after the size reduction.
+  class EpiphanyOutliner : public MachineFunctionPass {
+    private:
+      const EpiphanyInstrInfo *TII;
+      const TargetRegisterInfo *TRI;
+
+      // Instructions of the function in layout order, with nullptr separating
+      // the blocks and standing for the instructions that can't be (or have
+      // already been) outlined
+      SmallVector<MachineInstr *, 256> Instrs;
+      // Same instructions get the same ID, the rest get unique ones
+      SmallVector<unsigned, 256> IDs;
+
+      // Estimated savings in the module, reported in doFinalization against
+      // the last function changed
+      unsigned ModuleBytesSaved;
+      const Function *LastOutlined;
+
+      // Sequence found at several places
+      struct Candidate {
+        SmallVector<unsigned, 4> Starts;
+        unsigned Length;
+        unsigned Size;
+        int Benefit;
+      };
+
+      bool savesLR(const MachineFunction &MF) const;
+      bool isLRLiveOut(const MachineBasicBlock &MBB) const;
+      void mapInstructions(MachineFunction &MF);
+      bool isFree(unsigned Start, unsigned Length) const;
+      void findCandidates(unsigned Length, SmallVectorImpl<Candidate> &Candidates) const;
+      void outline(MachineFunction &MF, const Candidate &C);
+
+    public:
+      static char ID;
+      EpiphanyOutliner() : MachineFunctionPass(ID) {
+        initializeEpiphanyOutlinerPass(*PassRegistry::getPassRegistry());
+      }
+
+      StringRef getPassName() const override {
+        return "Epiphany machine outliner";
+      }
+
+      MachineFunctionProperties getRequiredProperties() const override {
+        return MachineFunctionProperties().set(
+            MachineFunctionProperties::Property::NoVRegs);
+      }
+
+      bool doInitialization(Module &M) override;
+      bool doFinalization(Module &M) override;
+      bool runOnMachineFunction(MachineFunction &MF) override;
+  };
+
+} // namespace llvm
+
+#endif
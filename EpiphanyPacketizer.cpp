@@ -0,0 +1,143 @@
+//===---------------------EpiphanyPacketizer.cpp---------------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass groups instructions into dual-issue packets (bundles).
+//
+//  E16 can issue one instruction into the integer pipe (IALU, load/store) and
+//  one into the FPU pipe (FPU or IALU2) in the same cycle, as long as they are
+//  independent. The pass runs after the post-RA scheduler, walks each
+//  scheduling region with the DFA generated from EpiphanyIssueItineraries and
+//  bundles each FPU/IALU2 instruction with an independent IALU or load/store
+//  neighbour. The asm printer emits bundled instructions back-to-back, so
+//  the program order inside a bundle is always kept.
+//
+
+#include "EpiphanyPacketizer.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "epiphany_packetizer"
+
+STATISTIC(NumPacketsFormed, "Number of dual-issue packets formed");
+
+char EpiphanyPacketizer::ID = 0;
+
+INITIALIZE_PASS_BEGIN(EpiphanyPacketizer, "epiphany-packetizer", "Epiphany Packetizer", false, false)
+INITIALIZE_PASS_DEPENDENCY(MachineLoopInfo)
+INITIALIZE_PASS_DEPENDENCY(AAResultsWrapperPass)
+INITIALIZE_PASS_END(EpiphanyPacketizer, "epiphany-packetizer", "Epiphany Packetizer", false, false)
+
+/// \brief Returns true if MI can't share a packet with any other instruction
+bool EpiphanyPacketizerList::isSoloInstruction(const MachineInstr &MI) {
+  // Everything that is not a real encoded instruction, or that we are not
+  // allowed to move around
+  if (MI.isDebugValue() || MI.isCFIInstruction() || MI.isLabel() ||
+      MI.isInlineAsm() || MI.isKill() || MI.isImplicitDef() ||
+      MI.getDesc().isPseudo()) {
+    return true;
+  }
+
+  // Control flow is kept outside of packets, so branch analysis does not need
+  // to look inside bundles
+  if (MI.isCall() || MI.isBranch() || MI.isReturn() || MI.isBarrier()) {
+    return true;
+  }
+
+  // GID/GIE, MOVTS and friends
+  if (MI.hasUnmodeledSideEffects()) {
+    return true;
+  }
+
+  // No itinerary means the DFA has no idea which pipe it goes to
+  return MI.getDesc().getSchedClass() == 0;
+}
+
+/// \brief Returns true if SUI can be issued together with SUJ
+///
+/// \param SUI Candidate instruction
+/// \param SUJ Instruction already in the packet, preceding SUI
+bool EpiphanyPacketizerList::isLegalToPacketizeTogether(SUnit *SUI, SUnit *SUJ) {
+  for (auto &Dep : SUJ->Succs) {
+    if (Dep.getSUnit() != SUI) {
+      continue;
+    }
+    // Anti-dependencies are fine as the read happens in RA stage before any
+    // write, everything else means SUI has to wait for SUJ
+    if (Dep.getKind() != SDep::Anti) {
+      DEBUG(dbgs() << "Can't packetize due to dependency: "; SUJ->getInstr()->dump());
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void EpiphanyPacketizerList::endPacket(MachineBasicBlock *MBB,
+    MachineBasicBlock::iterator MI) {
+  if (CurrentPacketMIs.size() > 1) {
+    ++NumPackets;
+    ++NumPacketsFormed;
+    DEBUG(dbgs() << "Packet formed:\n";
+        for (auto PMI : CurrentPacketMIs)
+          PMI->dump(););
+  }
+  VLIWPacketizerList::endPacket(MBB, MI);
+}
+
+void EpiphanyPacketizer::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesCFG();
+  AU.addRequired<AAResultsWrapperPass>();
+  AU.addRequired<MachineLoopInfo>();
+  AU.addPreserved<MachineLoopInfo>();
+  MachineFunctionPass::getAnalysisUsage(AU);
+}
+
+bool EpiphanyPacketizer::runOnMachineFunction(MachineFunction &MF) {
+  if (skipFunction(*MF.getFunction()))
+    return false;
+
+  DEBUG(dbgs() << "\nRunning Epiphany packetizer on " << MF.getName() << "\n");
+  const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
+  MachineLoopInfo &MLI = getAnalysis<MachineLoopInfo>();
+  AliasAnalysis *AA = &getAnalysis<AAResultsWrapperPass>().getAAResults();
+
+  EpiphanyPacketizerList Packetizer(MF, MLI, AA);
+
+  // Packetize each scheduling region separately, boundaries are left alone
+  for (auto &MBB : MF) {
+    auto Begin = MBB.begin(), End = MBB.end();
+    while (Begin != End) {
+      // Find the first non-boundary instruction
+      MachineBasicBlock::iterator RB = Begin;
+      while (RB != End && TII->isSchedulingBoundary(*RB, &MBB, MF))
+        ++RB;
+      // Find the next boundary, it closes the region
+      MachineBasicBlock::iterator RE = RB;
+      while (RE != End && !TII->isSchedulingBoundary(*RE, &MBB, MF))
+        ++RE;
+      if (RE != End)
+        ++RE;
+      if (RB != End)
+        Packetizer.PacketizeMIs(&MBB, RB, RE);
+
+      Begin = RE;
+    }
+  }
+
+  DEBUG(dbgs() << "Packets formed in " << MF.getName() << ": "
+      << Packetizer.getNumPackets() << "\n");
+
+  return Packetizer.getNumPackets() != 0;
+}
+
+//===----------------------------------------------------------------------===//
+//                         Public Constructor Functions
+//===----------------------------------------------------------------------===//
+FunctionPass *llvm::createEpiphanyPacketizerPass() {
+  return new EpiphanyPacketizer();
+}
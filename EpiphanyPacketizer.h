@@ -0,0 +1,68 @@
+//===---------------------EpiphanyPacketizer.h-----------------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYPACKETIZER_H
+#define _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYPACKETIZER_H
+
+#include "Epiphany.h"
+#include "EpiphanyConfig.h"
+#include "EpiphanyInstrInfo.h"
+#include "EpiphanySubtarget.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/CodeGen/DFAPacketizer.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/CodeGen/ScheduleDAG.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Target/TargetInstrInfo.h"
+
+namespace llvm {
+  void initializeEpiphanyPacketizerPass(PassRegistry&);
+
+  class EpiphanyPacketizerList : public VLIWPacketizerList {
+    private:
+      // Number of multi-instruction packets formed in the current function
+      unsigned NumPackets = 0;
+
+    public:
+      EpiphanyPacketizerList(MachineFunction &MF, MachineLoopInfo &MLI, AliasAnalysis *AA)
+        : VLIWPacketizerList(MF, MLI, AA) {}
+
+      unsigned getNumPackets() const { return NumPackets; }
+
+      bool isSoloInstruction(const MachineInstr &MI) override;
+      bool isLegalToPacketizeTogether(SUnit *SUI, SUnit *SUJ) override;
+      void endPacket(MachineBasicBlock *MBB, MachineBasicBlock::iterator MI) override;
+  };
+
+  class EpiphanyPacketizer : public MachineFunctionPass {
+    public:
+      static char ID;
+      EpiphanyPacketizer() : MachineFunctionPass(ID) {
+        initializeEpiphanyPacketizerPass(*PassRegistry::getPassRegistry());
+      }
+
+      void getAnalysisUsage(AnalysisUsage &AU) const override;
+
+      StringRef getPassName() const override {
+        return "Epiphany dual-issue packetizer";
+      }
+
+      MachineFunctionProperties getRequiredProperties() const override {
+        return MachineFunctionProperties().set(
+            MachineFunctionProperties::Property::NoVRegs);
+      }
+
+      bool runOnMachineFunction(MachineFunction &MF) override;
+  };
+
+} // namespace llvm
+
+#endif
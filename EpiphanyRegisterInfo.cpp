@@ -18,6 +18,8 @@
 #include "Epiphany.h"
 #include "EpiphanySubtarget.h"
 #include "EpiphanyMachineFunction.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/VirtRegMap.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Type.h"
 #include "llvm/Support/CommandLine.h"
@@ -70,6 +72,11 @@ BitVector EpiphanyRegisterInfo::getReservedRegs(const MachineFunction &MF) const
   Reserved.set(Epiphany::R30);
   Reserved.set(Epiphany::ZERO);
   Reserved.set(Epiphany::STATUS);
+  Reserved.set(Epiphany::CONFIG);
+  // Hardware loops
+  Reserved.set(Epiphany::LC);
+  Reserved.set(Epiphany::LS);
+  Reserved.set(Epiphany::LE);
 
   // 64 bit with same subregs
   Reserved.set(Epiphany::D4);
@@ -231,3 +238,65 @@ unsigned EpiphanyRegisterInfo::getRegPressureLimit(const TargetRegisterClass *RC
 unsigned EpiphanyRegisterInfo::getRegUnitWeight(unsigned RegUnit) const {
   return 1;
 }
+
+// Even/odd pairs are hinted by the load/store optimizer for the values of
+// adjacent accesses, so they can be merged into LDRD/STRD after RA
+void EpiphanyRegisterInfo::getRegAllocationHints(unsigned VirtReg, ArrayRef<MCPhysReg> Order,
+    SmallVectorImpl<MCPhysReg> &Hints, const MachineFunction &MF,
+    const VirtRegMap *VRM, const LiveRegMatrix *Matrix) const {
+  const MachineRegisterInfo &MRI = MF.getRegInfo();
+  std::pair<unsigned, unsigned> Hint = MRI.getRegAllocationHint(VirtReg);
+  if (Hint.first != EpiphanyRI::RegPairEven && Hint.first != EpiphanyRI::RegPairOdd) {
+    return TargetRegisterInfo::getRegAllocationHints(VirtReg, Order, Hints, MF, VRM, Matrix);
+  }
+
+  bool Even = Hint.first == EpiphanyRI::RegPairEven;
+  unsigned SubIdx   = Even ? Epiphany::isub_lo : Epiphany::isub_hi;
+  unsigned OtherIdx = Even ? Epiphany::isub_hi : Epiphany::isub_lo;
+
+  // Other half of the pair, if it is already allocated
+  unsigned PairedPhys = Hint.second;
+  if (PairedPhys && isVirtualRegister(PairedPhys)) {
+    PairedPhys = (VRM && VRM->hasPhys(PairedPhys)) ? VRM->getPhys(PairedPhys) : 0;
+  }
+
+  // Register completing the pair goes first
+  if (PairedPhys) {
+    unsigned DReg = getMatchingSuperReg(PairedPhys, OtherIdx, &Epiphany::GPR64RegClass);
+    if (DReg && is_contained(Order, getSubReg(DReg, SubIdx))) {
+      Hints.push_back(getSubReg(DReg, SubIdx));
+    }
+  }
+
+  // Then any register of the right parity with the other half available
+  for (MCPhysReg Reg : Order) {
+    unsigned DReg = getMatchingSuperReg(Reg, SubIdx, &Epiphany::GPR64RegClass);
+    if (!DReg || MRI.isReserved(getSubReg(DReg, OtherIdx)) || is_contained(Hints, Reg)) {
+      continue;
+    }
+    Hints.push_back(Reg);
+  }
+}
+
+// Keeps the pair hint of the other register up to date when the register
+// is replaced, i.e. by coalescing
+void EpiphanyRegisterInfo::updateRegAllocHint(unsigned Reg, unsigned NewReg,
+    MachineFunction &MF) const {
+  MachineRegisterInfo &MRI = MF.getRegInfo();
+  std::pair<unsigned, unsigned> Hint = MRI.getRegAllocationHint(Reg);
+  if ((Hint.first != EpiphanyRI::RegPairEven && Hint.first != EpiphanyRI::RegPairOdd) ||
+      !isVirtualRegister(Hint.second)) {
+    return;
+  }
+
+  // Other register could be hinted to something else already
+  unsigned OtherReg = Hint.second;
+  std::pair<unsigned, unsigned> OtherHint = MRI.getRegAllocationHint(OtherReg);
+  if (OtherHint.second != Reg) {
+    return;
+  }
+  MRI.setRegAllocationHint(OtherReg, OtherHint.first, NewReg);
+  if (isVirtualRegister(NewReg)) {
+    MRI.setRegAllocationHint(NewReg, Hint.first, OtherReg);
+  }
+}
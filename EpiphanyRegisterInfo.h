@@ -24,6 +24,15 @@
 
 namespace llvm {
 
+namespace EpiphanyRI {
+  // Register allocation hint types, second part of the hint is the other
+  // register of the pair
+  enum {
+    RegPairEven = 1,
+    RegPairOdd  = 2
+  };
+}
+
 class EpiphanySubtarget;
 class EpiphanyInstrInfo;
 class Type;
@@ -49,6 +58,11 @@ public:
   unsigned getRegPressureLimit(const TargetRegisterClass *RC, MachineFunction &MF) const override;
   unsigned getRegUnitWeight(unsigned RegUnit) const override;
 
+  void getRegAllocationHints(unsigned VirtReg, ArrayRef<MCPhysReg> Order,
+                             SmallVectorImpl<MCPhysReg> &Hints, const MachineFunction &MF,
+                             const VirtRegMap *VRM, const LiveRegMatrix *Matrix) const override;
+  void updateRegAllocHint(unsigned Reg, unsigned NewReg, MachineFunction &MF) const override;
+
   const TargetRegisterClass *getPointerRegClass(const MachineFunction &MF, unsigned Kind) const override;
 
   void eliminateFrameIndex(MachineBasicBlock::iterator II, int SPAdj,
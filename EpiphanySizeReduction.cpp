@@ -0,0 +1,198 @@
+//===---------------------EpiphanySizeReduction.cpp------------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass rewrites 32-bit instructions into the 16-bit ones.
+//
+//  Most arithmetic, move and load/store instructions have 16-bit encodings
+//  taking R0-R7 only, with the immediates cut down to 3 bits (8 for mov).
+//  ISel works with the 32-bit forms, as register classes of the operands are
+//  not known before the allocation. Once registers are assigned, every
+//  instruction with a 16-bit counterpart is checked and rewritten if all the
+//  operands fit. Operand lists of both forms are identical, so only the
+//  descriptor changes. Registers R8 and up have a higher cost per use, so the
+//  allocator tries to keep the values in the low registers.
+//
+//  The last instruction of a hardware loop has to stay 32-bit, it is left
+//  alone here rather than widened back by EpiphanyFixupHwLoops.
+//
+
+#include "EpiphanySizeReduction.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "epiphany_size_reduction"
+
+STATISTIC(NumReduced, "Number of 32-bit instructions rewritten into 16-bit ones");
+
+char EpiphanySizeReduction::ID = 0;
+
+INITIALIZE_PASS(EpiphanySizeReduction, "epiphany-size-reduction", "Epiphany Size Reduction", false, false)
+
+void EpiphanySizeReduction::buildReduceTable() {
+  if (!ReduceTable.empty()) {
+    return;
+  }
+
+  static const struct {
+    unsigned WideOpc;
+    unsigned NarrowOpc;
+    ReduceKind Kind;
+  } Entries[] = {
+    // Integer arithmetic
+    { Epiphany::ADDrr_r32,   Epiphany::ADDrr_r16,   RK_Regs  },
+    { Epiphany::ADDCrr_r32,  Epiphany::ADDCrr_r16,  RK_Regs  },
+    { Epiphany::SUBrr_r32,   Epiphany::SUBrr_r16,   RK_Regs  },
+    { Epiphany::SUBCrr_r32,  Epiphany::SUBCrr_r16,  RK_Regs  },
+    { Epiphany::CMPrr_r32,   Epiphany::CMPrr_r16,   RK_Regs  },
+    { Epiphany::ANDrr_r32,   Epiphany::ANDrr_r16,   RK_Regs  },
+    { Epiphany::ORRrr_r32,   Epiphany::ORRrr_r16,   RK_Regs  },
+    { Epiphany::EORrr_r32,   Epiphany::EORrr_r16,   RK_Regs  },
+    { Epiphany::ASRrr_r32,   Epiphany::ASRrr_r16,   RK_Regs  },
+    { Epiphany::LSRrr_r32,   Epiphany::LSRrr_r16,   RK_Regs  },
+    { Epiphany::LSLrr_r32,   Epiphany::LSLrr_r16,   RK_Regs  },
+    { Epiphany::ADDri_r32,   Epiphany::ADDri_r16,   RK_SImm3 },
+    { Epiphany::ADDCri_r32,  Epiphany::ADDCri_r16,  RK_SImm3 },
+    { Epiphany::SUBri_r32,   Epiphany::SUBri_r16,   RK_SImm3 },
+    { Epiphany::SUBCri_r32,  Epiphany::SUBCri_r16,  RK_SImm3 },
+    { Epiphany::CMPri_r32,   Epiphany::CMPri_r16,   RK_SImm3 },
+    { Epiphany::LSR32ri,     Epiphany::LSR16ri,     RK_Regs  },
+    { Epiphany::LSL32ri,     Epiphany::LSL16ri,     RK_Regs  },
+    { Epiphany::ASR32ri,     Epiphany::ASR16ri,     RK_Regs  },
+    { Epiphany::BITR32ri,    Epiphany::BITR16ri,    RK_Regs  },
+    // FPU and IALU2
+    { Epiphany::FADDrr_r32,  Epiphany::FADDrr_r16,  RK_Regs  },
+    { Epiphany::FSUBrr_r32,  Epiphany::FSUBrr_r16,  RK_Regs  },
+    { Epiphany::FCMPrr_r32,  Epiphany::FCMPrr_r16,  RK_Regs  },
+    { Epiphany::FMULrr_r32,  Epiphany::FMULrr_r16,  RK_Regs  },
+    { Epiphany::FMADDrr_r32, Epiphany::FMADDrr_r16, RK_Regs  },
+    { Epiphany::FMSUBrr_r32, Epiphany::FMSUBrr_r16, RK_Regs  },
+    { Epiphany::IADDrr_r32,  Epiphany::IADDrr_r16,  RK_Regs  },
+    { Epiphany::ISUBrr_r32,  Epiphany::ISUBrr_r16,  RK_Regs  },
+    { Epiphany::IMULrr_r32,  Epiphany::IMULrr_r16,  RK_Regs  },
+    { Epiphany::IMADDrr_r32, Epiphany::IMADDrr_r16, RK_Regs  },
+    { Epiphany::IMSUBrr_r32, Epiphany::IMSUBrr_r16, RK_Regs  },
+    // Moves, f32 ones share the registers with i32
+    { Epiphany::MOVi32ri,    Epiphany::MOVi16ri,    RK_UImm8 },
+    { Epiphany::MOVi32rr,    Epiphany::MOVi16rr,    RK_Regs  },
+    { Epiphany::MOVf32rr,    Epiphany::MOVi16rr,    RK_Regs  },
+    { Epiphany::MOVCC,       Epiphany::MOVCC16,     RK_Regs  },
+    // Loads and stores
+    { Epiphany::LDRi8_r32,           Epiphany::LDRi8_r16,           RK_Disp3 },
+    { Epiphany::LDRi16_r32,          Epiphany::LDRi16_r16,          RK_Disp3 },
+    { Epiphany::LDRi32_r32,          Epiphany::LDRi32_r16,          RK_Disp3 },
+    { Epiphany::LDRf32,              Epiphany::LDRi32_r16,          RK_Disp3 },
+    { Epiphany::STRi8_r32,           Epiphany::STRi8_r16,           RK_Disp3 },
+    { Epiphany::STRi16_r32,          Epiphany::STRi16_r16,          RK_Disp3 },
+    { Epiphany::STRi32_r32,          Epiphany::STRi32_r16,          RK_Disp3 },
+    { Epiphany::STRf32,              Epiphany::STRi32_r16,          RK_Disp3 },
+    { Epiphany::LDRi8_idx_add_r32,   Epiphany::LDRi8_idx_add_r16,   RK_Regs  },
+    { Epiphany::LDRi16_idx_add_r32,  Epiphany::LDRi16_idx_add_r16,  RK_Regs  },
+    { Epiphany::LDRi32_idx_add_r32,  Epiphany::LDRi32_idx_add_r16,  RK_Regs  },
+    { Epiphany::STRi8_idx_add_r32,   Epiphany::STRi8_idx_add_r16,   RK_Regs  },
+    { Epiphany::STRi16_idx_add_r32,  Epiphany::STRi16_idx_add_r16,  RK_Regs  },
+    { Epiphany::STRi32_idx_add_r32,  Epiphany::STRi32_idx_add_r16,  RK_Regs  },
+    { Epiphany::LDRi8_pm_add_r32,    Epiphany::LDRi8_pm_add_r16,    RK_Regs  },
+    { Epiphany::LDRi16_pm_add_r32,   Epiphany::LDRi16_pm_add_r16,   RK_Regs  },
+    { Epiphany::LDRi32_pm_add_r32,   Epiphany::LDRi32_pm_add_r16,   RK_Regs  },
+    { Epiphany::STRi8_pm_add_r32,    Epiphany::STRi8_pm_add_r16,    RK_Regs  },
+    { Epiphany::STRi16_pm_add_r32,   Epiphany::STRi16_pm_add_r16,   RK_Regs  },
+    { Epiphany::STRi32_pm_add_r32,   Epiphany::STRi32_pm_add_r16,   RK_Regs  },
+    // Jumps
+    { Epiphany::JR32,        Epiphany::JR16,        RK_Regs  },
+    { Epiphany::JALR32,      Epiphany::JALR16,      RK_Regs  },
+  };
+
+  for (const auto &E : Entries) {
+    ReduceTable[E.WideOpc] = {E.NarrowOpc, E.Kind};
+  }
+}
+
+/// \brief Returns true if all the operands of MI fit into the 16-bit form
+bool EpiphanySizeReduction::canReduce(const MachineInstr &MI, const ReduceEntry &Entry) const {
+  // Implicit operands are the same for both forms
+  for (unsigned i = 0, e = MI.getNumExplicitOperands(); i != e; ++i) {
+    const MachineOperand &MO = MI.getOperand(i);
+    if (MO.isReg() && !Epiphany::GPR16RegClass.contains(MO.getReg())) {
+      return false;
+    }
+  }
+
+  if (Entry.Kind == RK_Regs) {
+    return true;
+  }
+
+  // Immediate is the last explicit operand, relocations don't fit
+  const MachineOperand &ImmMO = MI.getOperand(MI.getNumExplicitOperands() - 1);
+  if (!ImmMO.isImm()) {
+    return false;
+  }
+  int64_t Imm = ImmMO.getImm();
+  switch (Entry.Kind) {
+    default:
+      llvm_unreachable("Unexpected reduce kind");
+    case RK_SImm3:
+      return isInt<3>(Imm);
+    case RK_UImm8:
+      return isUInt<8>(Imm);
+    case RK_Disp3: {
+      int64_t Size = EpiphanyII::getMemSize(MI.getDesc().TSFlags);
+      return Imm % Size == 0 && isUInt<3>(Imm / Size);
+    }
+  }
+}
+
+bool EpiphanySizeReduction::reduceBlock(MachineBasicBlock &MBB) {
+  // Last instruction of a hardware loop, LE points to it
+  MachineInstr *LoopLast = nullptr;
+  MachineBasicBlock::iterator LoopEnd = MBB.getFirstTerminator();
+  while (LoopEnd != MBB.end() && LoopEnd->getOpcode() != Epiphany::LOOPEND)
+    ++LoopEnd;
+  if (LoopEnd != MBB.end()) {
+    for (MachineBasicBlock::iterator I = LoopEnd; I != MBB.begin();) {
+      --I;
+      if (!I->isDebugValue() && !I->isCFIInstruction() && !I->isKill() && !I->isImplicitDef()) {
+        LoopLast = &*I;
+        break;
+      }
+    }
+  }
+
+  bool Changed = false;
+  for (auto &MI : MBB) {
+    auto It = ReduceTable.find(MI.getOpcode());
+    if (It == ReduceTable.end() || &MI == LoopLast || !canReduce(MI, It->second)) {
+      continue;
+    }
+    DEBUG(dbgs() << "Reducing "; MI.dump());
+    MI.setDesc(TII->get(It->second.NarrowOpc));
+    ++NumReduced;
+    Changed = true;
+  }
+
+  return Changed;
+}
+
+bool EpiphanySizeReduction::runOnMachineFunction(MachineFunction &MF) {
+  DEBUG(dbgs() << "\nRunning Epiphany size reduction on " << MF.getName() << "\n");
+  TII = MF.getSubtarget<EpiphanySubtarget>().getInstrInfo();
+  buildReduceTable();
+
+  bool Changed = false;
+  for (auto &MBB : MF) {
+    Changed |= reduceBlock(MBB);
+  }
+
+  return Changed;
+}
+
+//===----------------------------------------------------------------------===//
+//                         Public Constructor Functions
+//===----------------------------------------------------------------------===//
+FunctionPass *llvm::createEpiphanySizeReductionPass() {
+  return new EpiphanySizeReduction();
+}
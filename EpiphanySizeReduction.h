@@ -0,0 +1,80 @@
+//===---------------------EpiphanySizeReduction.h--------------------------===//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYSIZEREDUCTION_H
+#define _LLVM_LIB_TARGET_EPIPHANY_EPIPHANYSIZEREDUCTION_H
+
+#include "Epiphany.h"
+#include "EpiphanyConfig.h"
+#include "EpiphanyInstrInfo.h"
+#include "EpiphanySubtarget.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Target/TargetInstrInfo.h"
+
+namespace llvm {
+  void initializeEpiphanySizeReductionPass(PassRegistry&);
+
+  /// Rewrites 32-bit instructions into their 16-bit forms when all register
+  /// operands are R0-R7 and the immediate fits.
+  /// Runs after the register allocation, before the hardware loop fixup.
+  class EpiphanySizeReduction : public MachineFunctionPass {
+    private:
+      // Operand constraints of the 16-bit form on top of the registers
+      enum ReduceKind {
+        // Registers only
+        RK_Regs,
+        // Signed 3-bit immediate
+        RK_SImm3,
+        // Unsigned 8-bit immediate
+        RK_UImm8,
+        // Unsigned 3-bit displacement, scaled by the access size
+        RK_Disp3
+      };
+
+      struct ReduceEntry {
+        unsigned NarrowOpc;
+        ReduceKind Kind;
+      };
+
+      const EpiphanyInstrInfo *TII;
+      DenseMap<unsigned, ReduceEntry> ReduceTable;
+
+      void buildReduceTable();
+      bool canReduce(const MachineInstr &MI, const ReduceEntry &Entry) const;
+      bool reduceBlock(MachineBasicBlock &MBB);
+
+    public:
+      static char ID;
+      EpiphanySizeReduction() : MachineFunctionPass(ID) {
+        initializeEpiphanySizeReductionPass(*PassRegistry::getPassRegistry());
+      }
+
+      void getAnalysisUsage(AnalysisUsage &AU) const override {
+        AU.setPreservesCFG();
+        MachineFunctionPass::getAnalysisUsage(AU);
+      }
+
+      StringRef getPassName() const override {
+        return "Epiphany 16-bit instruction size reduction";
+      }
+
+      MachineFunctionProperties getRequiredProperties() const override {
+        return MachineFunctionProperties().set(
+            MachineFunctionProperties::Property::NoVRegs);
+      }
+
+      bool runOnMachineFunction(MachineFunction &MF) override;
+  };
+
+} // namespace llvm
+
+#endif
@@ -41,6 +41,12 @@ protected:
   EpiphanyArchEnum EpiphanyArchVersion;
   // HasCmp - cmp instructions.
   bool HasCmp = false;
+  // HasTruncateFP - FPU uses truncate rounding instead of round-to-nearest
+  bool HasTruncateFP = false;
+  // UseLongCalls - all calls are far, the callee may be out of BL range
+  bool UseLongCalls = false;
+  // HasInlineDiv - integer division is inlined instead of calling libgcc
+  bool HasInlineDiv = false;
   // Itinerary data
   InstrItineraryData InstrItins;
   // Target Machine
@@ -72,6 +78,12 @@ public:
   
   bool hasCmp() const { return HasCmp; }
 
+  bool hasTruncateFP() const { return HasTruncateFP; }
+
+  bool hasInlineDiv() const { return HasInlineDiv; }
+
+  bool useLongCalls() const { return UseLongCalls; }
+
   unsigned stackAlignment() const { return 2; }
   unsigned stackOffset() const { return 8; }
 
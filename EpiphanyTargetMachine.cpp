@@ -39,6 +39,54 @@ static cl::opt<bool> EnableLSOpt(
   cl::ReallyHidden,
   cl::init(true));
 
+static cl::opt<bool> EnableFpuModeConvention(
+  "epiphany-fpu-mode-convention",
+  cl::desc("Let internal functions use the FPU/IALU2 mode set by the caller"),
+  cl::ReallyHidden,
+  cl::init(true));
+
+static cl::opt<bool> EnableBankPlacement(
+  "epiphany-bank-placement",
+  cl::desc("Place large arrays into the free local memory banks"),
+  cl::ReallyHidden,
+  cl::init(true));
+
+static cl::opt<bool> EnableHardwareLoops(
+  "epiphany-hwloops",
+  cl::desc("Generate Epiphany hardware loops"),
+  cl::ReallyHidden,
+  cl::init(true));
+
+static cl::opt<bool> EnablePipeliner(
+  "epiphany-pipeliner",
+  cl::desc("Software pipeline Epiphany hardware loops"),
+  cl::ReallyHidden,
+  cl::init(true));
+
+static cl::opt<bool> EnableSizeReduction(
+  "epiphany-size-reduction",
+  cl::desc("Rewrite instructions into the 16-bit form where operands fit"),
+  cl::ReallyHidden,
+  cl::init(true));
+
+static cl::opt<bool> EnableOutliner(
+  "epiphany-outliner",
+  cl::desc("Outline repeated instruction sequences in functions optimized for size"),
+  cl::ReallyHidden,
+  cl::init(true));
+
+static cl::opt<bool> EnableBranchSelect(
+  "epiphany-short-branches",
+  cl::desc("Use 16-bit branches where the target is in reach"),
+  cl::ReallyHidden,
+  cl::init(true));
+
+static cl::opt<bool> EnablePacketizer(
+  "epiphany-packetizer",
+  cl::desc("Run Epiphany dual-issue packetizer"),
+  cl::ReallyHidden,
+  cl::init(true));
+
 #define DEBUG_TYPE "epiphany"
 
 extern "C" void LLVMInitializeEpiphanyTarget() {
@@ -134,6 +182,12 @@ void EpiphanyPassConfig::addIRPasses() {
   if (EnableSROA && (TM->getOptLevel() != CodeGenOpt::None)) {
     addPass(createSROAPass());
   }
+  if (EnableFpuModeConvention && TM->getOptLevel() != CodeGenOpt::None) {
+    addPass(createEpiphanyFpuModeConventionPass(getEpiphanyTargetMachine()));
+  }
+  if (EnableBankPlacement && TM->getOptLevel() != CodeGenOpt::None) {
+    addPass(createEpiphanyBankPlacementPass());
+  }
 
   TargetPassConfig::addIRPasses();
 }
@@ -147,7 +201,6 @@ bool EpiphanyPassConfig::addILPOpts() {
 
 bool EpiphanyPassConfig::addInstSelector() {
   addPass(new EpiphanyDAGToDAGISel(getEpiphanyTargetMachine(), getOptLevel()));
-  addPass(createEpiphanyFpuConfigPass());
   return false;
 }
 
@@ -158,9 +211,18 @@ void EpiphanyPassConfig::addCodeGenPrepare() {
 }
 
 void EpiphanyPassConfig::addPreRegAlloc() {
+  // Goes after MachineLICM and MachineCSE, see EpiphanyFpuConfigPass.cpp
+  addPass(createEpiphanyFpuConfigPass());
+  // Needs SSA form to find the induction variables
+  if (EnableHardwareLoops && TM->getOptLevel() != CodeGenOpt::None) {
+    addPass(createEpiphanyHardwareLoopsPass());
+    // Only hardware loops can be pipelined
+    if (EnablePipeliner && TM->getOptLevel() >= CodeGenOpt::Default)
+      addPass(&MachinePipelinerID);
+  }
   addPass(&LiveVariablesID, false);
   if (EnableLSOpt && TM->getOptLevel() != CodeGenOpt::None)
-    addPass(createEpiphanyVregLoadStoreOptimizationPass());
+    addPass(createEpiphanyLoadStoreOptimizationPass());
 }
 
 void EpiphanyPassConfig::addPreSched2() {
@@ -170,6 +232,19 @@ void EpiphanyPassConfig::addPreSched2() {
 void EpiphanyPassConfig::addPreEmitPass() {
   if (EnableLSOpt && TM->getOptLevel() != CodeGenOpt::None)
     addPass(createEpiphanyLoadStoreOptimizationPass());
+  if (EnableSizeReduction)
+    addPass(createEpiphanySizeReductionPass());
+  // Compares the final instruction sizes, so goes after the size reduction
+  if (EnableOutliner && TM->getOptLevel() != CodeGenOpt::None)
+    addPass(createEpiphanyOutlinerPass());
+  if (EnableHardwareLoops && TM->getOptLevel() != CodeGenOpt::None)
+    addPass(createEpiphanyFixupHwLoopsPass());
+  // Needs the final code size, so goes after everything that changes it
+  if (EnableBranchSelect)
+    addPass(createEpiphanyBranchSelectorPass());
+  // Should be the last one, nothing after it understands bundles
+  if (EnablePacketizer && TM->getOptLevel() != CodeGenOpt::None)
+    addPass(createEpiphanyPacketizerPass());
 }
 
 TargetIRAnalysis EpiphanyTargetMachine::getTargetIRAnalysis() {
@@ -13,11 +13,23 @@
 
 #include "EpiphanyTargetObjectFile.h"
 
+#include "llvm/ADT/Twine.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Module.h"
 #include "llvm/MC/MCContext.h"
 #include "llvm/MC/MCSectionELF.h"
+#include "llvm/Support/CommandLine.h"
 
 using namespace llvm;
 
+// Same as -G in GCC. The linker script should place .sdata and .sbss into
+// the local memory, that is why it is off by default
+static cl::opt<unsigned> SSThreshold("epiphany-ssection-threshold", cl::Hidden,
+    cl::desc("Small data and bss section threshold size, objects there are "
+             "addressed with a single MOV (default=0, disabled)"),
+    cl::init(0));
+
 void EpiphanyTargetObjectFile::Initialize(MCContext &Ctx,
                                          const TargetMachine &TM) {
   TargetLoweringObjectFileELF::Initialize(Ctx, TM);
@@ -28,6 +40,123 @@ void EpiphanyTargetObjectFile::Initialize(MCContext &Ctx,
 
   SmallBSSSection = getContext().getELFSection(
       ".sbss", ELF::SHT_NOBITS, ELF::SHF_WRITE | ELF::SHF_ALLOC);
+
+  // Bank sections are mapped to the banks by the linker script
+  for (unsigned Bank = 0; Bank < EpiphanyBank::NumBanks; ++Bank) {
+    TextBankSections[Bank] = getContext().getELFSection(
+        Twine(EpiphanyBank::TextPrefix) + Twine(Bank), ELF::SHT_PROGBITS,
+        ELF::SHF_EXECINSTR | ELF::SHF_ALLOC);
+    DataBankSections[Bank] = getContext().getELFSection(
+        Twine(EpiphanyBank::DataPrefix) + Twine(Bank), ELF::SHT_PROGBITS,
+        ELF::SHF_WRITE | ELF::SHF_ALLOC);
+  }
   
   this->TM = &static_cast<const EpiphanyTargetMachine &>(TM);
 }
+
+int EpiphanyTargetObjectFile::getSectionBank(StringRef Name) {
+  if (Name.startswith(EpiphanyBank::TextPrefix)) {
+    Name = Name.drop_front(strlen(EpiphanyBank::TextPrefix));
+  } else if (Name.startswith(EpiphanyBank::DataPrefix)) {
+    Name = Name.drop_front(strlen(EpiphanyBank::DataPrefix));
+  } else {
+    return -1;
+  }
+
+  unsigned Bank;
+  if (Name.getAsInteger(10, Bank) || Bank >= EpiphanyBank::NumBanks) {
+    return -1;
+  }
+  return Bank;
+}
+
+int EpiphanyTargetObjectFile::getFunctionBank(const Function &F) {
+  if (!F.hasFnAttribute(EpiphanyBank::AttrName)) {
+    return -1;
+  }
+
+  unsigned Bank;
+  StringRef Value = F.getFnAttribute(EpiphanyBank::AttrName).getValueAsString();
+  if (Value.getAsInteger(10, Bank) || Bank >= EpiphanyBank::NumBanks) {
+    return -1;
+  }
+  return Bank;
+}
+
+bool EpiphanyTargetObjectFile::IsGlobalInSmallSection(const GlobalObject *GO,
+    const TargetMachine &TM) const {
+  // Declarations can't be used, the kind is only known for definitions
+  if (GO->isDeclaration()) {
+    return false;
+  }
+  return IsGlobalInSmallSection(GO, TM, getKindForGlobal(GO, TM));
+}
+
+bool EpiphanyTargetObjectFile::IsGlobalInSmallSection(const GlobalObject *GO,
+    const TargetMachine &TM, SectionKind Kind) const {
+  const auto *GVA = dyn_cast<GlobalVariable>(GO);
+  if (!SSThreshold || !GVA || GVA->hasSection()) {
+    return false;
+  }
+  // Commons and definitions another module may override can be placed
+  // elsewhere by the linker
+  if (GVA->isDeclarationForLinker() || GVA->hasCommonLinkage() || GVA->isWeakForLinker()) {
+    return false;
+  }
+  if (!Kind.isData() && !Kind.isBSS() && !Kind.isReadOnly()) {
+    return false;
+  }
+
+  uint64_t Size = GVA->getParent()->getDataLayout().getTypeAllocSize(GVA->getValueType());
+  return Size > 0 && Size <= SSThreshold;
+}
+
+bool EpiphanyTargetObjectFile::isGlobalInLocalMemory(const GlobalValue *GV,
+    const TargetMachine &TM) const {
+  const GlobalObject *GO = GV->getBaseObject();
+  if (!GO) {
+    return false;
+  }
+
+  // Banks are the local memory
+  if (getSectionBank(GO->getSection()) >= 0) {
+    return true;
+  }
+  if (const auto *F = dyn_cast<Function>(GO)) {
+    return getFunctionBank(*F) >= 0;
+  }
+  return IsGlobalInSmallSection(GO, TM);
+}
+
+MCSection *EpiphanyTargetObjectFile::getExplicitSectionGlobal(const GlobalObject *GO,
+    SectionKind Kind, const TargetMachine &TM) const {
+  // Bank sections keep the same flags whatever kind of object is placed
+  // there first, so constants and variables can share the bank
+  int Bank = getSectionBank(GO->getSection());
+  if (Bank >= 0) {
+    return GO->getSection().startswith(EpiphanyBank::TextPrefix) ?
+      TextBankSections[Bank] : DataBankSections[Bank];
+  }
+
+  return TargetLoweringObjectFileELF::getExplicitSectionGlobal(GO, Kind, TM);
+}
+
+MCSection *EpiphanyTargetObjectFile::SelectSectionForGlobal(const GlobalObject *GO,
+    SectionKind Kind, const TargetMachine &TM) const {
+  if (const auto *F = dyn_cast<Function>(GO)) {
+    int Bank = getFunctionBank(*F);
+    if (Bank >= 0) {
+      return TextBankSections[Bank];
+    }
+  }
+
+  // Small objects, addressed with a single MOV
+  if (Kind.isBSS() && IsGlobalInSmallSection(GO, TM, Kind)) {
+    return SmallBSSSection;
+  }
+  if ((Kind.isData() || Kind.isReadOnly()) && IsGlobalInSmallSection(GO, TM, Kind)) {
+    return SmallDataSection;
+  }
+
+  return TargetLoweringObjectFileELF::SelectSectionForGlobal(GO, Kind, TM);
+}
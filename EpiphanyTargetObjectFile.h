@@ -18,18 +18,54 @@
 
 #include "EpiphanyTargetMachine.h"
 #include "llvm/CodeGen/TargetLoweringObjectFileImpl.h"
+#include "llvm/IR/Function.h"
 
 namespace llvm {
   
   class EpiphanyTargetMachine;
+
+  namespace EpiphanyBank {
+    // Local memory is split into four 8KB banks. Code and small data go to
+    // bank 0, the stack grows down from the top of bank 3
+    static const unsigned NumBanks  = 4;
+    static const unsigned BankSize  = 8192;
+    static const unsigned CodeBank  = 0;
+    static const unsigned StackBank = 3;
+    // Function attribute: place the function code into the given bank
+    static const char *const AttrName = "epiphany-bank";
+    // Bank section prefixes, same as used by the eSDK linker scripts
+    static const char *const TextPrefix = ".text_bank";
+    static const char *const DataPrefix = ".data_bank";
+  }
   
   class EpiphanyTargetObjectFile : public TargetLoweringObjectFileELF {
     MCSection *SmallDataSection;
     MCSection *SmallBSSSection;
+    MCSection *TextBankSections[EpiphanyBank::NumBanks];
+    MCSection *DataBankSections[EpiphanyBank::NumBanks];
     const EpiphanyTargetMachine *TM;
     
    public:
     void Initialize(MCContext &Ctx, const TargetMachine &TM) override;
+
+    /// Bank the section is mapped to, -1 if it is not a bank section
+    static int getSectionBank(StringRef Name);
+    /// Bank requested for the function code, -1 if none
+    static int getFunctionBank(const Function &F);
+
+    /// Returns true if the object goes to .sdata/.sbss, which are placed
+    /// into the local memory
+    bool IsGlobalInSmallSection(const GlobalObject *GO, const TargetMachine &TM,
+                                SectionKind Kind) const;
+    bool IsGlobalInSmallSection(const GlobalObject *GO, const TargetMachine &TM) const;
+    /// Returns true if the object address is known to be below 0x8000, so a
+    /// single MOV materializes it
+    bool isGlobalInLocalMemory(const GlobalValue *GV, const TargetMachine &TM) const;
+
+    MCSection *getExplicitSectionGlobal(const GlobalObject *GO, SectionKind Kind,
+                                        const TargetMachine &TM) const override;
+    MCSection *SelectSectionForGlobal(const GlobalObject *GO, SectionKind Kind,
+                                      const TargetMachine &TM) const override;
   };
 
 } // end namespace llvm
@@ -16,6 +16,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "EpiphanyTargetTransformInfo.h"
+#include "EpiphanyISelLowering.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/Analysis/ValueTracking.h"
@@ -58,21 +59,225 @@ unsigned EpiphanyTTIImpl::getMaxInterleaveFactor(unsigned VF) {
   return 1;
 }
 
-// FIXME: setting all costs to 1 for now
+//===----------------------------------------------------------------------===//
+// Cost model
+//
+// Costs are in cycles of the E16 core, from the latencies in the reference
+// manual (IALU 1, load 2, IALU2/FPU 4 pipelined) and the legalization
+// actions set in EpiphanyTargetLowering. Expanded operations are costed as
+// the library routine or the instruction sequence they end up in.
+//===----------------------------------------------------------------------===//
+
+// Legal and custom operations not costing a single IALU cycle, and the
+// expanded ones
+static const CostTblEntry ArithCostTbl[] = {
+  // IALU2 and FPU results are ready in 4 cycles, but the unit is
+  // pipelined and the scheduler fills some of the gap
+  { ISD::MUL,  MVT::i32,   2 },
+  { ISD::FADD, MVT::f32,   2 },
+  { ISD::FSUB, MVT::f32,   2 },
+  { ISD::FMUL, MVT::f32,   2 },
+
+  // No divider, libcalls (__divsi3 and friends, __divsf3) unless inlined,
+  // see InlineDivCostTbl and DivEstimateCostTbl
+  { ISD::SDIV, MVT::i32,  40 },
+  { ISD::UDIV, MVT::i32,  35 },
+  { ISD::SREM, MVT::i32,  45 },
+  { ISD::UREM, MVT::i32,  40 },
+  { ISD::FDIV, MVT::f32,  50 },
+  { ISD::FREM, MVT::f32, 100 },
+
+  // 64-bit integers are split, add/sub carry is custom lowered to a
+  // sequence of conditional moves, multiply is built from 32-bit and
+  // 16x16 partial products, shifts are built from 32-bit shifts and
+  // conditional moves, the rest are libcalls
+  { ISD::ADD,  MVT::i64,   9 },
+  { ISD::SUB,  MVT::i64,   9 },
+  { ISD::AND,  MVT::i64,   2 },
+  { ISD::OR,   MVT::i64,   2 },
+  { ISD::XOR,  MVT::i64,   2 },
+  { ISD::SHL,  MVT::i64,  12 },
+  { ISD::SRL,  MVT::i64,  12 },
+  { ISD::SRA,  MVT::i64,  12 },
+  { ISD::MUL,  MVT::i64,  15 },
+  { ISD::SDIV, MVT::i64, 120 },
+  { ISD::UDIV, MVT::i64, 110 },
+  { ISD::SREM, MVT::i64, 130 },
+  { ISD::UREM, MVT::i64, 120 },
+
+  // Soft-float double
+  { ISD::FADD, MVT::f64,  60 },
+  { ISD::FSUB, MVT::f64,  60 },
+  { ISD::FMUL, MVT::f64,  70 },
+  { ISD::FDIV, MVT::f64, 160 },
+  { ISD::FREM, MVT::f64, 250 },
+
+  // Pair ops are split into two scalar ones
+  { ISD::ADD,  MVT::v2i32, 2 },
+  { ISD::SUB,  MVT::v2i32, 2 },
+  { ISD::AND,  MVT::v2i32, 2 },
+  { ISD::OR,   MVT::v2i32, 2 },
+  { ISD::XOR,  MVT::v2i32, 2 },
+  { ISD::SHL,  MVT::v2i32, 2 },
+  { ISD::SRL,  MVT::v2i32, 2 },
+  { ISD::SRA,  MVT::v2i32, 2 },
+  { ISD::MUL,  MVT::v2i32, 4 },
+  { ISD::FADD, MVT::v2f32, 4 },
+  { ISD::FSUB, MVT::v2f32, 4 },
+  { ISD::FMUL, MVT::v2f32, 4 },
+};
+
+// Division lowered inline, about fifty instructions for i32 (a few more for
+// the signed forms) and eight for the f32 reciprocal estimate. Independent
+// divisions overlap in the pipelined FPU, so the cost is closer to the issue
+// slots than to the latency of the whole chain. The i32 sequence also
+// switches between the FPU and IALU2 modes four times, and the CONFIG
+// values are set up at the function entry, which adds about a dozen more.
+static const CostTblEntry InlineDivCostTbl[] = {
+  { ISD::SDIV, MVT::i32,  36 },
+  { ISD::UDIV, MVT::i32,  32 },
+  { ISD::SREM, MVT::i32,  36 },
+  { ISD::UREM, MVT::i32,  32 },
+};
+
+static const CostTblEntry DivEstimateCostTbl[] = {
+  { ISD::FDIV, MVT::f32,  15 },
+};
+
+/// Same check as the DAG combiner does before asking for the estimate,
+/// "reciprocal-estimates" can switch it off for f32 division
+bool EpiphanyTTIImpl::useDivEstimates(const EpiphanyTargetMachine *TM, const Function &F) {
+  if (!TM->Options.UnsafeFPMath &&
+      F.getFnAttribute("unsafe-fp-math").getValueAsString() != "true") {
+    return false;
+  }
+
+  SmallVector<StringRef, 4> Estimates;
+  F.getFnAttribute("reciprocal-estimates").getValueAsString().split(Estimates, ',');
+  for (StringRef E : Estimates) {
+    // Refinement step count doesn't matter here
+    E = E.split(':').first;
+    if (E == "none" || E == "!all" || E == "!div" || E == "!divf") {
+      return false;
+    }
+  }
+  return true;
+}
+
 int EpiphanyTTIImpl::getArithmeticInstrCost(
     unsigned Opcode, Type *Ty,  
     TTI::OperandValueKind Op1Info, TTI::OperandValueKind Op2Info,
     TTI::OperandValueProperties Opd1PropInfo,
     TTI::OperandValueProperties Opd2PropInfo,
-    ArrayRef<const Value *> Args) { return 1; }
-int EpiphanyTTIImpl::getVectorInstrCost(unsigned Opcode, Type *Val, unsigned Index) { return 1; }
+    ArrayRef<const Value *> Args) {
+  std::pair<int, MVT> LT = TLI->getTypeLegalizationCost(DL, Ty);
+  int ISD = TLI->InstructionOpcodeToISD(Opcode);
+
+  // Division by a power of 2 is a shift, plus the rounding fixup if signed
+  if (Op2Info == TTI::OK_UniformConstantValue && Opd2PropInfo == TTI::OP_PowerOf2 &&
+      LT.second == MVT::i32) {
+    if (ISD == ISD::UDIV || ISD == ISD::UREM) {
+      return LT.first;
+    }
+    if (ISD == ISD::SDIV || ISD == ISD::SREM) {
+      return 4 * LT.first;
+    }
+  }
+
+  if (InlineDiv) {
+    if (const auto *Entry = CostTableLookup(InlineDivCostTbl, ISD, LT.second)) {
+      return LT.first * Entry->Cost;
+    }
+  }
+  if (DivEstimates) {
+    if (const auto *Entry = CostTableLookup(DivEstimateCostTbl, ISD, LT.second)) {
+      return LT.first * Entry->Cost;
+    }
+  }
+  if (const auto *Entry = CostTableLookup(ArithCostTbl, ISD, LT.second)) {
+    return LT.first * Entry->Cost;
+  }
+  return BaseT::getArithmeticInstrCost(Opcode, Ty, Op1Info, Op2Info,
+                                       Opd1PropInfo, Opd2PropInfo, Args);
+}
+
+/// Cost for the inliner, unrollers and SimplifyCFG, which only distinguish
+/// free, basic and expensive instructions
+unsigned EpiphanyTTIImpl::getOperationCost(unsigned Opcode, Type *Ty, Type *OpTy) {
+  switch (Opcode) {
+    default:
+      break;
+    case Instruction::FAdd:
+    case Instruction::FSub:
+    case Instruction::FMul:
+      // Soft-float
+      if (Ty->getScalarType()->isDoubleTy()) {
+        return TTI::TCC_Expensive;
+      }
+      break;
+    case Instruction::Mul:
+    case Instruction::Shl:
+    case Instruction::LShr:
+    case Instruction::AShr:
+      // Sequences of a dozen instructions or more
+      if (Ty->getScalarSizeInBits() > 32) {
+        return TTI::TCC_Expensive;
+      }
+      break;
+  }
+  return BaseT::getOperationCost(Opcode, Ty, OpTy);
+}
+
+/// Elements of the pairs are subregisters, element with a variable index
+/// goes through the stack
+int EpiphanyTTIImpl::getVectorInstrCost(unsigned Opcode, Type *Val, unsigned Index) {
+  if (Opcode != Instruction::ExtractElement && Opcode != Instruction::InsertElement) {
+    return BaseT::getVectorInstrCost(Opcode, Val, Index);
+  }
+  std::pair<int, MVT> LT = TLI->getTypeLegalizationCost(DL, Val);
+  if (LT.second != MVT::v2i32 && LT.second != MVT::v2f32) {
+    return BaseT::getVectorInstrCost(Opcode, Val, Index);
+  }
+  if (Index == -1U) {
+    return 4;
+  }
+  // Insert rebuilds the pair
+  return Opcode == Instruction::ExtractElement ? 0 : 1;
+}
+
+/// Local memory loads take 2 cycles, stores 1. Dwords with an alignment
+/// below 8 are split into two words by the legalizer (see
+/// allowsMisalignedMemoryAccesses), unknown alignment means the ABI one.
+/// Remote (mesh) accesses can't be told apart by the pointer type, so they
+/// are costed as local ones.
 int EpiphanyTTIImpl::getMemoryOpCost(unsigned Opcode, Type *Src, unsigned Alignment,
-    unsigned AddressSpace) { return 1; }
+    unsigned AddressSpace) {
+  std::pair<int, MVT> LT = TLI->getTypeLegalizationCost(DL, Src);
+  int Cost = Opcode == Instruction::Load ? 2 : 1;
+  if (LT.second.getStoreSize() == 8 && Alignment && Alignment < 8) {
+    Cost *= 2;
+  }
+  return LT.first * Cost;
+}
+
+/// No masked or gather/scatter accesses, scalarized by the base implementation
 int EpiphanyTTIImpl::getMaskedMemoryOpCost(unsigned Opcode, Type *Src, unsigned Alignment,
-    unsigned AddressSpace) { return 1; }
+    unsigned AddressSpace) {
+  return BaseT::getMaskedMemoryOpCost(Opcode, Src, Alignment, AddressSpace);
+}
+
 int EpiphanyTTIImpl::getGatherScatterOpCost(unsigned Opcode, Type *DataTy, Value *Ptr,
-    bool VariableMask, unsigned Alignment) { return 1; }
+    bool VariableMask, unsigned Alignment) {
+  return BaseT::getGatherScatterOpCost(Opcode, DataTy, Ptr, VariableMask, Alignment);
+}
+
+/// Base plus displacement or index is folded into the access
 int EpiphanyTTIImpl::getAddressComputationCost(Type *PtrTy, ScalarEvolution *SE,
-    const SCEV *Ptr) { return 1; }
-unsigned EpiphanyTTIImpl::getCFInstrCost(unsigned Opcode) { return 1; }
+    const SCEV *Ptr) {
+  return PtrTy->isVectorTy() ? 10 : 0;
+}
 
+/// Taken branches flush the fetched instructions
+unsigned EpiphanyTTIImpl::getCFInstrCost(unsigned Opcode) {
+  return Opcode == Instruction::Br ? 3 : BaseT::getCFInstrCost(Opcode);
+}
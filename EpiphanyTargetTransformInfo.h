@@ -34,6 +34,12 @@ class EpiphanyTTIImpl final : public BasicTTIImplBase<EpiphanyTTIImpl> {
 
   const EpiphanySubtarget *ST;
   const EpiphanyTargetLowering *TLI;
+  // Integer division is lowered inline rather than called
+  bool InlineDiv;
+  // FP division is replaced with the reciprocal estimate
+  bool DivEstimates;
+
+  static bool useDivEstimates(const EpiphanyTargetMachine *TM, const Function &F);
 
   const EpiphanySubtarget *getST() const { return ST; }
   const EpiphanyTargetLowering *getTLI() const { return TLI; }
@@ -47,9 +53,11 @@ public:
   explicit EpiphanyTTIImpl(const EpiphanyTargetMachine *TM, const Function &F)
     : BaseT(TM, F.getParent()->getDataLayout()),
       ST(TM->getSubtargetImpl(F)),
-      TLI(ST->getTargetLowering()) {}
+      TLI(ST->getTargetLowering()),
+      InlineDiv(ST->hasInlineDiv() && !F.optForSize()),
+      DivEstimates(useDivEstimates(TM, F)) {}
 
-  bool hasBranchDivergence() { return true; }
+  bool hasBranchDivergence() { return false; }
 
   void getUnrollingPreferences(Loop *L, TTI::UnrollingPreferences &UP);
 
@@ -83,6 +91,7 @@ public:
     ArrayRef<const Value *> Args = ArrayRef<const Value *>());
 
   unsigned getCFInstrCost(unsigned Opcode);
+  unsigned getOperationCost(unsigned Opcode, Type *Ty, Type *OpTy);
 
   unsigned getVectorSplitCost() { return 0; }
 };
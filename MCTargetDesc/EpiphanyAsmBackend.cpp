@@ -21,12 +21,14 @@
 #include "llvm/MC/MCDirectives.h"
 #include "llvm/MC/MCELFObjectWriter.h"
 #include "llvm/MC/MCFixupKindInfo.h"
+#include "llvm/MC/MCInst.h"
 #include "llvm/MC/MCObjectWriter.h"
 #include "llvm/MC/MCSubtargetInfo.h"
 #include "llvm/MC/MCTargetOptions.h"
 #include "llvm/MC/MCValue.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
@@ -152,6 +154,42 @@ getFixupKindInfo(MCFixupKind Kind) const {
 }
 //@getFixupKindInfo }
 
+//@relaxation {
+// Short branches are emitted by the branch selector, it works with the
+// estimated sizes, so the final layout can still push some of them out of
+// reach. These are widened to the 32-bit form with the 24-bit displacement.
+static unsigned getRelaxedOpcode(unsigned Opcode) {
+  switch (Opcode) {
+    default:
+      return Opcode;
+    case Epiphany::BNONE16:
+      return Epiphany::BNONE32;
+    case Epiphany::BCC16:
+      return Epiphany::BCC;
+  }
+}
+
+bool EpiphanyAsmBackend::mayNeedRelaxation(const MCInst &Inst) const {
+  return getRelaxedOpcode(Inst.getOpcode()) != Inst.getOpcode();
+}
+
+bool EpiphanyAsmBackend::fixupNeedsRelaxation(const MCFixup &Fixup, uint64_t Value,
+    const MCRelaxableFragment *DF, const MCAsmLayout &Layout) const {
+  if ((unsigned)Fixup.getKind() != Epiphany::fixup_Epiphany_SIMM8) {
+    return false;
+  }
+  // Displacement is in halfwords
+  return !isInt<9>((int64_t)Value);
+}
+
+void EpiphanyAsmBackend::relaxInstruction(const MCInst &Inst, const MCSubtargetInfo &STI,
+    MCInst &Res) const {
+  DEBUG(dbgs() << "Relaxing short branch\n");
+  Res = Inst;
+  Res.setOpcode(getRelaxedOpcode(Inst.getOpcode()));
+}
+//@relaxation }
+
 /// WriteNopData - Write an (optimal) nop sequence of Count bytes
 /// to the given output. If the target cannot generate such a sequence,
 /// it should return an error.
@@ -63,9 +63,52 @@ namespace EpiphanyII {
     Normal   = 0,
     Pseudo   = 1,
     FormMask = 1,
-    // Size masks - TSFlags bits 1 and 2
-    SizeMask = 6
+    // Size masks - TSFlags bits 1 and 2, log2 of the memory access size
+    SizeShift = 1,
+    SizeMask  = 0x3 << SizeShift,
+
+    // Execution unit - TSFlags bits 3-5
+    UnitShift = 3,
+    UnitMask  = 0x7 << UnitShift,
+    UnitNone  = 0 << UnitShift,
+    UnitIALU  = 1 << UnitShift,
+    UnitIALU2 = 2 << UnitShift,
+    UnitFPU   = 3 << UnitShift,
+    UnitLoad  = 4 << UnitShift,
+    UnitStore = 5 << UnitShift,
+
+    // Memory addressing form - TSFlags bits 6-8
+    AddrModeShift   = 6,
+    AddrModeMask    = 0x7 << AddrModeShift,
+    AddrNone        = 0 << AddrModeShift,
+    AddrDisp        = 1 << AddrModeShift, // [Rn, imm]
+    AddrIndex       = 2 << AddrModeShift, // [Rn, +/-Rm]
+    AddrPostMod     = 3 << AddrModeShift, // [Rn], +/-Rm
+    AddrPostModDisp = 4 << AddrModeShift, // [Rn], imm
+
+    // Word access which can be merged with its neighbour into a dword one - TSFlags bit 9
+    Pairable = 1 << 9
   };
+
+  /// \brief Get the memory access size of the load/store in bytes
+  static inline unsigned getMemSize(uint64_t TSFlags) {
+    return 1 << ((TSFlags & SizeMask) >> SizeShift);
+  }
+
+  /// \brief Get the execution unit of the instruction
+  static inline unsigned getUnit(uint64_t TSFlags) {
+    return TSFlags & UnitMask;
+  }
+
+  /// \brief Get the memory addressing form of the load/store
+  static inline unsigned getAddrMode(uint64_t TSFlags) {
+    return TSFlags & AddrModeMask;
+  }
+
+  /// \brief Check if the load/store can be paired
+  static inline bool isPairable(uint64_t TSFlags) {
+    return TSFlags & Pairable;
+  }
 }
 
 }
@@ -93,6 +93,19 @@ void EpiphanyMCCodeEmitter::encodeInstruction(const MCInst &MI, raw_ostream &OS,
 unsigned EpiphanyMCCodeEmitter::getBranchTargetOpValue(const MCInst &MI, unsigned OpNo,
     SmallVectorImpl<MCFixup> &Fixups,
     const MCSubtargetInfo &STI) const {
+  return getBranchTargetOpValue(MI, OpNo, Fixups, STI, Epiphany::fixup_Epiphany_SIMM24);
+}
+
+/// getBranch8TargetOpValue - Same for the 16-bit branches
+unsigned EpiphanyMCCodeEmitter::getBranch8TargetOpValue(const MCInst &MI, unsigned OpNo,
+    SmallVectorImpl<MCFixup> &Fixups,
+    const MCSubtargetInfo &STI) const {
+  return getBranchTargetOpValue(MI, OpNo, Fixups, STI, Epiphany::fixup_Epiphany_SIMM8);
+}
+
+unsigned EpiphanyMCCodeEmitter::getBranchTargetOpValue(const MCInst &MI, unsigned OpNo,
+    SmallVectorImpl<MCFixup> &Fixups, const MCSubtargetInfo &STI,
+    Epiphany::Fixups Kind) const {
   const MCOperand &MO = MI.getOperand(OpNo);
 
   // If destination is already resolved into immediate - nothing to do
@@ -105,7 +118,7 @@ unsigned EpiphanyMCCodeEmitter::getBranchTargetOpValue(const MCInst &MI, unsigne
   assert(MO.isExpr() && "Strange MO in getJumpTargetOpValue");
   const MCExpr *Expr = MO.getExpr();
   // Get fixup kind and info, then create new fixup
-  MCFixupKind FixupKind = MCFixupKind(Epiphany::fixup_Epiphany_SIMM24);
+  MCFixupKind FixupKind = MCFixupKind(Kind);
   Fixups.push_back(MCFixup::create(0, Expr, FixupKind));
   return 0;
 }
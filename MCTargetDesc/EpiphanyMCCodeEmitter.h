@@ -17,6 +17,7 @@
 
 #include "EpiphanyConfig.h"
 
+#include "MCTargetDesc/EpiphanyFixupKinds.h"
 #include "llvm/MC/MCCodeEmitter.h"
 #include "llvm/Support/DataTypes.h"
 
@@ -65,6 +66,12 @@ namespace llvm {
     unsigned getBranchTargetOpValue(const MCInst &MI, unsigned OpNo,
         SmallVectorImpl<MCFixup> &Fixups,
         const MCSubtargetInfo &STI) const;
+    unsigned getBranch8TargetOpValue(const MCInst &MI, unsigned OpNo,
+        SmallVectorImpl<MCFixup> &Fixups,
+        const MCSubtargetInfo &STI) const;
+    unsigned getBranchTargetOpValue(const MCInst &MI, unsigned OpNo,
+        SmallVectorImpl<MCFixup> &Fixups, const MCSubtargetInfo &STI,
+        Epiphany::Fixups Kind) const;
 
     // getJumpTargetOpValue - Return binary encoding of the jump
     // target operand, such as JSUB #function_addr. 
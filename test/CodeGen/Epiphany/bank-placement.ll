@@ -0,0 +1,38 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -pass-remarks=epiphany-bank-placement \
+; RUN:   -pass-remarks-missed=epiphany-bank-placement < %s 2>%t | FileCheck %s
+; RUN: FileCheck %s --check-prefix=REMARK < %t
+
+; Large arrays go into the emptiest bank, small ones and common symbols stay
+; in the default data section.
+; REMARK-DAG: remark: {{.*}} a (4096 bytes) placed into bank 1
+; REMARK-DAG: remark: {{.*}} b (4096 bytes) placed into bank 2
+; REMARK-DAG: remark: {{.*}} c (2048 bytes) is a common symbol and stays in the default bank
+; REMARK-NOT: small
+
+; CHECK: .section .data_bank1
+; CHECK: a:
+; CHECK: .section .data_bank2
+; CHECK: b:
+; CHECK-NOT: .section .data_bank
+; CHECK: small:
+
+@a = global [1024 x i32] zeroinitializer, align 4
+@b = global [1024 x i32] zeroinitializer, align 4
+@c = common global [512 x i32] zeroinitializer, align 4
+@small = global [16 x i32] zeroinitializer, align 4
+
+define i32 @sum(i32 %i) {
+entry:
+  %pa = getelementptr inbounds [1024 x i32], [1024 x i32]* @a, i32 0, i32 %i
+  %pb = getelementptr inbounds [1024 x i32], [1024 x i32]* @b, i32 0, i32 %i
+  %pc = getelementptr inbounds [512 x i32], [512 x i32]* @c, i32 0, i32 %i
+  %ps = getelementptr inbounds [16 x i32], [16 x i32]* @small, i32 0, i32 %i
+  %va = load i32, i32* %pa, align 4
+  %vb = load i32, i32* %pb, align 4
+  %vc = load i32, i32* %pc, align 4
+  %vs = load i32, i32* %ps, align 4
+  %ab = add i32 %va, %vb
+  %cs = add i32 %vc, %vs
+  %r = add i32 %ab, %cs
+  ret i32 %r
+}
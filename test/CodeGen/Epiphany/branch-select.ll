@@ -0,0 +1,48 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -print-machineinstrs < %s 2>&1 | FileCheck %s
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -epiphany-short-branches=false -print-machineinstrs < %s 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=LONG
+
+; Branches start in the 16-bit form, the ones whose target may be more than
+; 256 bytes away are widened back.
+; CHECK-LABEL: # After Epiphany branch selector
+; CHECK-LABEL: Machine code for function near:
+; CHECK: BCC16
+; CHECK-NOT: BCC{{ }}
+; CHECK-LABEL: End machine code for function near.
+; LONG-LABEL: Machine code for function near:
+; LONG-NOT: BCC16
+; LONG-LABEL: End machine code for function near.
+define i32 @near(i32 %a, i32 %b) {
+entry:
+  %c = icmp eq i32 %a, 0
+  br i1 %c, label %then, label %exit
+
+then:
+  %s = add i32 %b, 5
+  br label %exit
+
+exit:
+  %r = phi i32 [ %b, %entry ], [ %s, %then ]
+  ret i32 %r
+}
+
+; A hundred instructions of inline asm are up to 400 bytes.
+; CHECK-LABEL: # After Epiphany branch selector
+; CHECK-LABEL: Machine code for function far:
+; CHECK: BCC{{ }}
+; CHECK-NOT: BCC16
+; CHECK-LABEL: End machine code for function far.
+define i32 @far(i32 %a, i32 %b) {
+entry:
+  %c = icmp eq i32 %a, 0
+  br i1 %c, label %then, label %exit
+
+then:
+  call void asm sideeffect "nop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop\0Anop", ""()
+  %s = add i32 %b, 5
+  br label %exit
+
+exit:
+  %r = phi i32 [ %b, %entry ], [ %s, %then ]
+  ret i32 %r
+}
@@ -0,0 +1,59 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 < %s | FileCheck %s
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -mattr=+long-calls < %s | FileCheck %s --check-prefix=LONG
+
+; Only callees defined here and placed next to the caller are called with BL,
+; anything else may be out of its range.
+
+define i32 @local(i32 %a) noinline {
+entry:
+  %r = add i32 %a, 1
+  ret i32 %r
+}
+
+define weak i32 @weak_local(i32 %a) noinline {
+entry:
+  %r = add i32 %a, 2
+  ret i32 %r
+}
+
+define i32 @in_bank(i32 %a) noinline section ".text_bank1" {
+entry:
+  %r = add i32 %a, 3
+  ret i32 %r
+}
+
+declare i32 @external(i32)
+declare i32 @external_short(i32) #0
+
+; CHECK-LABEL: caller:
+; CHECK-DAG: bl local
+; CHECK-DAG: mov {{r[0-9]+}}, %low(weak_local)
+; CHECK-DAG: mov {{r[0-9]+}}, %low(in_bank)
+; CHECK-DAG: mov {{r[0-9]+}}, %low(external)
+; CHECK-DAG: bl external_short
+; CHECK-DAG: mov {{r[0-9]+}}, %low(__udivsi3)
+; CHECK: jr lr
+; LONG-LABEL: caller:
+; LONG-NOT: bl local
+; LONG: jr lr
+define i32 @caller(i32 %a, i32 %b) {
+entry:
+  %r1 = call i32 @local(i32 %a)
+  %r2 = call i32 @weak_local(i32 %r1)
+  %r3 = call i32 @in_bank(i32 %r2)
+  %r4 = call i32 @external(i32 %r3)
+  %r5 = call i32 @external_short(i32 %r4)
+  %r6 = udiv i32 %r5, %b
+  ret i32 %r6
+}
+
+; Both halves in the local memory banks are always in range.
+; CHECK-LABEL: bank_caller:
+; CHECK: bl in_bank
+define i32 @bank_caller(i32 %a) section ".text_bank2" {
+entry:
+  %r = call i32 @in_bank(i32 %a)
+  ret i32 %r
+}
+
+attributes #0 = { "short-call" }
@@ -0,0 +1,41 @@
+; RUN: opt -mtriple=epiphany -mcpu=E16 -cost-model -analyze < %s | FileCheck %s --check-prefix=CALL
+; RUN: opt -mtriple=epiphany -mcpu=E16 -mattr=+inline-div -cost-model -analyze < %s | FileCheck %s --check-prefix=INLINE
+; RUN: opt -mtriple=epiphany -mcpu=E16 -enable-unsafe-fp-math -cost-model -analyze < %s | FileCheck %s --check-prefix=FAST
+
+; Division costs follow the lowering: libcalls by default, the inline FPU
+; sequence with inline-div, and the reciprocal estimate with unsafe FP math.
+; CALL-LABEL: 'div'
+; CALL: cost of 40 {{.*}} sdiv i32
+; CALL: cost of 35 {{.*}} udiv i32
+; CALL: cost of 50 {{.*}} fdiv float
+; INLINE-LABEL: 'div'
+; INLINE: cost of 36 {{.*}} sdiv i32
+; INLINE: cost of 32 {{.*}} udiv i32
+; INLINE: cost of 50 {{.*}} fdiv float
+; FAST-LABEL: 'div'
+; FAST: cost of 40 {{.*}} sdiv i32
+; FAST: cost of 35 {{.*}} udiv i32
+; FAST: cost of 15 {{.*}} fdiv float
+define void @div(i32 %a, i32 %b, float %x, float %y) {
+  %s = sdiv i32 %a, %b
+  %u = udiv i32 %a, %b
+  %f = fdiv float %x, %y
+  ret void
+}
+
+; Size optimized functions keep the libcalls, estimates can be disabled.
+; INLINE-LABEL: 'div_size'
+; INLINE: cost of 35 {{.*}} udiv i32
+; FAST-LABEL: 'div_noest'
+; FAST: cost of 50 {{.*}} fdiv float
+define void @div_size(i32 %a, i32 %b) optsize {
+  %u = udiv i32 %a, %b
+  ret void
+}
+
+define void @div_noest(float %x, float %y) #0 {
+  %f = fdiv float %x, %y
+  ret void
+}
+
+attributes #0 = { "reciprocal-estimates"="!divf" }
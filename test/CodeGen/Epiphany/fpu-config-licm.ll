@@ -0,0 +1,48 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -epiphany-hwloops=false < %s | FileCheck %s
+
+; The CONFIG use is added after MachineLICM and MachineCSE, so FPU
+; instructions can be hoisted out of loops and merged like any other.
+
+; CHECK-LABEL: hoist:
+; CHECK: fmul [[AB:r[0-9]+]],
+; CHECK: Inner Loop Header
+; CHECK: fmul {{.*}}[[AB]]
+; CHECK-NOT: fmul
+; CHECK: jr lr
+define void @hoist(float* %p, float %a, float %b, i32 %n) {
+entry:
+  br label %body
+
+body:
+  %i = phi i32 [ 0, %entry ], [ %inc, %body ]
+  %addr = getelementptr inbounds float, float* %p, i32 %i
+  %v = load float, float* %addr, align 4
+  %ab = fmul float %a, %b
+  %r = fmul float %v, %ab
+  store float %r, float* %addr, align 4
+  %inc = add i32 %i, 1
+  %done = icmp eq i32 %inc, %n
+  br i1 %done, label %exit, label %body
+
+exit:
+  ret void
+}
+
+; CHECK-LABEL: cse:
+; CHECK: fmul
+; CHECK-NOT: fmul
+; CHECK: jr lr
+define float @cse(float %a, float %b, i32 %c, float* %p) {
+entry:
+  %m1 = fmul float %a, %b
+  %cmp = icmp eq i32 %c, 0
+  br i1 %cmp, label %exit, label %then
+
+then:
+  %m2 = fmul float %a, %b
+  store float %m2, float* %p, align 4
+  br label %exit
+
+exit:
+  ret float %m1
+}
@@ -0,0 +1,48 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -mattr=+inline-div -print-after=epiphany-fpu-mode \
+; RUN:   -o /dev/null < %s 2>&1 | FileCheck %s
+
+; Division by a constant is an IMUL-based multiply, so it runs in IALU2 mode.
+; CHECK: define internal i32 @div_by_const(i32 %x) #[[IALU2:[0-9]+]]
+define internal i32 @div_by_const(i32 %x) {
+  %q = udiv i32 %x, 10
+  ret i32 %q
+}
+
+define i32 @ialu2_caller(i32 %x, i32 %y) {
+  %m = mul i32 %x, %y
+  %q = call i32 @div_by_const(i32 %m)
+  ret i32 %q
+}
+
+; Inline division needs both modes, so its caller can't pass the FPU mode.
+; CHECK: define internal float @fpu_helper(float %a, float %b) {
+define internal float @fpu_helper(float %a, float %b) {
+  %s = fadd float %a, %b
+  ret float %s
+}
+
+define float @mixed_caller(float %a, float %b, i32 %x, i32 %y) {
+  %d = sdiv i32 %x, %y
+  %f = sitofp i32 %d to float
+  %s = fadd float %a, %f
+  %r = call float @fpu_helper(float %s, float %b)
+  ret float %r
+}
+
+; f32 division is a Newton-Raphson sequence with unsafe FP math.
+; CHECK: define internal float @recip(float %a) #[[FPU:[0-9]+]]
+define internal float @recip(float %a) #0 {
+  %r = fdiv float 1.000000e+00, %a
+  ret float %r
+}
+
+define float @fpu_caller(float %a, float %b) #0 {
+  %s = fmul float %a, %b
+  %r = call float @recip(float %s)
+  ret float %r
+}
+
+attributes #0 = { "unsafe-fp-math"="true" }
+
+; CHECK-DAG: attributes #[[IALU2]] = { "epiphany-fpu-mode"="ialu2" }
+; CHECK-DAG: attributes #[[FPU]] = { "epiphany-fpu-mode"="fpu" "unsafe-fp-math"="true" }
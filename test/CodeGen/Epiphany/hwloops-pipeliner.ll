@@ -0,0 +1,38 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 < %s | FileCheck %s
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -debug-only=pipeliner < %s 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=SWP
+; REQUIRES: asserts
+
+; The pipeliner sees the loop end as an analyzable branch, later branch
+; passes don't, so the kernel stays a single block ending at LE.
+
+; SWP: Schedule Found? 1
+
+; CHECK-LABEL: axpy:
+; CHECK: movts lc,
+; CHECK: movts ls,
+; CHECK: movts le,
+; CHECK: {{fmadd|fadd}}
+; CHECK-NOT: bne
+; CHECK: jr lr
+define void @axpy(float* noalias %x, float* noalias %y, float %a) {
+entry:
+  br label %body
+
+body:
+  %i = phi i32 [ 0, %entry ], [ %inc, %body ]
+  %px = getelementptr inbounds float, float* %x, i32 %i
+  %py = getelementptr inbounds float, float* %y, i32 %i
+  %vx = load float, float* %px, align 4
+  %vy = load float, float* %py, align 4
+  %m = call float @llvm.fmuladd.f32(float %a, float %vx, float %vy)
+  store float %m, float* %py, align 4
+  %inc = add nuw nsw i32 %i, 1
+  %done = icmp eq i32 %inc, 64
+  br i1 %done, label %exit, label %body
+
+exit:
+  ret void
+}
+
+declare float @llvm.fmuladd.f32(float, float, float)
@@ -0,0 +1,68 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -epiphany-pipeliner=false < %s | FileCheck %s
+
+; Runtime trip count behind the rotated loop guard, the count can't be zero.
+; CHECK-LABEL: guarded:
+; CHECK: movts lc,
+; CHECK: movts ls,
+; CHECK: movts le,
+; CHECK-NOT: bne
+define void @guarded(i32* %p, i32 %n) {
+entry:
+  %empty = icmp eq i32 %n, 0
+  br i1 %empty, label %exit, label %preheader
+
+preheader:
+  br label %body
+
+body:
+  %i = phi i32 [ 0, %preheader ], [ %inc, %body ]
+  %addr = getelementptr inbounds i32, i32* %p, i32 %i
+  store i32 0, i32* %addr, align 4
+  %inc = add nuw i32 %i, 1
+  %done = icmp eq i32 %inc, %n
+  br i1 %done, label %exit, label %body
+
+exit:
+  ret void
+}
+
+; Nothing proves that %n is not zero, which would need 2^32 iterations.
+; CHECK-LABEL: unguarded:
+; CHECK-NOT: movts lc,
+; CHECK: b{{ne|eq}}
+define void @unguarded(i32* %p, i32 %n) {
+entry:
+  br label %body
+
+body:
+  %i = phi i32 [ 0, %entry ], [ %inc, %body ]
+  %addr = getelementptr inbounds i32, i32* %p, i32 %i
+  store i32 0, i32* %addr, align 4
+  %inc = add i32 %i, 1
+  %done = icmp eq i32 %inc, %n
+  br i1 %done, label %exit, label %body
+
+exit:
+  ret void
+}
+
+; Constant trip count needs no guard.
+; CHECK-LABEL: constant:
+; CHECK: mov [[COUNT:r[0-9]+]], #100
+; CHECK: movts lc, [[COUNT]]
+; CHECK-NOT: bne
+define void @constant(i32* %p) {
+entry:
+  br label %body
+
+body:
+  %i = phi i32 [ 0, %entry ], [ %inc, %body ]
+  %addr = getelementptr inbounds i32, i32* %p, i32 %i
+  store i32 0, i32* %addr, align 4
+  %inc = add nuw nsw i32 %i, 1
+  %done = icmp eq i32 %inc, 100
+  br i1 %done, label %exit, label %body
+
+exit:
+  ret void
+}
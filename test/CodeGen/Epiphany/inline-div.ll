@@ -0,0 +1,68 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -mattr=+inline-div < %s | FileCheck %s --check-prefix=INLINE
+; RUN: llc -march=epiphany -mcpu=E16 -O2 < %s | FileCheck %s --check-prefix=CALL
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -mattr=+inline-div < %s | FileCheck %s --check-prefix=CONFIG
+
+; The quotient is estimated in the FPU and corrected with integer ops.
+; INLINE-LABEL: udiv:
+; INLINE: float
+; INLINE: fix
+; INLINE-NOT: __udivsi3
+; INLINE: jr lr
+; CALL-LABEL: udiv:
+; CALL: __udivsi3
+; The FPU estimates alternate with the IMUL remainders, four mode switches
+; and the restore of the caller's CONFIG.
+; CONFIG-LABEL: udiv:
+; CONFIG: movts config,
+; CONFIG: float
+; CONFIG: movts config,
+; CONFIG: imul
+; CONFIG: movts config,
+; CONFIG: fix
+; CONFIG: movts config,
+; CONFIG: imul
+; CONFIG: movts config,
+; CONFIG-NOT: movts config,
+; CONFIG: jr lr
+define i32 @udiv(i32 %a, i32 %b) {
+entry:
+  %r = udiv i32 %a, %b
+  ret i32 %r
+}
+
+; INLINE-LABEL: srem:
+; INLINE: float
+; INLINE: fix
+; INLINE-NOT: __modsi3
+; INLINE: jr lr
+; CALL-LABEL: srem:
+; CALL: __modsi3
+define i32 @srem(i32 %a, i32 %b) {
+entry:
+  %r = srem i32 %a, %b
+  ret i32 %r
+}
+
+; Division and remainder of the same operands share one sequence, with its
+; two quotient estimates.
+; INLINE-LABEL: divrem:
+; INLINE: fix
+; INLINE: fix
+; INLINE-NOT: fix
+; INLINE: jr lr
+define i32 @divrem(i32 %a, i32 %b) {
+entry:
+  %q = udiv i32 %a, %b
+  %m = urem i32 %a, %b
+  %r = xor i32 %q, %m
+  ret i32 %r
+}
+
+; The call is smaller.
+; INLINE-LABEL: udiv_size:
+; INLINE: __udivsi3
+define i32 @udiv_size(i32 %a, i32 %b) optsize {
+entry:
+  %r = udiv i32 %a, %b
+  ret i32 %r
+}
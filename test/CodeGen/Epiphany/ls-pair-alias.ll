@@ -0,0 +1,70 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -epiphany-hwloops=false < %s | FileCheck %s
+
+@x = global [64 x i32] zeroinitializer, align 8
+@y = global [64 x i32] zeroinitializer, align 8
+
+; Struct-of-arrays kernel, stores to one global don't block pairing the
+; loads from the other.
+; CHECK-LABEL: soa:
+; CHECK: ldrd
+; CHECK: strd
+define void @soa() {
+entry:
+  %x0 = getelementptr inbounds [64 x i32], [64 x i32]* @x, i32 0, i32 0
+  %x1 = getelementptr inbounds [64 x i32], [64 x i32]* @x, i32 0, i32 1
+  %y0 = getelementptr inbounds [64 x i32], [64 x i32]* @y, i32 0, i32 0
+  %y1 = getelementptr inbounds [64 x i32], [64 x i32]* @y, i32 0, i32 1
+  %a = load i32, i32* %x0, align 8
+  %a2 = shl i32 %a, 1
+  store i32 %a2, i32* %y0, align 8
+  %b = load i32, i32* %x1, align 4
+  %b2 = shl i32 %b, 1
+  store i32 %b2, i32* %y1, align 4
+  ret void
+}
+
+; Same base with non-overlapping offsets.
+; CHECK-LABEL: same_base:
+; CHECK: ldrd
+define i32 @same_base(i32* %p) {
+entry:
+  %p1 = getelementptr inbounds i32, i32* %p, i32 1
+  %p4 = getelementptr inbounds i32, i32* %p, i32 4
+  %a = load i32, i32* %p, align 8
+  store i32 %a, i32* %p4, align 4
+  %b = load i32, i32* %p1, align 4
+  %r = add i32 %a, %b
+  ret i32 %r
+}
+
+; Local array and a global are distinct objects.
+; CHECK-LABEL: frame:
+; CHECK: ldrd
+define i32 @frame(i32 %i) {
+entry:
+  %buf = alloca [4 x i32], align 8
+  %b0 = getelementptr inbounds [4 x i32], [4 x i32]* %buf, i32 0, i32 0
+  %b1 = getelementptr inbounds [4 x i32], [4 x i32]* %buf, i32 0, i32 1
+  %bi = getelementptr inbounds [4 x i32], [4 x i32]* %buf, i32 0, i32 %i
+  %xi = getelementptr inbounds [64 x i32], [64 x i32]* @x, i32 0, i32 %i
+  store volatile i32 %i, i32* %bi, align 4
+  %a = load i32, i32* %b0, align 8
+  store i32 %a, i32* %xi, align 4
+  %b = load i32, i32* %b1, align 4
+  %r = add i32 %a, %b
+  ret i32 %r
+}
+
+; Store through an unknown pointer may hit the second word.
+; CHECK-LABEL: may_alias:
+; CHECK-NOT: ldrd
+; CHECK: jr lr
+define i32 @may_alias(i32* %p, i32* %q) {
+entry:
+  %p1 = getelementptr inbounds i32, i32* %p, i32 1
+  %a = load i32, i32* %p, align 8
+  store i32 %a, i32* %q, align 4
+  %b = load i32, i32* %p1, align 4
+  %r = add i32 %a, %b
+  ret i32 %r
+}
@@ -0,0 +1,26 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -debug-only=epiphany_ls_opt < %s 2>&1 | FileCheck %s
+; REQUIRES: asserts
+
+; Stores are not moved across blocks, so the pair can't be merged. The stored
+; values are hinted into an even/odd register pair instead, which the
+; allocator follows.
+; CHECK-LABEL: Running Epiphany Load/Store Optimization Pass (pre-RA)
+; CHECK: Hinting {{%vreg[0-9]+}} and {{%vreg[0-9]+}} into a register pair
+; CHECK-LABEL: split:
+; CHECK: str r{{[0-9]*[02468]}}, [r0, #0]
+; CHECK: str r{{[0-9]*[13579]}}, [r0, #1]
+define void @split(i32* %p, i32 %x, i32 %y, i1 %c) {
+entry:
+  %a = add i32 %x, 1
+  %b = add i32 %y, 2
+  store i32 %a, i32* %p, align 8
+  br i1 %c, label %then, label %exit
+
+then:
+  %p1 = getelementptr inbounds i32, i32* %p, i32 1
+  store i32 %b, i32* %p1, align 4
+  br label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,21 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -stop-after=post-RA-sched < %s | FileCheck %s
+
+; Two word slots are merged into one dword slot. The later accesses to the
+; second word must point at the merged slot, memory operands included, so
+; the scheduler doesn't see a removed object.
+; CHECK-LABEL: name: slots
+; CHECK: STRi64 {{.*}}(store 8 into %stack.[[FI:[0-9]+]]
+; CHECK-NOT: %stack.{{[0-9]+}}.b
+; CHECK: LDR{{.*}}(volatile load 4 from %stack.[[FI]].{{[a-z]+}} + 4)
+; CHECK: LDR{{.*}}(volatile load 4 from %stack.[[FI]].{{[a-z]+}})
+define i32 @slots(i32 %x, i32 %y) {
+entry:
+  %a = alloca i32, align 4
+  %b = alloca i32, align 4
+  store i32 %x, i32* %a, align 4
+  store i32 %y, i32* %b, align 4
+  %lb = load volatile i32, i32* %b, align 4
+  %la = load volatile i32, i32* %a, align 4
+  %r = sub i32 %la, %lb
+  ret i32 %r
+}
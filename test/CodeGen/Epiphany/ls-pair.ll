@@ -0,0 +1,80 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -epiphany-hwloops=false < %s | FileCheck %s
+
+; Adjacent words of a dword aligned pointer are accessed with one instruction.
+; CHECK-LABEL: copy:
+; CHECK: ldrd
+; CHECK: strd
+; CHECK-NOT: ldr {{.*}}[r0
+define void @copy(i32* %dst, i32* %src) {
+entry:
+  %src1 = getelementptr inbounds i32, i32* %src, i32 1
+  %dst1 = getelementptr inbounds i32, i32* %dst, i32 1
+  %a = load i32, i32* %src, align 8
+  %b = load i32, i32* %src1, align 4
+  store i32 %a, i32* %dst, align 8
+  store i32 %b, i32* %dst1, align 4
+  ret void
+}
+
+; Accesses far apart in the block are still paired, the index is not limited
+; to a window of instructions.
+; CHECK-LABEL: far:
+; CHECK: ldrd
+; CHECK-NOT: ldr {{r[0-9]+}}, [r0
+; CHECK: jr lr
+define i32 @far(i32* %p, i32 %x) {
+entry:
+  %p1 = getelementptr inbounds i32, i32* %p, i32 1
+  %a = load i32, i32* %p, align 8
+  %m0 = mul i32 %x, %a
+  %m1 = xor i32 %m0, %x
+  %m2 = add i32 %m1, 17
+  %m3 = mul i32 %m2, %m1
+  %m4 = sub i32 %m3, %m0
+  %m5 = or i32 %m4, 3
+  %m6 = mul i32 %m5, %m4
+  %m7 = add i32 %m6, %m2
+  %m8 = xor i32 %m7, %m5
+  %m9 = mul i32 %m8, %m7
+  %m10 = add i32 %m9, %m3
+  %m11 = xor i32 %m10, %m6
+  %m12 = mul i32 %m11, %m10
+  %b = load i32, i32* %p1, align 4
+  %r = add i32 %m12, %b
+  ret i32 %r
+}
+
+; The second load only runs on one path, but the other half of an aligned
+; dword can be loaded on all of them.
+; CHECK-LABEL: cross_block:
+; CHECK: ldrd
+; CHECK-NOT: ldr {{r[0-9]+}}, [r0
+; CHECK: jr lr
+define i32 @cross_block(i32* %p, i1 %c) {
+entry:
+  %a = load i32, i32* %p, align 8
+  br i1 %c, label %then, label %exit
+
+then:
+  %p1 = getelementptr inbounds i32, i32* %p, i32 1
+  %b = load i32, i32* %p1, align 4
+  %s = add i32 %a, %b
+  br label %exit
+
+exit:
+  %r = phi i32 [ %a, %entry ], [ %s, %then ]
+  ret i32 %r
+}
+
+; Alignment of the pointer is unknown, so no pair.
+; CHECK-LABEL: unaligned:
+; CHECK-NOT: ldrd
+; CHECK: jr lr
+define i32 @unaligned(i32* %p) {
+entry:
+  %p1 = getelementptr inbounds i32, i32* %p, i32 1
+  %a = load i32, i32* %p, align 4
+  %b = load i32, i32* %p1, align 4
+  %r = add i32 %a, %b
+  ret i32 %r
+}
@@ -0,0 +1,52 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 < %s | FileCheck %s
+
+; 64-bit product and the high half of 32-bit ones are built from IMUL
+; partial products, with no library calls.
+; CHECK-LABEL: mul64:
+; CHECK: imul
+; CHECK-NOT: __muldi3
+; CHECK: jr lr
+define i64 @mul64(i64 %a, i64 %b) {
+entry:
+  %r = mul i64 %a, %b
+  ret i64 %r
+}
+
+; CHECK-LABEL: mulhu:
+; CHECK: imul
+; CHECK-NOT: __muldi3
+; CHECK: jr lr
+define i32 @mulhu(i32 %a, i32 %b) {
+entry:
+  %a64 = zext i32 %a to i64
+  %b64 = zext i32 %b to i64
+  %p = mul i64 %a64, %b64
+  %h = lshr i64 %p, 32
+  %r = trunc i64 %h to i32
+  ret i32 %r
+}
+
+; CHECK-LABEL: mulhs:
+; CHECK: imul
+; CHECK-NOT: __muldi3
+; CHECK: jr lr
+define i32 @mulhs(i32 %a, i32 %b) {
+entry:
+  %a64 = sext i32 %a to i64
+  %b64 = sext i32 %b to i64
+  %p = mul i64 %a64, %b64
+  %h = ashr i64 %p, 32
+  %r = trunc i64 %h to i32
+  ret i32 %r
+}
+
+; Division by a constant becomes a multiply by the magic number.
+; CHECK-LABEL: div7:
+; CHECK: imul
+; CHECK-NOT: __udivsi3
+; CHECK: jr lr
+define i32 @div7(i32 %a) {
+entry:
+  %r = udiv i32 %a, 7
+  ret i32 %r
+}
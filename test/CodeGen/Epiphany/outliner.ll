@@ -0,0 +1,170 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -pass-remarks=epiphany_outliner < %s 2>%t | FileCheck %s
+; RUN: FileCheck %s --check-prefix=REMARK < %t
+
+; The same arithmetic follows each call, it is moved into a shared block
+; called with BL. Debug values in between don't change the result.
+; CHECK-LABEL: plain:
+; CHECK: bl .Loutlined{{[0-9]+}}
+; CHECK: bl .Loutlined{{[0-9]+}}
+; CHECK: .Loutlined{{[0-9]+}}:
+; CHECK: jr lr
+; CHECK-LABEL: dbg:
+; CHECK: bl .Loutlined{{[0-9]+}}
+; CHECK: bl .Loutlined{{[0-9]+}}
+; CHECK: .Loutlined{{[0-9]+}}:
+; CHECK: jr lr
+; CHECK-LABEL: fast:
+; CHECK-NOT: .Loutlined
+; CHECK: .Lfunc_end
+
+; REMARK: remark: <unknown>:0:0: outlined {{[0-9]+}} instructions ({{[0-9]+}} bytes) from {{[0-9]+}} places, saving about {{[0-9]+}} bytes
+; REMARK: remark: <unknown>:0:0: outlining saved about [[SAVED:[0-9]+]] bytes in plain
+; REMARK: remark: t.c:2:1: outlined {{[0-9]+}} instructions
+; REMARK: remark: <unknown>:0:0: outlining saved about [[SAVED]] bytes in dbg
+; REMARK-NOT: bytes in fast
+; REMARK: outlining saved about {{[0-9]+}} bytes in the module
+
+declare i32 @f(i32)
+declare void @llvm.dbg.value(metadata, i64, metadata, metadata)
+
+define i32 @plain(i32 %a) optsize {
+entry:
+  %x0 = call i32 @f(i32 %a)
+  %t0_0 = mul i32 %x0, %x0
+  %t0_1 = xor i32 %t0_0, %x0
+  %t0_2 = add i32 %t0_1, %x0
+  %t0_3 = mul i32 %t0_2, %x0
+  %t0_4 = sub i32 %t0_3, %x0
+  %t0_5 = xor i32 %t0_4, %x0
+  %t0_6 = mul i32 %t0_5, %x0
+  %t0_7 = add i32 %t0_6, %x0
+  %x1 = call i32 @f(i32 %t0_7)
+  %t1_0 = mul i32 %x1, %x1
+  %t1_1 = xor i32 %t1_0, %x1
+  %t1_2 = add i32 %t1_1, %x1
+  %t1_3 = mul i32 %t1_2, %x1
+  %t1_4 = sub i32 %t1_3, %x1
+  %t1_5 = xor i32 %t1_4, %x1
+  %t1_6 = mul i32 %t1_5, %x1
+  %t1_7 = add i32 %t1_6, %x1
+  %x2 = call i32 @f(i32 %t1_7)
+  %t2_0 = mul i32 %x2, %x2
+  %t2_1 = xor i32 %t2_0, %x2
+  %t2_2 = add i32 %t2_1, %x2
+  %t2_3 = mul i32 %t2_2, %x2
+  %t2_4 = sub i32 %t2_3, %x2
+  %t2_5 = xor i32 %t2_4, %x2
+  %t2_6 = mul i32 %t2_5, %x2
+  %t2_7 = add i32 %t2_6, %x2
+  %x3 = call i32 @f(i32 %t2_7)
+  %t3_0 = mul i32 %x3, %x3
+  %t3_1 = xor i32 %t3_0, %x3
+  %t3_2 = add i32 %t3_1, %x3
+  %t3_3 = mul i32 %t3_2, %x3
+  %t3_4 = sub i32 %t3_3, %x3
+  %t3_5 = xor i32 %t3_4, %x3
+  %t3_6 = mul i32 %t3_5, %x3
+  %t3_7 = add i32 %t3_6, %x3
+  ret i32 %t3_7
+}
+
+define i32 @dbg(i32 %a) optsize !dbg !5 {
+entry:
+  %x0 = call i32 @f(i32 %a), !dbg !9
+  %t0_0 = mul i32 %x0, %x0
+  %t0_1 = xor i32 %t0_0, %x0
+  %t0_2 = add i32 %t0_1, %x0
+  %t0_3 = mul i32 %t0_2, %x0
+  call void @llvm.dbg.value(metadata i32 %t0_3, i64 0, metadata !7, metadata !DIExpression()), !dbg !9
+  %t0_4 = sub i32 %t0_3, %x0
+  %t0_5 = xor i32 %t0_4, %x0
+  %t0_6 = mul i32 %t0_5, %x0
+  %t0_7 = add i32 %t0_6, %x0
+  %x1 = call i32 @f(i32 %t0_7), !dbg !9
+  %t1_0 = mul i32 %x1, %x1
+  %t1_1 = xor i32 %t1_0, %x1
+  %t1_2 = add i32 %t1_1, %x1
+  %t1_3 = mul i32 %t1_2, %x1
+  call void @llvm.dbg.value(metadata i32 %t1_3, i64 0, metadata !7, metadata !DIExpression()), !dbg !9
+  %t1_4 = sub i32 %t1_3, %x1
+  %t1_5 = xor i32 %t1_4, %x1
+  %t1_6 = mul i32 %t1_5, %x1
+  %t1_7 = add i32 %t1_6, %x1
+  %x2 = call i32 @f(i32 %t1_7), !dbg !9
+  %t2_0 = mul i32 %x2, %x2
+  %t2_1 = xor i32 %t2_0, %x2
+  %t2_2 = add i32 %t2_1, %x2
+  %t2_3 = mul i32 %t2_2, %x2
+  call void @llvm.dbg.value(metadata i32 %t2_3, i64 0, metadata !7, metadata !DIExpression()), !dbg !9
+  %t2_4 = sub i32 %t2_3, %x2
+  %t2_5 = xor i32 %t2_4, %x2
+  %t2_6 = mul i32 %t2_5, %x2
+  %t2_7 = add i32 %t2_6, %x2
+  %x3 = call i32 @f(i32 %t2_7), !dbg !9
+  %t3_0 = mul i32 %x3, %x3
+  %t3_1 = xor i32 %t3_0, %x3
+  %t3_2 = add i32 %t3_1, %x3
+  %t3_3 = mul i32 %t3_2, %x3
+  call void @llvm.dbg.value(metadata i32 %t3_3, i64 0, metadata !7, metadata !DIExpression()), !dbg !9
+  %t3_4 = sub i32 %t3_3, %x3
+  %t3_5 = xor i32 %t3_4, %x3
+  %t3_6 = mul i32 %t3_5, %x3
+  %t3_7 = add i32 %t3_6, %x3
+  ret i32 %t3_7
+}
+
+; Not optimized for size.
+define i32 @fast(i32 %a) {
+entry:
+  %x0 = call i32 @f(i32 %a)
+  %t0_0 = mul i32 %x0, %x0
+  %t0_1 = xor i32 %t0_0, %x0
+  %t0_2 = add i32 %t0_1, %x0
+  %t0_3 = mul i32 %t0_2, %x0
+  %t0_4 = sub i32 %t0_3, %x0
+  %t0_5 = xor i32 %t0_4, %x0
+  %t0_6 = mul i32 %t0_5, %x0
+  %t0_7 = add i32 %t0_6, %x0
+  %x1 = call i32 @f(i32 %t0_7)
+  %t1_0 = mul i32 %x1, %x1
+  %t1_1 = xor i32 %t1_0, %x1
+  %t1_2 = add i32 %t1_1, %x1
+  %t1_3 = mul i32 %t1_2, %x1
+  %t1_4 = sub i32 %t1_3, %x1
+  %t1_5 = xor i32 %t1_4, %x1
+  %t1_6 = mul i32 %t1_5, %x1
+  %t1_7 = add i32 %t1_6, %x1
+  %x2 = call i32 @f(i32 %t1_7)
+  %t2_0 = mul i32 %x2, %x2
+  %t2_1 = xor i32 %t2_0, %x2
+  %t2_2 = add i32 %t2_1, %x2
+  %t2_3 = mul i32 %t2_2, %x2
+  %t2_4 = sub i32 %t2_3, %x2
+  %t2_5 = xor i32 %t2_4, %x2
+  %t2_6 = mul i32 %t2_5, %x2
+  %t2_7 = add i32 %t2_6, %x2
+  %x3 = call i32 @f(i32 %t2_7)
+  %t3_0 = mul i32 %x3, %x3
+  %t3_1 = xor i32 %t3_0, %x3
+  %t3_2 = add i32 %t3_1, %x3
+  %t3_3 = mul i32 %t3_2, %x3
+  %t3_4 = sub i32 %t3_3, %x3
+  %t3_5 = xor i32 %t3_4, %x3
+  %t3_6 = mul i32 %t3_5, %x3
+  %t3_7 = add i32 %t3_6, %x3
+  ret i32 %t3_7
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!3, !4}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: true, runtimeVersion: 0, emissionKind: FullDebug)
+!1 = !DIFile(filename: "t.c", directory: "/tmp")
+!2 = !{}
+!3 = !{i32 2, !"Dwarf Version", i32 4}
+!4 = !{i32 2, !"Debug Info Version", i32 3}
+!5 = distinct !DISubprogram(name: "dbg", scope: !1, file: !1, line: 1, type: !6, isLocal: false, isDefinition: true, scopeLine: 1, isOptimized: true, unit: !0, variables: !2)
+!6 = !DISubroutineType(types: !2)
+!7 = !DILocalVariable(name: "v", scope: !5, file: !1, line: 2, type: !8)
+!8 = !DIBasicType(name: "int", size: 32, encoding: DW_ATE_signed)
+!9 = !DILocation(line: 2, column: 1, scope: !5)
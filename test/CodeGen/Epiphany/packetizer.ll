@@ -0,0 +1,19 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -debug-only=epiphany_packetizer < %s 2>&1 \
+; RUN:   | FileCheck %s
+; REQUIRES: asserts
+
+; Independent FPU and integer instructions are issued in the same cycle.
+
+; CHECK-LABEL: Running Epiphany packetizer on dual_issue
+; CHECK: Packet formed:
+; CHECK-DAG: FADDrr_r32
+; CHECK-DAG: ADDri_r32
+; CHECK: Packets formed in dual_issue: {{[1-9]}}
+define float @dual_issue(float %a, float %b, i32 %x, i32* %p) {
+entry:
+  %s = fadd float %a, %b
+  %i = add i32 %x, 1
+  store i32 %i, i32* %p, align 4
+  ret float %s
+}
+
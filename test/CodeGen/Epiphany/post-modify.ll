@@ -0,0 +1,62 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -epiphany-hwloops=false < %s | FileCheck %s
+
+; Increment of the base after the access is folded into it.
+; CHECK-LABEL: load_next:
+; CHECK: ldr {{r[0-9]+}}, [r0], #1
+; CHECK-NOT: add r0, r0
+define i32* @load_next(i32* %p, i32* %out) {
+entry:
+  %v = load i32, i32* %p, align 4
+  store i32 %v, i32* %out, align 4
+  %next = getelementptr inbounds i32, i32* %p, i32 1
+  ret i32* %next
+}
+
+; CHECK-LABEL: store_next:
+; CHECK: strh {{r[0-9]+}}, [r0], #2
+; CHECK-NOT: add r0, r0
+define i16* @store_next(i16* %p, i16 %v) {
+entry:
+  store i16 %v, i16* %p, align 2
+  %next = getelementptr inbounds i16, i16* %p, i32 2
+  ret i16* %next
+}
+
+; Register increments use the indexed form.
+; CHECK-LABEL: load_stride:
+; CHECK: ldr {{r[0-9]+}}, [r0],{{r[0-9]+}}
+define i32* @load_stride(i32* %p, i32 %stride, i32* %out) {
+entry:
+  %v = load i32, i32* %p, align 4
+  store i32 %v, i32* %out, align 4
+  %next = getelementptr inbounds i32, i32* %p, i32 %stride
+  ret i32* %next
+}
+
+; Streaming loop, one IALU op per access less.
+; CHECK-LABEL: stream:
+; CHECK: [[LOOP:.LBB[0-9_]+]]:
+; CHECK: ldr {{r[0-9]+}}, [{{r[0-9]+}}], #1
+; CHECK: str {{r[0-9]+}}, [{{r[0-9]+}}], #1
+; CHECK: b{{ne|gtu|ltu}} [[LOOP]]
+define void @stream(i32* %dst, i32* %src, i32 %n) {
+entry:
+  %empty = icmp eq i32 %n, 0
+  br i1 %empty, label %exit, label %body
+
+body:
+  %i = phi i32 [ 0, %entry ], [ %inc, %body ]
+  %s = phi i32* [ %src, %entry ], [ %s.next, %body ]
+  %d = phi i32* [ %dst, %entry ], [ %d.next, %body ]
+  %v = load i32, i32* %s, align 4
+  %v2 = shl i32 %v, 1
+  store i32 %v2, i32* %d, align 4
+  %s.next = getelementptr inbounds i32, i32* %s, i32 1
+  %d.next = getelementptr inbounds i32, i32* %d, i32 1
+  %inc = add nuw i32 %i, 1
+  %done = icmp eq i32 %inc, %n
+  br i1 %done, label %exit, label %body
+
+exit:
+  ret void
+}
@@ -0,0 +1,45 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 < %s | FileCheck %s
+
+; Unsafe FP math replaces the division libcall with a refined estimate.
+; CHECK-LABEL: fdiv_fast:
+; CHECK-NOT: __divsf3
+; CHECK: {{fmsub|fmul}}
+; CHECK-NOT: __divsf3
+; CHECK: jr lr
+define float @fdiv_fast(float %a, float %b) #0 {
+entry:
+  %r = fdiv float %a, %b
+  ret float %r
+}
+
+; CHECK-LABEL: sqrt_fast:
+; CHECK-NOT: sqrtf
+; CHECK: fmul
+; CHECK-NOT: sqrtf
+; CHECK: jr lr
+define float @sqrt_fast(float %a) #0 {
+entry:
+  %r = call float @llvm.sqrt.f32(float %a)
+  ret float %r
+}
+
+; CHECK-LABEL: fdiv_exact:
+; CHECK: __divsf3
+define float @fdiv_exact(float %a, float %b) {
+entry:
+  %r = fdiv float %a, %b
+  ret float %r
+}
+
+; CHECK-LABEL: fdiv_noest:
+; CHECK: __divsf3
+define float @fdiv_noest(float %a, float %b) #1 {
+entry:
+  %r = fdiv float %a, %b
+  ret float %r
+}
+
+declare float @llvm.sqrt.f32(float)
+
+attributes #0 = { "unsafe-fp-math"="true" }
+attributes #1 = { "unsafe-fp-math"="true" "reciprocal-estimates"="none" }
@@ -0,0 +1,39 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 < %s | FileCheck %s
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -debug-only=post-RA-sched < %s 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=DAG
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -mattr=+fp-truncate -debug-only=post-RA-sched < %s 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=TRUNC
+; REQUIRES: asserts
+
+; Dependent FPU results are 4 cycles away, loads 2, so the independent
+; integer work is scheduled into the gaps instead of after them.
+
+; DAG-LABEL: ********** List Scheduling **********
+; DAG: SU({{[0-9]+}}): {{.*}}FADDrr_r32
+; DAG: Predecessors:
+; DAG: SU({{[0-9]+}}){{.*}}Latency=4
+; DAG: SU({{[0-9]+}}): {{.*}}ADDri_r32
+; DAG: Predecessors:
+; DAG: SU({{[0-9]+}}){{.*}}Latency=2
+
+; FPU results are written in E3 in truncate mode.
+; TRUNC-LABEL: ********** List Scheduling **********
+; TRUNC: SU({{[0-9]+}}): {{.*}}FADDrr_r32
+; TRUNC: Predecessors:
+; TRUNC: SU({{[0-9]+}}){{.*}}Latency=3
+
+; CHECK-LABEL: mul_add:
+; CHECK: ldr
+; CHECK: fmul
+; CHECK: {{^[[:space:]]+}}add
+; CHECK: fadd
+; CHECK: jr lr
+define float @mul_add(float %a, float %b, float %c, i32* %p) {
+entry:
+  %m = fmul float %a, %b
+  %s = fadd float %m, %c
+  %x = load i32, i32* %p, align 4
+  %i = add i32 %x, 1
+  store i32 %i, i32* %p, align 4
+  ret float %s
+}
@@ -0,0 +1,48 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 < %s | FileCheck %s
+
+; Variable 64-bit shifts are built from 32-bit ones and conditional moves,
+; without library calls or branches.
+; CHECK-LABEL: shl64:
+; CHECK: lsl
+; CHECK-NOT: __ashldi3
+; CHECK-NOT: {{b[a-z]*}} .LBB
+; CHECK: jr lr
+define i64 @shl64(i64 %a, i64 %n) {
+entry:
+  %r = shl i64 %a, %n
+  ret i64 %r
+}
+
+; CHECK-LABEL: lshr64:
+; CHECK: lsr
+; CHECK-NOT: __lshrdi3
+; CHECK-NOT: {{b[a-z]*}} .LBB
+; CHECK: jr lr
+define i64 @lshr64(i64 %a, i64 %n) {
+entry:
+  %r = lshr i64 %a, %n
+  ret i64 %r
+}
+
+; CHECK-LABEL: ashr64:
+; CHECK: asr
+; CHECK-NOT: __ashrdi3
+; CHECK-NOT: {{b[a-z]*}} .LBB
+; CHECK: jr lr
+define i64 @ashr64(i64 %a, i64 %n) {
+entry:
+  %r = ashr i64 %a, %n
+  ret i64 %r
+}
+
+; Constant amounts fold the selects.
+; CHECK-LABEL: shl64_40:
+; CHECK: lsl {{r[0-9]+}}, {{r[0-9]+}}, #8
+; CHECK-NOT: __ashldi3
+; CHECK-NOT: mov{{eq|ne}}
+; CHECK: jr lr
+define i64 @shl64_40(i64 %a) {
+entry:
+  %r = shl i64 %a, 40
+  ret i64 %r
+}
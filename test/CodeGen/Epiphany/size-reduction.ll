@@ -0,0 +1,33 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -print-machineinstrs < %s 2>&1 | FileCheck %s
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -epiphany-size-reduction=false -print-machineinstrs < %s 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=WIDE
+
+; Registers in R0-R7 and small immediates fit into the 16-bit forms.
+; CHECK-LABEL: # After Epiphany 16-bit instruction size reduction
+; CHECK-LABEL: Machine code for function small:
+; CHECK: ADDrr_r16
+; CHECK: ADDri_r16 {{.*}}, 3
+; CHECK: LDRi32_r16
+; CHECK-LABEL: End machine code for function small.
+; WIDE-LABEL: Machine code for function small:
+; WIDE-NOT: _r16
+; WIDE-LABEL: End machine code for function small.
+define i32 @small(i32 %a, i32 %b, i32* %p) {
+entry:
+  %s = add i32 %a, %b
+  %t = add i32 %s, 3
+  %v = load i32, i32* %p, align 4
+  %r = xor i32 %t, %v
+  ret i32 %r
+}
+
+; Immediate out of the 3-bit range.
+; CHECK-LABEL: # After Epiphany 16-bit instruction size reduction
+; CHECK-LABEL: Machine code for function big_imm:
+; CHECK: ADDri_r32 {{.*}}, 100
+; CHECK-LABEL: End machine code for function big_imm.
+define i32 @big_imm(i32 %a) {
+entry:
+  %r = add i32 %a, 100
+  ret i32 %r
+}
@@ -0,0 +1,49 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 -epiphany-ssection-threshold=8 < %s > %t
+; RUN: FileCheck %s < %t
+; RUN: FileCheck %s --check-prefix=NOHIGH < %t
+
+; Small globals sit in the local memory, their address fits into one MOV.
+; Declarations, commons, weak and larger objects may end up anywhere.
+@small = global i32 1, align 4
+@zero = global i32 0, align 4
+@large = global [16 x i32] zeroinitializer, align 4
+@ext = external global i32
+@com = common global i32 0, align 4
+@weak = weak global i32 0, align 4
+@bank = global i32 0, section ".data_bank2", align 4
+
+; CHECK-LABEL: sum:
+; CHECK-DAG: mov {{r[0-9]+}}, %low(small)
+; CHECK-DAG: mov {{r[0-9]+}}, %low(zero)
+; CHECK-DAG: mov {{r[0-9]+}}, %low(bank)
+; CHECK-DAG: movt {{r[0-9]+}}, %high(large)
+; CHECK-DAG: movt {{r[0-9]+}}, %high(ext)
+; CHECK-DAG: movt {{r[0-9]+}}, %high(com)
+; CHECK-DAG: movt {{r[0-9]+}}, %high(weak)
+; NOHIGH-NOT: %high(small)
+; NOHIGH-NOT: %high(zero)
+; NOHIGH-NOT: %high(bank)
+; CHECK: jr lr
+define i32 @sum() {
+entry:
+  %a = load i32, i32* @small, align 4
+  %b = load i32, i32* @zero, align 4
+  %p = getelementptr inbounds [16 x i32], [16 x i32]* @large, i32 0, i32 1
+  %c = load i32, i32* %p, align 4
+  %d = load i32, i32* @ext, align 4
+  %e = load i32, i32* @com, align 4
+  %f = load i32, i32* @weak, align 4
+  %g = load i32, i32* @bank, align 4
+  %s1 = add i32 %a, %b
+  %s2 = add i32 %s1, %c
+  %s3 = add i32 %s2, %d
+  %s4 = add i32 %s3, %e
+  %s5 = add i32 %s4, %f
+  %s6 = add i32 %s5, %g
+  ret i32 %s6
+}
+
+; CHECK: .section .sdata
+; CHECK: small:
+; CHECK: .section .sbss
+; CHECK: zero:
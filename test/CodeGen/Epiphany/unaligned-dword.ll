@@ -0,0 +1,29 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 < %s | FileCheck %s
+; RUN: opt -mtriple=epiphany -mcpu=E16 -cost-model -analyze < %s | FileCheck %s --check-prefix=COST
+
+; Dwords are only accessed with LDRD/STRD when known to be aligned,
+; otherwise they are split into words, which the cost model follows.
+; CHECK-LABEL: aligned:
+; CHECK: ldrd
+; CHECK: strd
+; COST-LABEL: 'aligned'
+; COST: cost of 2 {{.*}} load i64
+; COST: cost of 1 {{.*}} store i64
+define void @aligned(i64* %p, i64* %q) {
+  %v = load i64, i64* %p, align 8
+  store i64 %v, i64* %q, align 8
+  ret void
+}
+
+; CHECK-LABEL: unaligned:
+; CHECK-NOT: ldrd
+; CHECK-NOT: strd
+; CHECK: jr lr
+; COST-LABEL: 'unaligned'
+; COST: cost of 4 {{.*}} load i64
+; COST: cost of 2 {{.*}} store i64
+define void @unaligned(i64* %p, i64* %q) {
+  %v = load i64, i64* %p, align 4
+  store i64 %v, i64* %q, align 4
+  ret void
+}
@@ -0,0 +1,63 @@
+; RUN: llc -march=epiphany -mcpu=E16 -O2 < %s | FileCheck %s
+
+; Vectors stay in register pairs, loaded and stored with one instruction and
+; computed element-wise.
+; CHECK-LABEL: add_v2i32:
+; CHECK: ldrd
+; CHECK: ldrd
+; CHECK: add
+; CHECK: add
+; CHECK: strd
+; CHECK-NOT: [sp
+; CHECK: jr lr
+define void @add_v2i32(<2 x i32>* %d, <2 x i32>* %a, <2 x i32>* %b) {
+entry:
+  %va = load <2 x i32>, <2 x i32>* %a, align 8
+  %vb = load <2 x i32>, <2 x i32>* %b, align 8
+  %r = add <2 x i32> %va, %vb
+  store <2 x i32> %r, <2 x i32>* %d, align 8
+  ret void
+}
+
+; CHECK-LABEL: fmul_v2f32:
+; CHECK: ldrd
+; CHECK: ldrd
+; CHECK: fmul
+; CHECK: fmul
+; CHECK: strd
+; CHECK-NOT: [sp
+; CHECK: jr lr
+define void @fmul_v2f32(<2 x float>* %d, <2 x float>* %a, <2 x float>* %b) {
+entry:
+  %va = load <2 x float>, <2 x float>* %a, align 8
+  %vb = load <2 x float>, <2 x float>* %b, align 8
+  %r = fmul <2 x float> %va, %vb
+  store <2 x float> %r, <2 x float>* %d, align 8
+  ret void
+}
+
+; Constant index element access is a subregister copy.
+; CHECK-LABEL: extract:
+; CHECK: ldrd
+; CHECK-NOT: [sp
+; CHECK: jr lr
+define i32 @extract(<2 x i32>* %a) {
+entry:
+  %va = load <2 x i32>, <2 x i32>* %a, align 8
+  %e0 = extractelement <2 x i32> %va, i32 0
+  %e1 = extractelement <2 x i32> %va, i32 1
+  %r = sub i32 %e0, %e1
+  ret i32 %r
+}
+
+; CHECK-LABEL: insert:
+; CHECK: strd
+; CHECK-NOT: [sp
+; CHECK: jr lr
+define void @insert(<2 x float>* %d, float %x, float %y) {
+entry:
+  %v0 = insertelement <2 x float> undef, float %x, i32 0
+  %v1 = insertelement <2 x float> %v0, float %y, i32 1
+  store <2 x float> %v1, <2 x float>* %d, align 8
+  ret void
+}